@@ -0,0 +1,50 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+
+using namespace boyo;
+
+// Mean wall time of Compiler::compile over a few runs, in milliseconds
+double TimeCompile(const CompileOptions &options,
+                   const std::vector<std::string> &program, int runs) {
+  const std::string binary = "compile_bench_program";
+  double total = 0;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    Compiler(options).compile(program, binary);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    total += elapsed.count();
+  }
+  std::remove(binary.c_str());
+  return total / runs;
+}
+
+int main() {
+  std::cout << "==================================================\n";
+  std::cout << "       Boyo Compiler - Compile Time Benchmark\n";
+  std::cout << "==================================================\n\n";
+
+  std::vector<std::string> program = {"let A 0x10", "let B 0x03",
+                                      "def f _a _b => + * 0x02 _a _b",
+                                      "main f A B"};
+  constexpr int kRuns = 3;
+
+  CompileOptions embedded;
+  embedded.link_runtime = false;
+  double embedded_ms = TimeCompile(embedded, program, kRuns);
+  std::printf("Embedded runtime source:   %8.0f ms\n", embedded_ms);
+
+  if (!Compiler::RuntimeLibraryAvailable()) {
+    std::printf("Prebuilt runtime library not found\n");
+    return 1;
+  }
+  double linked_ms = TimeCompile(CompileOptions{}, program, kRuns);
+  std::printf("Prebuilt runtime + PCH:    %8.0f ms (%.1fx faster)\n",
+              linked_ms, embedded_ms / linked_ms);
+  return 0;
+}
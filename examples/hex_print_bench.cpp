@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "compiler/compiler.hpp"
+
+using namespace boyo;
+
+// Benchmark body placed in main() of a program built from the runtime
+// snippet: prints a 64 MiB vector with print_vector and with the original
+// per-byte ostream loop, reporting the input bytes formatted per second
+const std::string kBenchmarkMain = R"(
+    std::vector<uint8_t> data(size_t{64} << 20);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 2654435761u >> 13);
+    }
+    auto report = [&](const char* name, auto&& print) {
+        auto start = std::chrono::steady_clock::now();
+        print();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::fprintf(stderr, "%-16s %8.1f MB/s\n", name,
+                     data.size() / elapsed.count() / 1e6);
+    };
+    report("print_vector", [&]() { print_vector(std::cout, data); });
+    report("ostream << hex", [&]() {
+        for (const auto& byte : data) {
+            std::cout << std::hex << static_cast<int>(byte) << " ";
+        }
+        std::cout << std::dec << std::endl;
+    });
+)";
+
+int main() {
+  std::cout << "==================================================\n";
+  std::cout << "       Boyo Runtime - print_vector Benchmark\n";
+  std::cout << "==================================================\n\n";
+
+  auto program = Compiler::SubstituteGeneratedCode(
+      Compiler::GetMainFunctionSnippet(),
+      "#include <chrono>\n{boyo_split_point}" + kBenchmarkMain);
+
+  const std::string source = "hex_print_bench_program.cpp";
+  const std::string binary = "hex_print_bench_program";
+  std::ofstream(source) << program;
+
+  std::cout << "Building benchmark program with -O2...\n";
+  std::string build = "g++ -std=c++17 -O2 -pthread -o " + binary + " " +
+                      source;
+  if (std::system(build.c_str()) != 0) {
+    std::fprintf(stderr, "Error: Failed to build benchmark program\n");
+    return 1;
+  }
+
+  std::cout << "Printing 64 MiB to /dev/null (input bytes per second):\n";
+  std::fflush(stdout);
+  int result = std::system(("./" + binary + " > /dev/null").c_str());
+
+  std::remove(source.c_str());
+  std::remove(binary.c_str());
+  return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include "cache/compile_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <system_error>
+
+#include "utils/sha256.hpp"
+
+namespace boyo {
+
+namespace fs = std::filesystem;
+
+CompileCache::CompileCache(fs::path directory, uint64_t max_bytes)
+    : directory_(std::move(directory)), max_bytes_(max_bytes) {}
+
+fs::path CompileCache::DefaultDirectory() {
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    return fs::path(xdg) / "boyo";
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return fs::path(home) / ".cache" / "boyo";
+  }
+  return fs::temp_directory_path() / "boyo-cache";
+}
+
+std::string CompileCache::Key(const std::string &source,
+                              const std::string &compiler_path,
+                              const std::string &compiler_version,
+                              const std::vector<std::string> &flags) {
+  // Length-prefix every field so no two inputs hash the same bytes
+  Sha256 hasher;
+  auto add = [&hasher](const std::string &field) {
+    hasher.Update(std::to_string(field.size()));
+    hasher.Update(":");
+    hasher.Update(field);
+  };
+  add(compiler_path);
+  add(compiler_version);
+  for (const auto &flag : flags) {
+    add(flag);
+  }
+  add(source);
+  return hasher.HexDigest();
+}
+
+fs::path CompileCache::EntryPath(const std::string &key) const {
+  return directory_ / "entries" / key.substr(0, 2) / key;
+}
+
+bool CompileCache::Fetch(const std::string &key,
+                         const std::string &output_file) {
+  fs::path entry = EntryPath(key);
+  std::error_code error;
+  if (!fs::is_regular_file(entry, error)) {
+    RecordLookup(false);
+    return false;
+  }
+
+  fs::remove(output_file, error);
+  fs::create_hard_link(entry, output_file, error);
+  if (error) {
+    fs::copy_file(entry, output_file, fs::copy_options::overwrite_existing,
+                  error);
+    if (error) {
+      RecordLookup(false);
+      return false;
+    }
+  }
+
+  // Hits refresh the entry's modification time, which orders eviction
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+  RecordLookup(true);
+  return true;
+}
+
+void CompileCache::Store(const std::string &key, const std::string &binary) {
+  fs::path entry = EntryPath(key);
+  fs::create_directories(entry.parent_path());
+
+  // Copy next to the entry and rename, so readers never see a partial file
+  static std::atomic<unsigned> counter{0};
+  fs::path temp = entry.parent_path() /
+                  (".tmp-" + std::to_string(::getpid()) + "-" +
+                   std::to_string(counter++) + "-" + key.substr(0, 8));
+  fs::copy_file(binary, temp, fs::copy_options::overwrite_existing);
+  fs::rename(temp, entry);
+
+  Evict();
+}
+
+CacheStats CompileCache::Stats() const {
+  CacheStats stats;
+  std::error_code error;
+  fs::path entries = directory_ / "entries";
+  if (fs::is_directory(entries, error)) {
+    for (const auto &file :
+         fs::recursive_directory_iterator(entries, error)) {
+      if (file.is_regular_file(error) &&
+          !file.path().filename().string().starts_with(".tmp-")) {
+        stats.entries++;
+        stats.bytes += file.file_size(error);
+      }
+    }
+  }
+
+  if (FILE *counters = std::fopen((directory_ / "stats").c_str(), "r")) {
+    unsigned long long hits = 0, misses = 0;
+    if (std::fscanf(counters, "%llu %llu", &hits, &misses) == 2) {
+      stats.hits = hits;
+      stats.misses = misses;
+    }
+    std::fclose(counters);
+  }
+  return stats;
+}
+
+void CompileCache::RecordLookup(bool hit) {
+  std::error_code error;
+  fs::create_directories(directory_, error);
+  int fd = ::open((directory_ / "stats").c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                  0644);
+  if (fd < 0) {
+    return; // Counters are best effort
+  }
+  ::flock(fd, LOCK_EX);
+
+  char buffer[64] = {0};
+  unsigned long long hits = 0, misses = 0;
+  if (::pread(fd, buffer, sizeof(buffer) - 1, 0) > 0) {
+    std::sscanf(buffer, "%llu %llu", &hits, &misses);
+  }
+  (hit ? hits : misses)++;
+  int length = std::snprintf(buffer, sizeof(buffer), "%llu %llu\n", hits,
+                             misses);
+  if (::ftruncate(fd, 0) != 0 || ::pwrite(fd, buffer, length, 0) != length) {
+    std::fprintf(stderr, "Warning: Failed to update cache statistics\n");
+  }
+
+  ::flock(fd, LOCK_UN);
+  ::close(fd);
+}
+
+void CompileCache::Evict() {
+  struct Entry {
+    fs::path path;
+    fs::file_time_type used;
+    uint64_t bytes;
+  };
+
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  std::error_code error;
+  for (const auto &file :
+       fs::recursive_directory_iterator(directory_ / "entries", error)) {
+    if (!file.is_regular_file(error) ||
+        file.path().filename().string().starts_with(".tmp-")) {
+      continue;
+    }
+    Entry entry{file.path(), file.last_write_time(error),
+                file.file_size(error)};
+    total += entry.bytes;
+    entries.push_back(std::move(entry));
+  }
+  if (total <= max_bytes_) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (const auto &entry : entries) {
+    if (total <= max_bytes_) {
+      break;
+    }
+    if (fs::remove(entry.path, error)) {
+      total -= entry.bytes;
+    }
+  }
+}
+
+} // namespace boyo
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace boyo {
+
+/**
+ * Summary of the on-disk compile cache
+ */
+struct CacheStats {
+  uint64_t entries = 0;
+  uint64_t bytes = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+/**
+ * Persistent content-addressed cache of compiled binaries.
+ *
+ * Entries are keyed by a SHA-256 over the generated C++ source, the C++
+ * compiler's path and version, and the compiler flags, so a key can only
+ * ever name one binary. Entries are published with an atomic rename, and
+ * the least recently used ones are evicted once the cache grows past its
+ * size limit. Several boyo processes may share one cache directory.
+ */
+class CompileCache {
+public:
+  static constexpr uint64_t kDefaultMaxBytes = uint64_t{1} << 30;
+
+  /**
+   * @param directory Root directory of the cache (created on demand)
+   * @param max_bytes Total size of entries kept before evicting
+   */
+  explicit CompileCache(std::filesystem::path directory,
+                        uint64_t max_bytes = kDefaultMaxBytes);
+
+  /**
+   * The default cache directory: $XDG_CACHE_HOME/boyo, falling back to
+   * ~/.cache/boyo
+   */
+  static std::filesystem::path DefaultDirectory();
+
+  /**
+   * Compute the cache key for a compilation.
+   * @param source The final C++ source passed to the compiler
+   * @param compiler_path Path of the C++ compiler
+   * @param compiler_version Version banner reported by the compiler
+   * @param flags Compiler flags, in order
+   * @return A 64 character hex key
+   */
+  static std::string Key(const std::string &source,
+                         const std::string &compiler_path,
+                         const std::string &compiler_version,
+                         const std::vector<std::string> &flags);
+
+  /**
+   * Place the binary cached under key at output_file, hardlinking it when
+   * possible and copying otherwise, and mark the entry as recently used.
+   * @return true on a hit, false if key is not cached
+   */
+  bool Fetch(const std::string &key, const std::string &output_file);
+
+  /**
+   * Add the built binary under key, then evict least recently used entries
+   * until the cache fits its size limit.
+   * @param key The cache key
+   * @param binary Path of the freshly built binary (left in place)
+   */
+  void Store(const std::string &key, const std::string &binary);
+
+  /**
+   * Path of the entry for key (which may not exist)
+   */
+  std::filesystem::path EntryPath(const std::string &key) const;
+
+  /**
+   * Count entries and their size, and read the hit/miss counters
+   */
+  CacheStats Stats() const;
+
+  const std::filesystem::path &GetDirectory() const { return directory_; }
+
+private:
+  // Add to the persistent hit/miss counters under a file lock
+  void RecordLookup(bool hit);
+
+  // Remove the oldest entries while the cache is over max_bytes_
+  void Evict();
+
+  std::filesystem::path directory_;
+  uint64_t max_bytes_;
+};
+
+} // namespace boyo
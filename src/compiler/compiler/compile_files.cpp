@@ -0,0 +1,90 @@
+#include "compiler/compile_files.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+#include "utils/jobserver.hpp"
+#include "utils/parallel.hpp"
+
+namespace boyo {
+
+namespace fs = std::filesystem;
+
+// Read and compile one file, recording the outcome in result
+static void CompileFile(const CompileOptions &options,
+                        FileCompileResult &result) {
+  try {
+    std::ifstream in(result.input_file);
+    if (!in) {
+      throw std::runtime_error("Failed to open input file: " +
+                               result.input_file);
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+      lines.push_back(line);
+    }
+    Compiler(options).compile(lines, result.output_file);
+    result.success = true;
+  } catch (const CompileError &e) {
+    result.error = e.what();
+    result.diagnostics = e.GetDiagnostics();
+  } catch (const std::exception &e) {
+    result.error = e.what();
+  }
+}
+
+std::vector<FileCompileResult>
+CompileFiles(const std::vector<std::string> &input_files,
+             const std::string &out_dir, const CompileOptions &options,
+             size_t jobs,
+             const std::function<void(const FileCompileResult &)> &on_done) {
+  std::vector<FileCompileResult> results(input_files.size());
+  std::set<std::string> outputs;
+  for (size_t i = 0; i < input_files.size(); ++i) {
+    results[i].input_file = input_files[i];
+    results[i].output_file =
+        (fs::path(out_dir) / fs::path(input_files[i]).stem()).string();
+    if (!outputs.insert(results[i].output_file).second) {
+      throw std::runtime_error("Several inputs would be written to " +
+                               results[i].output_file);
+    }
+  }
+  fs::create_directories(out_dir);
+
+  // Files are the unit of parallelism, so each builds its units serially
+  CompileOptions file_options = options;
+  file_options.jobs = 1;
+
+  auto jobserver = JobServer::FromEnvironment();
+  if (jobs == 0 && jobserver) {
+    jobs = input_files.size();
+  }
+  std::mutex report_mutex;
+  ParallelFor(input_files.size(), jobs, [&](size_t i) {
+    auto start = std::chrono::steady_clock::now();
+    JobServer::Token token = JobServer::kImplicitToken;
+    if (jobserver) {
+      token = jobserver->Acquire();
+    }
+    CompileFile(file_options, results[i]);
+    if (jobserver) {
+      jobserver->Release(token);
+    }
+    results[i].seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    if (on_done) {
+      std::lock_guard<std::mutex> lock(report_mutex);
+      on_done(results[i]);
+    }
+  });
+  return results;
+}
+
+} // namespace boyo
@@ -1,16 +1,34 @@
 #include "compiler/compiler.hpp"
 
-#include <sys/wait.h>
-
+#include <cctype>
 #include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <map>
 #include <memory>
+#include <set>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
+#include "cache/compile_cache.hpp"
 #include "parser/parser.hpp"
+#include "runtime/boyo_runtime_source.hpp"
 #include "statement/statement.hpp"
+#include "utils/jobserver.hpp"
+#include "utils/parallel.hpp"
+#include "utils/sha256.hpp"
+#include "utils/subprocess.hpp"
 
 namespace boyo {
 
@@ -20,81 +38,130 @@ namespace boyo {
 const std::string kBoyoProgramStartString = "{boyo_program_start}";
 const std::string kBoyoProgramEndString = "{boyo_program_end}";
 
-const std::string kMainFunctionSnippet =
+// Program body following the runtime: globals, then main
+const std::string kProgramSnippet =
     R"(
-    #include <iostream>
-    #include <vector>
-    #include <cstdint>
-    
-    // Helper function to print vectors
-    void print_vector(std::ostream& os, const std::vector<uint8_t>& vec) {
-        for (const auto& byte : vec) {
-            os << std::hex << static_cast<int>(byte) << " ";
-        }
-        os << std::dec << std::endl;
-    }
-    
-    // Helper functions for vector operations
-    std::vector<uint8_t> add_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
-        std::vector<uint8_t> result;
-        size_t max_size = std::max(a.size(), b.size());
-        result.reserve(max_size);
-        for (size_t i = 0; i < max_size; ++i) {
-            uint8_t val_a = (i < a.size()) ? a[i] : 0;
-            uint8_t val_b = (i < b.size()) ? b[i] : 0;
-            result.push_back(val_a + val_b);
-        }
-        return result;
-    }
-    
-    std::vector<uint8_t> subtract_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
-        std::vector<uint8_t> result;
-        size_t max_size = std::max(a.size(), b.size());
-        result.reserve(max_size);
-        for (size_t i = 0; i < max_size; ++i) {
-            uint8_t val_a = (i < a.size()) ? a[i] : 0;
-            uint8_t val_b = (i < b.size()) ? b[i] : 0;
-            result.push_back(val_a - val_b);
-        }
-        return result;
-    }
-    
-    std::vector<uint8_t> multiply_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
-        std::vector<uint8_t> result;
-        size_t max_size = std::max(a.size(), b.size());
-        result.reserve(max_size);
-        for (size_t i = 0; i < max_size; ++i) {
-            uint8_t val_a = (i < a.size()) ? a[i] : 0;
-            uint8_t val_b = (i < b.size()) ? b[i] : 0;
-            result.push_back(val_a * val_b);
-        }
-        return result;
-    }
-    
-    {boyo_program_start}
-    
-    int main() {
+{boyo_program_start}
+
+int main(int argc, char** argv) {
+    try {
         {boyo_program_end}
-        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
     }
-    )";
+    return 0;
+}
+)";
+
+// Self-contained program with the runtime source embedded
+const std::string kMainFunctionSnippet = std::string(kBoyoRuntimeHeaderSource) +
+                                         kBoyoRuntimeImplementationSource +
+                                         kProgramSnippet;
+
+// Runtime include of programs linked against the runtime library
+const std::string kRuntimeInclude = "#include \"runtime/boyo_runtime.hpp\"\n";
+
+// Vector operation declarations, all that units of lets and defs include
+const std::string kKernelsInclude = "#include \"runtime/boyo_kernels.hpp\"\n";
+
+// Program that includes the runtime header and links the runtime library
+const std::string kLinkedMainFunctionSnippet = kRuntimeInclude + kProgramSnippet;
+
+// Separates the global code of generated code from the body of main()
+const std::string kSplitPoint = "{boyo_split_point}";
 
 const std::string gpp_path = "/usr/bin/g++";
 
+// Archiver for static libraries
+const std::string ar_path = "/usr/bin/ar";
+
+// Flags passed to g++ for every program
+const std::vector<std::string> kCompilerFlags = {"-std=c++17", "-pthread"};
+
+// Optimization levels accepted as -O<level>
+const std::vector<std::string> kOptLevels = {"0", "1", "2", "3",
+                                             "s", "z", "g", "fast"};
+
+// First line of `g++ --version`, queried once per process
+static const std::string &GetCompilerVersion() {
+  static const std::string version = []() {
+    try {
+      Subprocess gpp({gpp_path, "--version"});
+      gpp.Wait();
+      const auto &output = gpp.GetOutput();
+      return output.substr(0, output.find('\n') + 1);
+    } catch (const std::runtime_error &) {
+      return std::string();
+    }
+  }();
+  return version;
+}
+
+// Flags that build a program against the prebuilt runtime. The precompiled
+// header directory comes first so g++ finds the .gch before the header.
+static const std::vector<std::string> &GetRuntimeFlags() {
+  static const std::vector<std::string> flags = {
+      "-I" + std::string(BOYO_RUNTIME_PCH_DIR),
+      "-I" + std::string(BOYO_RUNTIME_INCLUDE_DIR)};
+  return flags;
+}
+
+// Hash of the runtime headers and library, so cached binaries are rebuilt
+// when the runtime changes
+static const std::string &GetRuntimeFingerprint() {
+  static const std::string fingerprint = []() {
+    Sha256 hasher;
+    for (const char *path :
+         {BOYO_RUNTIME_INCLUDE_DIR "/runtime/boyo_kernels.hpp",
+          BOYO_RUNTIME_INCLUDE_DIR "/runtime/boyo_runtime.hpp",
+          BOYO_RUNTIME_LIBRARY}) {
+      std::ifstream file(path, std::ios::binary);
+      std::ostringstream contents;
+      contents << file.rdbuf();
+      hasher.Update(contents.str());
+    }
+    return hasher.HexDigest();
+  }();
+  return fingerprint;
+}
+
+CompileError::CompileError(const std::string &message, std::string diagnostics)
+    : std::runtime_error(message), diagnostics_(std::move(diagnostics)) {}
+
+std::string CompileError::FormatDiagnostics() const {
+  if (diagnostics_.empty()) {
+    return "";
+  }
+  std::string formatted = "\nCompiler output:\n";
+  std::istringstream lines(diagnostics_);
+  std::string line;
+  while (std::getline(lines, line)) {
+    formatted += "| " + line + "\n";
+  }
+  return formatted;
+}
+
 Compiler::Compiler() : data_(new int(42)) {}
 
+Compiler::Compiler(CompileOptions options)
+    : data_(new int(42)), options_(std::move(options)) {}
+
 Compiler::~Compiler() { delete data_; }
 
-Compiler::Compiler(const Compiler &other) : data_(new int(*other.data_)) {}
+Compiler::Compiler(const Compiler &other)
+    : data_(new int(*other.data_)), options_(other.options_) {}
 
 Compiler &Compiler::operator=(const Compiler &other) {
   if (this != &other) {
     *data_ = *other.data_;
+    options_ = other.options_;
   }
   return *this;
 }
 
-Compiler::Compiler(Compiler &&other) noexcept : data_(other.data_) {
+Compiler::Compiler(Compiler &&other) noexcept
+    : data_(other.data_), options_(std::move(other.options_)) {
   other.data_ = nullptr;
 }
 
@@ -102,6 +169,7 @@ Compiler &Compiler::operator=(Compiler &&other) noexcept {
   if (this != &other) {
     delete data_;
     data_ = other.data_;
+    options_ = std::move(other.options_);
     other.data_ = nullptr;
   }
   return *this;
@@ -117,11 +185,10 @@ Compiler::SubstituteGeneratedCode(const std::string &main_function,
   std::string global_code;
   std::string main_code;
 
-  size_t split_pos = generated_code.find("{boyo_split_point}");
+  size_t split_pos = generated_code.find(kSplitPoint);
   if (split_pos != std::string::npos) {
     global_code = generated_code.substr(0, split_pos);
-    main_code = generated_code.substr(
-        split_pos + 18); // 18 is length of "{boyo_split_point}"
+    main_code = generated_code.substr(split_pos + kSplitPoint.size());
   } else {
     // No split point, put everything as global
     global_code = generated_code;
@@ -143,103 +210,1089 @@ Compiler::SubstituteGeneratedCode(const std::string &main_function,
 }
 
 std::string Compiler::GenerateProgramCode(const StatementList &statements) {
+  return GenerateProgramCode(statements, CompileOptions{});
+}
+
+// Generate the body of main(): runtime argument binding, then evaluation and
+// output of every main statement
+static std::string
+GenerateMainCode(const std::vector<const MainStatement *> &main_statements,
+                 const CompileOptions &options) {
+  std::string main_code;
+
+  bool raw = options.output_format != OutputFormat::kHex;
+  if (options.batch && (options.stream || main_statements.size() != 1)) {
+    throw std::runtime_error(
+        "Batch mode needs exactly one main statement and no streaming");
+  }
+
+  // Main arguments can be rebound at runtime with NAME=SOURCE program
+  // arguments, so one binary can be run on many inputs
+  std::vector<std::string> bindable;
+  for (const auto *main_stmt : main_statements) {
+    for (const auto &arg : main_stmt->GetArgs()) {
+      if (std::find(bindable.begin(), bindable.end(), arg) == bindable.end()) {
+        bindable.push_back(arg);
+      }
+    }
+  }
+  main_code += "boyo_check_arguments(argc, argv, {";
+  for (const auto &name : bindable) {
+    main_code += "\"" + name + "\", ";
+  }
+  if (options.batch) {
+    main_code += "\"--records\", \"--record-format\", \"--output\"});\n";
+  } else {
+    main_code += raw ? "\"--output\"});\n" : "});\n";
+  }
+  for (const auto &name : bindable) {
+    main_code += "boyo_bind(argc, argv, \"" + name + "\", " + name + ", " +
+                 (options.stream ? "true" : "false") + ");\n";
+  }
+
+  if (options.batch) {
+    std::string format = "boyo_format_hex";
+    if (options.output_format == OutputFormat::kRaw) {
+      format = "boyo_format_raw";
+    } else if (options.output_format == OutputFormat::kRawLengthPrefixed) {
+      format = "boyo_format_raw_prefixed";
+    }
+    main_code += main_statements[0]->GenerateBatchCode(options.threads, format);
+    return main_code;
+  }
+
+  if (raw) {
+    if (options.stream &&
+        options.output_format == OutputFormat::kRawLengthPrefixed) {
+      throw std::runtime_error(
+          "Length-prefixed output needs the result length up front and "
+          "cannot be combined with streaming");
+    }
+    main_code += "boyo_raw_output boyo_output(boyo_find_binding(argc, argv, "
+                 "\"--output\"), " +
+                 std::string(options.output_format ==
+                                     OutputFormat::kRawLengthPrefixed
+                                 ? "true"
+                                 : "false") +
+                 ");\n";
+  }
+
+  if (options.stream) {
+    for (const auto *main_stmt : main_statements) {
+      main_code += raw ? main_stmt->GenerateStreamCode(
+                             options.stream_chunk_size, "boyo_output")
+                       : main_stmt->GenerateStreamCode(
+                             options.stream_chunk_size);
+    }
+  } else if (raw && (options.threads == 1 || main_statements.size() == 1)) {
+    for (const auto *main_stmt : main_statements) {
+      main_code +=
+          "boyo_output.write(" + main_stmt->GenerateCallCode() + ");\n";
+    }
+  } else if (main_statements.size() == 1) {
+    main_code += main_statements[0]->GenerateCode();
+  } else if (options.threads == 1) {
+    // Sequential: scope each main so its result variable does not collide
+    for (const auto *main_stmt : main_statements) {
+      main_code += "{\n" + main_stmt->GenerateCode() + "}\n";
+    }
+  } else if (!main_statements.empty()) {
+    // Parallel: evaluate every main into its own result on the worker pool,
+    // then write in source order so output matches sequential execution
+    std::ostringstream oss;
+    for (size_t i = 0; i < main_statements.size(); ++i) {
+      oss << "std::vector<uint8_t> boyo_result_" << i << ";\n";
+    }
+    oss << "boyo_parallel_for(" << main_statements.size() << ", "
+        << options.threads << ", [&](size_t boyo_task) {\n";
+    oss << "switch (boyo_task) {\n";
+    for (size_t i = 0; i < main_statements.size(); ++i) {
+      oss << "case " << i << ": boyo_result_" << i << " = "
+          << main_statements[i]->GenerateCallCode() << "; break;\n";
+    }
+    oss << "}\n";
+    oss << "});\n";
+    for (size_t i = 0; i < main_statements.size(); ++i) {
+      if (raw) {
+        oss << "boyo_output.write(std::move(boyo_result_" << i << "));\n";
+      } else {
+        oss << "print_vector(std::cout, boyo_result_" << i << ");\n";
+      }
+    }
+    main_code += oss.str();
+  }
+
+  return main_code;
+}
+
+// Generate the definitions of a let or def statement; in streaming mode defs
+// also get their chunked variant
+static std::string GenerateDefinitionCode(const Statement &statement,
+                                          const CompileOptions &options) {
+  std::string code = statement.GenerateCode();
+  if (options.stream) {
+    if (auto *def_stmt = dynamic_cast<const DefStatement *>(&statement)) {
+      code += def_stmt->GenerateChunkCode();
+    }
+  }
+  return code;
+}
+
+std::string Compiler::GenerateProgramCode(const StatementList &statements,
+                                          const CompileOptions &options) {
   std::string global_code; // Variables and functions
-  std::string main_code;   // Main execution code
 
+  std::vector<const MainStatement *> main_statements;
   for (const auto &statement : statements) {
     // Check if this is a MainStatement by trying to dynamic_cast
-    if (dynamic_cast<const MainStatement *>(statement.get())) {
-      main_code += statement->GenerateCode();
+    if (auto *main_stmt = dynamic_cast<const MainStatement *>(statement.get())) {
+      main_statements.push_back(main_stmt);
     } else {
-      global_code += statement->GenerateCode();
+      global_code += GenerateDefinitionCode(*statement, options);
+    }
+  }
+
+  return global_code + kSplitPoint +
+         GenerateMainCode(main_statements, options);
+}
+
+// Dispatcher of a fused program: run the program named by argv[0]'s
+// basename (a symlink to the binary), or else by the first argument
+const std::string kFusedDispatchCode = R"(
+const char* boyo_name = std::strrchr(argv[0], '/');
+boyo_name = boyo_name ? boyo_name + 1 : argv[0];
+for (const auto& program : boyo_programs) {
+    if (std::strcmp(program.name, boyo_name) == 0) {
+        return program.run(argc, argv);
+    }
+}
+if (argc > 1) {
+    for (const auto& program : boyo_programs) {
+        if (std::strcmp(program.name, argv[1]) == 0) {
+            return program.run(argc - 1, argv + 1);
+        }
+    }
+}
+std::fprintf(stderr, "Usage: %s <program> [NAME=SOURCE]...\nPrograms:", boyo_name);
+for (const auto& program : boyo_programs) {
+    std::fprintf(stderr, " %s", program.name);
+}
+std::fprintf(stderr, "\n");
+return 1;
+)";
+
+std::string
+Compiler::GenerateFusedProgramCode(const std::vector<FusedProgram> &programs,
+                                   const CompileOptions &options) {
+  std::string global_code = "#include <cstring>\n";
+  std::string table = "struct boyo_program {\n"
+                      "    const char* name;\n"
+                      "    int (*run)(int argc, char** argv);\n"
+                      "};\n"
+                      "const boyo_program boyo_programs[] = {\n";
+
+  std::set<std::string> names;
+  for (size_t i = 0; i < programs.size(); ++i) {
+    const auto &name = programs[i].name;
+    if (name.empty() ||
+        name.find_first_not_of("abcdefghijklmnopqrstuvwxyz"
+                               "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._+-") !=
+            std::string::npos) {
+      throw std::runtime_error("Invalid program name: " + name);
+    }
+    if (!names.insert(name).second) {
+      throw std::runtime_error("Duplicate program name: " + name);
+    }
+
+    // Each program keeps its own lets and defs in its own namespace, and
+    // its main() becomes that namespace's boyo_run()
+    std::string code = GenerateProgramCode(programs[i].statements, options);
+    size_t split = code.find(kSplitPoint);
+    if (split == std::string::npos) {
+      throw std::runtime_error("Generated code of program " + name +
+                               " has no split point");
+    }
+    std::string space = "boyo_program_" + std::to_string(i);
+    global_code += "namespace " + space + " {\n" + code.substr(0, split) +
+                   "int boyo_run(int argc, char** argv) {\n" +
+                   code.substr(split + kSplitPoint.size()) +
+                   "return 0;\n}\n} // namespace " + space + "\n";
+    table += "    {\"" + name + "\", " + space + "::boyo_run},\n";
+  }
+  table += "};\n";
+
+  return global_code + table + kSplitPoint + kFusedDispatchCode;
+}
+
+// Deterministic unit for a definition: FNV-1a of its name, so a definition
+// keeps its unit (and cached object) when others are added or removed
+static size_t UnitIndex(const std::string &name, size_t units) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : name) {
+    hash = (hash ^ c) * 0x100000001b3;
+  }
+  return hash % units;
+}
+
+// Name of the let or def statement defines, or empty for other statements
+static std::string DefinedName(const Statement &statement) {
+  if (auto *let_stmt = dynamic_cast<const LetStatement *>(&statement)) {
+    return let_stmt->GetVarName();
+  }
+  if (auto *def_stmt = dynamic_cast<const DefStatement *>(&statement)) {
+    return def_stmt->GetFuncName();
+  }
+  return "";
+}
+
+// Declarations other units use a let or def through; in streaming mode defs
+// also declare their chunked variant
+static std::string GenerateDeclarations(const Statement &statement,
+                                        const CompileOptions &options) {
+  std::string code = statement.GenerateDeclarationCode();
+  if (options.stream) {
+    if (auto *def_stmt = dynamic_cast<const DefStatement *>(&statement)) {
+      code += def_stmt->GenerateChunkDeclarationCode();
+    }
+  }
+  return code;
+}
+
+std::map<std::string, std::string>
+Compiler::ComputeContentHashes(const StatementList &statements,
+                               const CompileOptions &options) {
+  std::map<std::string, const Statement *> definitions;
+  for (const auto &statement : statements) {
+    std::string name = DefinedName(*statement);
+    if (!name.empty()) {
+      definitions[name] = statement.get();
+    }
+  }
+
+  std::map<std::string, std::string> hashes;
+  std::set<std::string> visiting;
+  std::function<const std::string &(const std::string &)> hash_of =
+      [&](const std::string &name) -> const std::string & {
+    if (auto found = hashes.find(name); found != hashes.end()) {
+      return found->second;
+    }
+    if (!visiting.insert(name).second) {
+      throw std::runtime_error("Circular definition: " + name);
+    }
+
+    // Length-prefix every field so no two statements hash the same bytes
+    Sha256 hasher;
+    auto add = [&hasher](const std::string &field) {
+      hasher.Update(std::to_string(field.size()));
+      hasher.Update(":");
+      hasher.Update(field);
+    };
+    const Statement &statement = *definitions.at(name);
+    add(GenerateDefinitionCode(statement, options));
+    for (const auto &dependency : statement.GetDependencies()) {
+      add(dependency);
+      if (definitions.count(dependency)) {
+        add(hash_of(dependency));
+      }
+    }
+
+    visiting.erase(name);
+    return hashes[name] = hasher.HexDigest();
+  };
+
+  for (const auto &definition : definitions) {
+    hash_of(definition.first);
+  }
+  return hashes;
+}
+
+TranslationUnits
+Compiler::GenerateTranslationUnits(const StatementList &statements,
+                                   const CompileOptions &options) {
+  size_t count = std::max<size_t>(options.translation_units, 1);
+  TranslationUnits result;
+  if (!options.incremental) {
+    result.units.resize(count);
+  }
+
+  std::map<std::string, std::string> declarations;
+  std::map<std::string, std::string> hashes;
+  if (options.incremental) {
+    hashes = ComputeContentHashes(statements, options);
+    for (const auto &statement : statements) {
+      std::string name = DefinedName(*statement);
+      if (!name.empty()) {
+        declarations[name] = GenerateDeclarations(*statement, options);
+      }
+    }
+  }
+
+  std::string global_code; // Statements that only run in the main unit
+  std::vector<const MainStatement *> main_statements;
+  for (const auto &statement : statements) {
+    if (auto *main_stmt = dynamic_cast<const MainStatement *>(statement.get())) {
+      main_statements.push_back(main_stmt);
+      continue;
+    }
+
+    std::string name = DefinedName(*statement);
+    if (name.empty()) {
+      global_code += GenerateDefinitionCode(*statement, options);
+      continue;
+    }
+    result.header += GenerateDeclarations(*statement, options);
+    if (options.incremental) {
+      // Only the declarations this definition uses, so editing anything
+      // else leaves the unit and its hash alone
+      std::string unit;
+      for (const auto &dependency : statement->GetDependencies()) {
+        if (auto found = declarations.find(dependency);
+            found != declarations.end()) {
+          unit += found->second;
+        }
+      }
+      result.units.push_back(unit +
+                             GenerateDefinitionCode(*statement, options));
+      result.hashes.push_back(hashes.at(name));
+    } else {
+      result.units[UnitIndex(name, count)] +=
+          GenerateDefinitionCode(*statement, options);
+    }
+  }
+
+  // Units nothing was assigned to are not compiled
+  result.units.erase(
+      std::remove(result.units.begin(), result.units.end(), std::string()),
+      result.units.end());
+  result.main_unit = SubstituteGeneratedCode(
+      kProgramSnippet, global_code + kSplitPoint +
+                           GenerateMainCode(main_statements, options));
+  return result;
+}
+
+TranslationUnitSources Compiler::GenerateTranslationUnitSources(
+    const StatementList &statements, const CompileOptions &options,
+    const std::string &runtime_fingerprint) {
+  bool link_runtime = !runtime_fingerprint.empty();
+  auto units = GenerateTranslationUnits(statements, options);
+  TranslationUnitSources result;
+
+  // Units of lets and defs only need the vector operations, not the whole
+  // runtime. Objects built against the prebuilt runtime's headers go stale
+  // with it, so its fingerprint is part of every identity.
+  std::string unit_prelude =
+      link_runtime ? kKernelsInclude : std::string(kBoyoKernelsHeaderSource);
+  std::string unit_fingerprint =
+      Sha256::Hash(unit_prelude) + runtime_fingerprint;
+  if (!options.incremental) {
+    unit_prelude += units.header;
+  }
+  for (size_t i = 0; i < units.units.size(); ++i) {
+    result.sources.push_back(unit_prelude + units.units[i]);
+    result.identities.push_back(
+        unit_fingerprint +
+        (options.incremental ? units.hashes[i] : result.sources.back()));
+  }
+
+  std::string prelude =
+      link_runtime ? kRuntimeInclude : std::string(kBoyoRuntimeHeaderSource);
+  result.sources.push_back(
+      prelude + units.header +
+      (link_runtime ? "" : std::string(kBoyoRuntimeImplementationSource)) +
+      units.main_unit);
+  // main() is identified like the definitions, by the fingerprint and a
+  // hash of its code
+  result.identities.push_back(unit_fingerprint +
+                              Sha256::Hash(result.sources.back()));
+  return result;
+}
+
+std::string Compiler::EntrySymbol(const std::string &def, size_t params) {
+  return "boyo_entry_" + def + "_" + std::to_string(params);
+}
+
+std::string Compiler::LibrarySymbol(const StatementList &statements,
+                                    const std::string &def, size_t params) {
+  size_t overloads = 0;
+  for (const auto &statement : statements) {
+    if (auto *def_stmt = dynamic_cast<const DefStatement *>(statement.get())) {
+      overloads += def_stmt->GetFuncName() == def ? 1 : 0;
+    }
+  }
+  return overloads > 1 ? def + "_" + std::to_string(params) : def;
+}
+
+// Whether a library cannot export name: C keywords that are not C++ ones
+// (IsReservedName covers those), functions and macros of the standard C
+// library, which callers link and include alongside the library, and
+// names reserved for boyo's own symbols
+static bool IsReservedLibrarySymbol(const std::string &name) {
+  static const std::set<std::string> kCNames = {
+      // Keywords
+      "restrict", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex",
+      "_Generic", "_Imaginary", "_Noreturn", "_Static_assert",
+      "_Thread_local",
+      // <assert.h>, <errno.h>, <setjmp.h>, <signal.h>, <stdarg.h>
+      "assert", "errno", "setjmp", "longjmp", "signal", "raise", "va_start",
+      "va_arg", "va_end", "va_copy",
+      // <ctype.h>
+      "isalnum", "isalpha", "isblank", "iscntrl", "isdigit", "isgraph",
+      "islower", "isprint", "ispunct", "isspace", "isupper", "isxdigit",
+      "tolower", "toupper",
+      // <locale.h>, <time.h>
+      "setlocale", "localeconv", "clock", "difftime", "mktime", "time",
+      "asctime", "ctime", "gmtime", "localtime", "strftime", "timespec_get",
+      // <math.h>
+      "abs", "acos", "acosh", "asin", "asinh", "atan", "atan2", "atanh",
+      "cbrt", "ceil", "copysign", "cos", "cosh", "erf", "erfc", "exp",
+      "exp2", "expm1", "fabs", "fdim", "floor", "fma", "fmax", "fmin",
+      "fmod", "frexp", "hypot", "ilogb", "ldexp", "lgamma", "llrint",
+      "llround", "log", "log10", "log1p", "log2", "logb", "lrint", "lround",
+      "modf", "nan", "nearbyint", "nextafter", "nexttoward", "pow",
+      "remainder", "remquo", "rint", "round", "scalbln", "scalbn", "sin",
+      "sinh", "sqrt", "tan", "tanh", "tgamma", "trunc",
+      // <stdio.h>
+      "clearerr", "fclose", "feof", "ferror", "fflush", "fgetc", "fgetpos",
+      "fgets", "fopen", "fprintf", "fputc", "fputs", "fread", "freopen",
+      "fscanf", "fseek", "fsetpos", "ftell", "fwrite", "getc", "getchar",
+      "gets", "perror", "printf", "putc", "putchar", "puts", "remove",
+      "rename", "rewind", "scanf", "setbuf", "setvbuf", "snprintf",
+      "sprintf", "sscanf", "tmpfile", "tmpnam", "ungetc", "vfprintf",
+      "vfscanf", "vprintf", "vscanf", "vsnprintf", "vsprintf", "vsscanf",
+      "stdin", "stdout", "stderr",
+      // <stdlib.h>
+      "abort", "aligned_alloc", "at_quick_exit", "atexit", "atof", "atoi",
+      "atol", "atoll", "bsearch", "calloc", "div", "exit", "free", "getenv",
+      "labs", "ldiv", "llabs", "lldiv", "malloc", "mblen", "mbstowcs",
+      "mbtowc", "qsort", "quick_exit", "rand", "realloc", "srand", "strtod",
+      "strtof", "strtol", "strtold", "strtoll", "strtoul", "strtoull",
+      "system", "wcstombs", "wctomb", "_Exit",
+      // <string.h>
+      "memchr", "memcmp", "memcpy", "memmove", "memset", "strcat", "strchr",
+      "strcmp", "strcoll", "strcpy", "strcspn", "strerror", "strlen",
+      "strncat", "strncmp", "strncpy", "strpbrk", "strrchr", "strspn",
+      "strstr", "strtok", "strxfrm",
+      // Macros of <stddef.h>, which the header includes
+      "offsetof", "NULL"};
+  return kCNames.count(name) > 0 || name.rfind("boyo_", 0) == 0 ||
+         name.rfind("__", 0) == 0;
+}
+
+// The defs of a library with their exported names, which must be unique
+// and free for a C program to link
+static std::vector<std::pair<const DefStatement *, std::string>>
+LibraryExports(const StatementList &statements) {
+  std::vector<std::pair<const DefStatement *, std::string>> exports;
+  std::set<std::string> names;
+  for (const auto &statement : statements) {
+    if (auto *def_stmt = dynamic_cast<const DefStatement *>(statement.get())) {
+      std::string symbol = Compiler::LibrarySymbol(
+          statements, def_stmt->GetFuncName(), def_stmt->GetParams().size());
+      if (IsReservedLibrarySymbol(symbol)) {
+        throw std::runtime_error("Def " + def_stmt->GetFuncName() +
+                                 " would be exported as " + symbol +
+                                 ", which C reserves; rename it");
+      }
+      if (!names.insert(symbol).second) {
+        throw std::runtime_error("Two defs would be exported as " + symbol);
+      }
+      exports.emplace_back(def_stmt, symbol);
+    }
+  }
+  return exports;
+}
+
+std::string Compiler::GenerateLibraryCode(const StatementList &statements,
+                                          bool call_entries) {
+  auto exports = LibraryExports(statements);
+  std::string code = "#include <array>\n"
+                     "#include <cstddef>\n"
+                     "#include <cstdint>\n\n"
+                     "#pragma GCC visibility push(hidden)\n";
+  for (const auto &statement : statements) {
+    if (auto *let_stmt = dynamic_cast<const LetStatement *>(statement.get())) {
+      code += let_stmt->GenerateConstantCode();
+    }
+  }
+  for (const auto &[def_stmt, symbol] : exports) {
+    code += "extern \"C\" __attribute__((visibility(\"default\"))) " +
+            def_stmt->GenerateSpanDeclarationCode(symbol) + ";\n";
+    code += def_stmt->GenerateSpanCode(symbol);
+    if (call_entries) {
+      size_t params = def_stmt->GetParams().size();
+      code += "extern \"C\" __attribute__((visibility(\"default\"))) size_t " +
+              CallSymbol(def_stmt->GetFuncName(), params) +
+              "(const uint8_t* const* data, const size_t* lengths, "
+              "uint8_t* out, size_t out_cap) {\n  return " + symbol + "(";
+      for (size_t i = 0; i < params; ++i) {
+        code += "data[" + std::to_string(i) + "], lengths[" +
+                std::to_string(i) + "], ";
+      }
+      code += "out, out_cap);\n}\n";
+    }
+  }
+  return code + "#pragma GCC visibility pop\n";
+}
+
+std::string Compiler::GenerateLibraryHeader(const StatementList &statements,
+                                            const std::string &guard) {
+  std::string header =
+      "/* Generated by boyo. Each function computes a def into out and\n"
+      "   returns the length of its result; out is written only if out_cap\n"
+      "   is at least that length. Missing input bytes read as zero. */\n"
+      "#ifndef " + guard + "\n#define " + guard + "\n\n"
+      "#include <stddef.h>\n#include <stdint.h>\n\n"
+      "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n";
+  for (const auto &[def_stmt, symbol] : LibraryExports(statements)) {
+    header += "/* def " + def_stmt->GetFuncName();
+    for (const auto &param : def_stmt->GetParams()) {
+      header += " " + param;
+    }
+    header += " => " + def_stmt->GetBodyExpr().ToString() + " */\n";
+    header += def_stmt->GenerateSpanDeclarationCode(symbol) + ";\n\n";
+  }
+  return header + "#ifdef __cplusplus\n}\n#endif\n\n#endif\n";
+}
+
+std::string Compiler::CallSymbol(const std::string &def, size_t params) {
+  return "boyo_call_" + def + "_" + std::to_string(params);
+}
+
+std::string Compiler::GlobalSymbol(const std::string &let) {
+  return "boyo_global_" + let;
+}
+
+std::string
+Compiler::GenerateSharedObjectCode(const StatementList &statements,
+                                   const std::vector<std::string> &defs) {
+  // Statements only refer to earlier ones, so walking backwards from the
+  // named defs reaches everything they use
+  std::set<std::string> wanted(defs.begin(), defs.end());
+  for (auto it = statements.rbegin(); it != statements.rend(); ++it) {
+    if (wanted.count(DefinedName(**it))) {
+      for (const auto &dependency : (*it)->GetDependencies()) {
+        wanted.insert(dependency);
+      }
     }
   }
 
-  return global_code + "{boyo_split_point}" + main_code;
+  std::string code;
+  for (const auto &statement : statements) {
+    std::string name = DefinedName(*statement);
+    if (name.empty() || (!defs.empty() && !wanted.count(name))) {
+      continue;
+    }
+    code += statement->GenerateCode();
+    if (auto *def_stmt = dynamic_cast<const DefStatement *>(statement.get())) {
+      size_t params = def_stmt->GetParams().size();
+      code += "extern \"C\" void " + EntrySymbol(name, params) +
+              "(const std::vector<uint8_t>* const* args, "
+              "std::vector<uint8_t>* result) {\n  *result = " +
+              name + "(";
+      for (size_t i = 0; i < params; ++i) {
+        code += (i > 0 ? ", *args[" : "*args[") + std::to_string(i) + "]";
+      }
+      code += ");\n}\n";
+
+    } else {
+      code += "extern \"C\" std::vector<uint8_t>* " + GlobalSymbol(name) +
+              "() { return &" + name + "; }\n";
+    }
+  }
+  return code;
 }
 
 std::string Compiler::GetMainFunctionSnippet() { return kMainFunctionSnippet; }
 
+bool Compiler::RuntimeLibraryAvailable() {
+  std::error_code error;
+  return std::filesystem::is_regular_file(BOYO_RUNTIME_LIBRARY, error) &&
+         std::filesystem::is_regular_file(
+             BOYO_RUNTIME_INCLUDE_DIR "/runtime/boyo_runtime.hpp", error);
+}
+
+std::vector<std::string>
+Compiler::GetCompilerFlags(const CompileOptions &options) {
+  std::vector<std::string> flags = kCompilerFlags;
+
+  std::string opt_level = options.opt_level;
+  if (opt_level.empty() && options.size_profile) {
+    opt_level = "s";
+  } else if (opt_level.empty() && !options.pgo_runs.empty()) {
+    opt_level = "2";
+  }
+  if (!opt_level.empty()) {
+    if (std::find(kOptLevels.begin(), kOptLevels.end(), opt_level) ==
+        kOptLevels.end()) {
+      throw std::runtime_error("Unknown optimization level: " + opt_level);
+    }
+    flags.push_back("-O" + opt_level);
+  }
+
+  if (!options.march.empty()) {
+    // Only a plain CPU name, so the value cannot smuggle further g++
+    // options into the command line
+    if (options.march.find_first_not_of(
+            "abcdefghijklmnopqrstuvwxyz0123456789-_.") != std::string::npos) {
+      throw std::runtime_error("Invalid -march value: " + options.march);
+    }
+    flags.push_back("-march=" + options.march);
+  }
+
+  if (options.lto) {
+    flags.push_back("-flto");
+  }
+
+  if (options.size_profile) {
+    flags.insert(flags.end(), {"-ffunction-sections", "-fdata-sections",
+                               "-Wl,--gc-sections", "-s"});
+  }
+  return flags;
+}
+
+// Whether the options ask for an optimized build, which compiles the
+// runtime source into the program rather than linking the prebuilt library
+static bool IsOptimizedBuild(const CompileOptions &options) {
+  return (!options.opt_level.empty() && options.opt_level != "0") ||
+         !options.march.empty() || options.lto || options.size_profile ||
+         !options.pgo_runs.empty();
+}
+
+// Arguments that compile the source on stdin straight to output_file. -pipe
+// keeps g++'s intermediate files in memory, so only the output is written.
+static std::vector<std::string> SourceArgs(const std::vector<std::string> &flags,
+                                           const std::string &output_file,
+                                           bool link_runtime) {
+  std::vector<std::string> args = flags;
+  args.insert(args.end(), {"-pipe", "-o", output_file, "-x", "c++", "-"});
+  if (link_runtime) {
+    args.insert(args.end(), {"-x", "none", BOYO_RUNTIME_LIBRARY});
+  }
+  return args;
+}
+
+// Run g++ with args, piping source to its stdin
+// @param target What is being built, for error messages
+// @throws CompileError with g++'s diagnostics if g++ fails
+static void RunCompiler(const std::vector<std::string> &args,
+                        const std::string &source, const std::string &target) {
+  std::vector<std::string> command = {gpp_path};
+  command.insert(command.end(), args.begin(), args.end());
+
+  std::string compiler_output;
+  int exit_code = 0;
+  try {
+    Subprocess gpp(command);
+    gpp.Write(source);
+    exit_code = gpp.Wait();
+    compiler_output = gpp.GetOutput();
+  } catch (const std::runtime_error &e) {
+    throw std::runtime_error(
+        std::string("Failed to execute compiler command: ") + e.what());
+  }
+
+  if (exit_code != 0) {
+    throw CompileError("Failed to compile program: " + target,
+                       compiler_output);
+  }
+}
+
+// Build an instrumented binary, run it once per training run, then rebuild
+// output_file with the collected profile. Profiles are written to a
+// workspace directory next to the output, which is kept for inspection.
+static void RunProfileGuidedBuild(const std::vector<std::string> &flags,
+                                  const std::vector<std::string> &pgo_runs,
+                                  const std::string &source,
+                                  const std::string &output_file) {
+  std::filesystem::path workspace =
+      std::filesystem::absolute(output_file + ".pgo");
+  std::filesystem::remove_all(workspace);
+  std::filesystem::create_directories(workspace);
+
+  std::vector<std::string> generate_flags = flags;
+  generate_flags.push_back("-fprofile-generate=" + workspace.string());
+  // Generated programs may evaluate on several threads
+  generate_flags.push_back("-fprofile-update=prefer-atomic");
+  RunCompiler(SourceArgs(generate_flags, output_file, false), source,
+              output_file);
+
+  for (const auto &run : pgo_runs) {
+    std::vector<std::string> args = {
+        std::filesystem::absolute(output_file).string()};
+    std::istringstream run_args(run);
+    std::string arg;
+    while (run_args >> arg) {
+      args.push_back(arg);
+    }
+    Subprocess training(args, false);
+    if (training.Wait() != 0) {
+      throw std::runtime_error("PGO training run failed: " + run);
+    }
+  }
+
+  // Code the training runs never reached is still optimized normally
+  std::vector<std::string> use_flags = flags;
+  use_flags.push_back("-fprofile-use=" + workspace.string());
+  use_flags.push_back("-fprofile-partial-training");
+  use_flags.push_back("-Wno-missing-profile");
+  RunCompiler(SourceArgs(use_flags, output_file, false), source, output_file);
+}
+
+// Compile every translation unit to an object concurrently, then link them
+// into output_file. At most `jobs` g++ processes run at once (0 = one per
+// hardware thread), and fewer when a make jobserver has no free slots.
+// Objects are built in object_dir, or a scratch directory that is removed
+// afterwards when it is empty, and reused from and stored in the cache when
+// one is given, keyed by identities: what determines each unit's object,
+// either its source or, for incremental units, a content hash.
+static void BuildTranslationUnits(const std::vector<std::string> &sources,
+                                  const std::vector<std::string> &identities,
+                                  const std::vector<std::string> &flags,
+                                  const std::string &output_file,
+                                  bool link_runtime, size_t jobs,
+                                  CompileCache *cache,
+                                  const std::string &object_dir) {
+  auto jobserver = JobServer::FromEnvironment();
+  if (jobs == 0 && jobserver) {
+    jobs = sources.size();
+  }
+
+  std::filesystem::path scratch = object_dir;
+  if (object_dir.empty()) {
+    std::string scratch_template =
+        (std::filesystem::temp_directory_path() / "boyo-units-XXXXXX")
+            .string();
+    if (mkdtemp(scratch_template.data()) == nullptr) {
+      throw std::runtime_error("Failed to create directory for objects");
+    }
+    scratch = scratch_template;
+  } else {
+    std::filesystem::create_directories(scratch);
+  }
+  auto cleanup = [&]() {
+    if (object_dir.empty()) {
+      std::filesystem::remove_all(scratch);
+    }
+  };
+
+  std::vector<std::string> object_flags = flags;
+  object_flags.push_back("-c");
+  std::vector<std::string> objects(sources.size());
+  std::atomic<bool> failed{false};
+  try {
+    ParallelFor(sources.size(), jobs, [&](size_t i) {
+      std::string key;
+      if (cache || !object_dir.empty()) {
+        key = CompileCache::Key(identities[i], gpp_path, GetCompilerVersion(),
+                                object_flags);
+      }
+      objects[i] =
+          (scratch / (object_dir.empty() ? "unit" + std::to_string(i) : key))
+              .string() +
+          ".o";
+      if (failed) {
+        return; // One failed unit fails the build; skip the rest
+      }
+      std::error_code error;
+      if (!object_dir.empty() &&
+          std::filesystem::is_regular_file(objects[i], error)) {
+        return; // Kept from an earlier build
+      }
+      if (cache && cache->Fetch(key, objects[i])) {
+        return;
+      }
+
+      JobServer::Token token = JobServer::kImplicitToken;
+      if (jobserver) {
+        token = jobserver->Acquire();
+      }
+      try {
+        // Kept objects are renamed into place, so an interrupted build
+        // never leaves a partial one behind for the next
+        std::string object =
+            object_dir.empty() ? objects[i] : objects[i] + ".tmp";
+        RunCompiler(SourceArgs(object_flags, object, false), sources[i],
+                    output_file + " (unit " + std::to_string(i) + ")");
+        if (object != objects[i]) {
+          std::filesystem::rename(object, objects[i]);
+        }
+      } catch (...) {
+        failed = true;
+        if (jobserver) {
+          jobserver->Release(token);
+        }
+        throw;
+      }
+      if (jobserver) {
+        jobserver->Release(token);
+      }
+
+      if (cache) {
+        cache->Store(key, objects[i]);
+      }
+    });
+
+    std::vector<std::string> args = flags;
+    args.insert(args.end(), {"-o", output_file});
+    args.insert(args.end(), objects.begin(), objects.end());
+    if (link_runtime) {
+      args.push_back(BOYO_RUNTIME_LIBRARY);
+    }
+    RunCompiler(args, "", output_file);
+  } catch (...) {
+    cleanup();
+    throw;
+  }
+  cleanup();
+
+  if (!object_dir.empty()) {
+    // Drop objects of definitions that have since changed
+    std::set<std::string> used(objects.begin(), objects.end());
+    std::error_code error;
+    for (const auto &file :
+         std::filesystem::directory_iterator(scratch, error)) {
+      if (!used.count(file.path().string())) {
+        std::filesystem::remove(file.path(), error);
+      }
+    }
+  }
+}
+
+// Build output_file from sources: one per translation unit when split, with
+// identities naming each unit's object (see BuildTranslationUnits), or a
+// single source otherwise. A shared object is built position independent.
+static void BuildProgram(const CompileOptions &options,
+                         const std::vector<std::string> &sources,
+                         const std::vector<std::string> &identities,
+                         bool split, bool link_runtime,
+                         const std::string &output_file,
+                         bool shared_object = false) {
+  std::vector<std::string> flags = Compiler::GetCompilerFlags(options);
+  if (shared_object) {
+    flags.insert(flags.end(), {"-shared", "-fPIC"});
+  }
+  if (link_runtime) {
+    flags.insert(flags.end(), GetRuntimeFlags().begin(),
+                 GetRuntimeFlags().end());
+  }
+
+  // Identical source, compiler, flags and runtime always build the same
+  // binary. PGO builds also depend on their training data, so they are not
+  // cached. Incremental builds always keep their objects in the cache.
+  std::unique_ptr<CompileCache> cache;
+  std::string cache_key;
+  if ((options.use_cache || options.incremental) &&
+      options.pgo_runs.empty()) {
+    cache = std::make_unique<CompileCache>(
+        options.cache_dir.empty() ? CompileCache::DefaultDirectory()
+                                  : std::filesystem::path(options.cache_dir),
+        options.cache_max_bytes);
+  }
+  if (cache && options.use_cache) {
+    std::vector<std::string> key_flags = flags;
+    if (link_runtime) {
+      key_flags.push_back(GetRuntimeFingerprint());
+    }
+    std::string program = sources[0];
+    for (size_t i = 1; i < sources.size(); ++i) {
+      program += "\n// boyo translation unit\n" + sources[i];
+    }
+    cache_key = CompileCache::Key(program, gpp_path, GetCompilerVersion(),
+                                  key_flags);
+    if (cache->Fetch(cache_key, output_file)) {
+      return;
+    }
+  }
+
+  if (split) {
+    BuildTranslationUnits(sources, identities, flags, output_file,
+                          link_runtime, options.jobs, cache.get(),
+                          options.incremental ? options.object_dir : "");
+  } else if (options.pgo_runs.empty()) {
+    RunCompiler(SourceArgs(flags, output_file, link_runtime), sources[0],
+                output_file);
+  } else {
+    RunProfileGuidedBuild(flags, options.pgo_runs, sources[0], output_file);
+  }
+
+  if (!cache_key.empty()) {
+    cache->Store(cache_key, output_file);
+  }
+}
+
 /**
   Compile the given lines of code into a binary executable
   @param lines The lines of code to compile
   @param output_file The path to the output file
   @return The path to the compiled executable
-  @throws std::runtime_error if the program fails to compile
+  @throws CompileError if g++ rejects the generated program
+  @throws std::runtime_error if the program is invalid or g++ cannot run
 */
 void Compiler::compile(const std::vector<std::string> &lines,
-                       const std::string &output_file) {
+                       const std::string &output_file) const {
   Parser parser;
-  auto statements = parser.Parse(lines);
+  compile(parser.Parse(lines), output_file);
+}
 
-  auto program_code = GenerateProgramCode(statements);
+// Compile statements parsed earlier, e.g. kept by a watch session
+void Compiler::compile(const StatementList &statements,
+                       const std::string &output_file) const {
+  bool split = options_.translation_units > 1 || options_.incremental;
+  if (split && !options_.pgo_runs.empty()) {
+    throw std::runtime_error(
+        "PGO cannot be combined with multiple translation units");
+  }
 
-  auto main_function =
-      SubstituteGeneratedCode(kMainFunctionSnippet, program_code);
+  // Programs linked against the prebuilt runtime only compile their own
+  // statements; otherwise the runtime source is compiled in
+  bool link_runtime = options_.link_runtime && !IsOptimizedBuild(options_) &&
+                      RuntimeLibraryAvailable();
 
-  // Write the C++ code to a temporary file
-  std::string temp_cpp_file = output_file + ".cpp";
-  std::ofstream cpp_out(temp_cpp_file);
-  if (!cpp_out) {
-    std::fprintf(stderr, "Error: Failed to create temporary C++ file: %s\n",
-                 temp_cpp_file.c_str());
-    throw std::runtime_error("Failed to create temporary C++ file: " +
-                             temp_cpp_file);
+  // One source per translation unit; the last one holds main()
+  std::vector<std::string> sources;
+  std::vector<std::string> identities;
+  if (split) {
+    auto units = GenerateTranslationUnitSources(
+        statements, options_, link_runtime ? GetRuntimeFingerprint() : "");
+    sources = std::move(units.sources);
+    identities = std::move(units.identities);
+  } else {
+    sources.push_back(SubstituteGeneratedCode(
+        link_runtime ? kLinkedMainFunctionSnippet : kMainFunctionSnippet,
+        GenerateProgramCode(statements, options_)));
   }
-  cpp_out << main_function;
-  cpp_out.close();
 
-  // Compile the C++ file to the output binary
-  std::string command = gpp_path + " -std=c++17 -o " + output_file + " " +
-                        temp_cpp_file + " 2>&1";
+  BuildProgram(options_, sources, identities, split, link_runtime,
+               output_file);
+}
 
-  // Capture compiler output
-  FILE *pipe = popen(command.c_str(), "r");
-  if (!pipe) {
-    std::remove(temp_cpp_file.c_str());
-    std::fprintf(stderr, "Error: Failed to execute compiler command\n");
-    throw std::runtime_error("Failed to execute compiler command");
+void Compiler::compile(const std::vector<FusedProgram> &programs,
+                       const std::string &output_file) const {
+  if (options_.translation_units > 1 || options_.incremental) {
+    throw std::runtime_error(
+        "Fused programs are built as a single translation unit");
   }
+  bool link_runtime = options_.link_runtime && !IsOptimizedBuild(options_) &&
+                      RuntimeLibraryAvailable();
+  std::vector<std::string> sources = {SubstituteGeneratedCode(
+      link_runtime ? kLinkedMainFunctionSnippet : kMainFunctionSnippet,
+      GenerateFusedProgramCode(programs, options_))};
+  BuildProgram(options_, sources, {}, false, link_runtime, output_file);
+}
 
-  std::string compiler_output;
-  char buffer[128];
-  while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-    compiler_output += buffer;
+void Compiler::compile_shared_object(const StatementList &statements,
+                                     const std::string &output_file,
+                                     const std::vector<std::string> &defs) const {
+  if (!options_.pgo_runs.empty()) {
+    throw std::runtime_error("Shared objects cannot be built with PGO");
   }
+  bool link_runtime = options_.link_runtime && !IsOptimizedBuild(options_) &&
+                      RuntimeLibraryAvailable();
+  std::string prelude = link_runtime
+                            ? kRuntimeInclude
+                            : std::string(kBoyoRuntimeHeaderSource) +
+                                  kBoyoRuntimeImplementationSource;
+  std::vector<std::string> sources = {
+      prelude + GenerateSharedObjectCode(statements, defs)};
+  BuildProgram(options_, sources, {}, false, link_runtime, output_file, true);
+}
 
-  int result = pclose(pipe);
-  int exit_code = 0;
-  if (WIFEXITED(result)) {
-    exit_code = WEXITSTATUS(result);
-  } else {
-    exit_code = result;
+void Compiler::compile_library(const StatementList &statements,
+                               const std::string &output_file,
+                               const std::string &header_file,
+                               bool call_entries) const {
+  bool static_library =
+      std::filesystem::path(output_file).extension() == ".a";
+  if (!options_.pgo_runs.empty()) {
+    throw std::runtime_error("Libraries cannot be built with PGO");
+  }
+  if (static_library && options_.lto) {
+    throw std::runtime_error("Static libraries cannot be built with LTO");
   }
 
-  // Clean up the temporary C++ file
-  std::remove(temp_cpp_file.c_str());
+  // Kernels are what callers link for, so they are optimized by default;
+  // -O3 vectorizes their loops behind a runtime check that out does not
+  // overlap the inputs, which -O2's cost model does not allow
+  CompileOptions options = options_;
+  if (options.opt_level.empty() && !options.size_profile) {
+    options.opt_level = "3";
+  }
+  std::string source = GenerateLibraryCode(statements, call_entries);
+  if (!static_library) {
+    BuildProgram(options, {source}, {}, false, false, output_file, true);
+  } else {
+    std::string scratch_template =
+        (std::filesystem::temp_directory_path() / "boyo-lib-XXXXXX").string();
+    if (mkdtemp(scratch_template.data()) == nullptr) {
+      throw std::runtime_error("Failed to create directory for objects");
+    }
+    std::filesystem::path scratch = scratch_template;
+    try {
+      std::vector<std::string> flags = GetCompilerFlags(options);
+      flags.insert(flags.end(), {"-fPIC", "-c"});
+      std::string object = (scratch / "boyo_lib.o").string();
+      RunCompiler(SourceArgs(flags, object, false), source, output_file);
 
-  if (exit_code != 0) {
-    // Log boyo error first
-    std::fprintf(stderr, "Error: Failed to compile program: %s\n",
-                 output_file.c_str());
-
-    // Then log compiler output with proper formatting
-    if (!compiler_output.empty()) {
-      std::fprintf(stderr, "\nCompiler output:\n");
-      std::istringstream iss(compiler_output);
-      std::string line;
-      while (std::getline(iss, line)) {
-        // Remove trailing newline if present (getline already does this, but be
-        // safe)
-        if (!line.empty() && line.back() == '\n') {
-          line.pop_back();
-        }
-        std::fprintf(stderr, "| %s\n", line.c_str());
+      std::filesystem::remove(output_file);
+      Subprocess ar({ar_path, "rcs", output_file, object});
+      if (ar.Wait() != 0) {
+        throw std::runtime_error("Failed to archive " + output_file + ": " +
+                                 ar.GetOutput());
       }
+    } catch (...) {
+      std::filesystem::remove_all(scratch);
+      throw;
     }
+    std::filesystem::remove_all(scratch);
+  }
+
+  if (header_file.empty()) {
+    return;
+  }
+  std::string guard;
+  for (unsigned char c :
+       std::filesystem::path(header_file).filename().string()) {
+    guard += std::isalnum(c) ? static_cast<char>(std::toupper(c)) : '_';
+  }
+  std::ofstream header(header_file);
+  header << GenerateLibraryHeader(statements, "BOYO_" + guard);
+  if (!header) {
+    throw std::runtime_error("Failed to write header: " + header_file);
+  }
+}
+
+void Compiler::exec(const StatementList &statements,
+                    const std::vector<std::string> &args) const {
+  if (!options_.pgo_runs.empty()) {
+    throw std::runtime_error("PGO builds cannot be executed from memory");
+  }
+
+  // g++, the linker and the cache write the binary through /proc/self/fd,
+  // so the descriptor stays open across their exec until the build is done
+  int fd = memfd_create("boyo-exec", 0);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Failed to create in-memory file: ") +
+                             std::strerror(errno));
+  }
+  try {
+    compile(statements, "/proc/self/fd/" + std::to_string(fd));
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
 
-    throw std::runtime_error("Failed to compile program: " + output_file);
+  std::vector<char *> argv = {const_cast<char *>("boyo-exec")};
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
   }
+  argv.push_back(nullptr);
+  std::fflush(stdout);
+  fexecve(fd, argv.data(), environ);
+  int error = errno;
+  close(fd);
+  throw std::runtime_error(std::string("Failed to execute program: ") +
+                           std::strerror(error));
 }
 
 } // namespace boyo
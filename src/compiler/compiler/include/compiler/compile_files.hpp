@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+
+namespace boyo {
+
+/**
+ * Outcome of compiling one file with CompileFiles
+ */
+struct FileCompileResult {
+  std::string input_file;
+  std::string output_file;
+  bool success = false;
+
+  // Why the file failed, and g++'s diagnostics if g++ rejected it
+  std::string error;
+  std::string diagnostics;
+
+  // Wall time spent on this file
+  double seconds = 0;
+};
+
+/**
+ * Compile many programs in one process. Each file is read, parsed,
+ * generated and compiled on a pool of `jobs` workers (0 = one per hardware
+ * thread), each running one g++ at a time, so at most `jobs` g++ processes
+ * run at once; under a GNU make jobserver every file also takes a job slot.
+ * A failing file does not stop the others.
+ * @param input_files The .boyo files
+ * @param out_dir Directory the binaries are written to, each named after its
+ * input without the extension (created if needed)
+ * @param options Options for every file; translation units are built one
+ * at a time
+ * @param on_done Called as each file finishes, one call at a time
+ * @return One result per input, in input order
+ * @throws std::runtime_error if two inputs would write the same output
+ */
+std::vector<FileCompileResult>
+CompileFiles(const std::vector<std::string> &input_files,
+             const std::string &out_dir, const CompileOptions &options,
+             size_t jobs,
+             const std::function<void(const FileCompileResult &)> &on_done =
+                 nullptr);
+
+} // namespace boyo
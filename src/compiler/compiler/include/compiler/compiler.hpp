@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -9,11 +12,170 @@
 
 namespace boyo {
 
+/**
+ * How a generated program writes the results of its main statements
+ */
+enum class OutputFormat {
+  kHex,               // "%x " text per byte, one line per result (default)
+  kRaw,               // Raw result bytes back to back
+  kRawLengthPrefixed, // Raw bytes, each result preceded by a uint64 LE length
+};
+
+/**
+ * Options controlling how a Boyo program is turned into an executable
+ */
+struct CompileOptions {
+  // Worker threads used to evaluate independent main statements concurrently
+  // (1 = sequential, 0 = one per hardware thread)
+  size_t threads = 1;
+
+  // Stream main arguments bound at runtime (NAME=- or NAME=@path) and print
+  // the result chunk by chunk in constant memory. Mains run sequentially.
+  bool stream = false;
+
+  // Bytes per chunk in streaming mode
+  size_t stream_chunk_size = size_t{1} << 16;
+
+  // Result encoding; raw formats write to stdout or --output=PATH given to
+  // the generated program at runtime
+  OutputFormat output_format = OutputFormat::kHex;
+
+  // Apply the single main statement to every record read at runtime from
+  // --records=@path or stdin, on `threads` workers (see boyo_run_batch)
+  bool batch = false;
+
+  // Link against the prebuilt boyo_runtime library and its precompiled
+  // header instead of compiling the embedded runtime source into every
+  // program. Ignored when the library is not available, and for optimized
+  // builds (any of the options below), which compile the runtime source
+  // with the program so -march, LTO and PGO apply to it too.
+  bool link_runtime = true;
+
+  // Optimization level passed to g++ as -O<level>: 0, 1, 2, 3, s, z, g or
+  // fast. Empty means no -O flag, or 2 for PGO builds.
+  std::string opt_level;
+
+  // Target architecture passed to g++ as -march (e.g. native); empty means
+  // g++'s default
+  std::string march;
+
+  // Link-time optimization
+  bool lto = false;
+
+  // Size-optimized profile: -Os (unless opt_level is set), unused sections
+  // garbage collected at link time and symbols stripped
+  bool size_profile = false;
+
+  // Profile-guided optimization: program arguments of each training run
+  // (e.g. "A=@train.bin B=0x03"). An instrumented binary is built and run
+  // once per entry, then the program is rebuilt with the collected profile,
+  // which is kept in the <output>.pgo directory.
+  std::vector<std::string> pgo_runs;
+
+  // Split the program into this many translation units compiled
+  // concurrently and then linked; lets and defs are assigned to units by a
+  // hash of their name, so the assignment is stable as the program changes
+  size_t translation_units = 1;
+
+  // Compile every let and def into its own object, cached under its
+  // content hash (see Compiler::ComputeContentHashes), so a rebuild only
+  // recompiles what changed and relinks. Objects are kept in the compile
+  // cache whether or not use_cache is set; translation_units is ignored.
+  bool incremental = false;
+
+  // Directory that keeps the objects of incremental builds between
+  // compiles, named by cache key, so unchanged units are not even looked up
+  // in the cache; objects the latest build did not use are removed. Empty
+  // means a scratch directory per compile.
+  std::string object_dir;
+
+  // Maximum concurrent g++ processes for translation units (0 = one per
+  // hardware thread, or as many as a GNU make jobserver in MAKEFLAGS allows)
+  size_t jobs = 0;
+
+  // Reuse binaries from the on-disk compile cache (see CompileCache)
+  bool use_cache = false;
+
+  // Cache location; empty means CompileCache::DefaultDirectory()
+  std::string cache_dir;
+
+  // Cache size limit before least recently used entries are evicted
+  uint64_t cache_max_bytes = uint64_t{1} << 30;
+};
+
+/**
+ * A program split into translation units, without the runtime
+ */
+struct TranslationUnits {
+  // Declarations of every let and def, shared by all units
+  std::string header;
+
+  // Let and def definitions, one entry per non-empty unit. Incremental
+  // units hold one definition, preceded by the declarations it uses, and do
+  // not need the shared header.
+  std::vector<std::string> units;
+
+  // Content hash of the definition in each incremental unit
+  std::vector<std::string> hashes;
+
+  // The unit holding main()
+  std::string main_unit;
+};
+
+/**
+ * The sources g++ compiles for a program split into translation units,
+ * and what each object is cached under
+ */
+struct TranslationUnitSources {
+  // One source per unit; the last one holds main()
+  std::vector<std::string> sources;
+
+  // Identity of each source for CompileCache::Key, covering everything its
+  // object depends on besides the flags
+  std::vector<std::string> identities;
+};
+
+/**
+ * One of several programs built into a single multi-call binary
+ */
+struct FusedProgram {
+  // Name the program is run by: the binary's name (through a symlink) or
+  // its first argument
+  std::string name;
+  StatementList statements;
+};
+
+/**
+ * A generated program g++ rejected, carrying g++'s diagnostics so callers
+ * can show them wherever the compile was requested from
+ */
+class CompileError : public std::runtime_error {
+ public:
+  CompileError(const std::string& message, std::string diagnostics);
+
+  // g++'s output
+  const std::string& GetDiagnostics() const { return diagnostics_; }
+
+  // The diagnostics as shown after the error message: a "Compiler output:"
+  // heading and every line prefixed with "| ", or empty if there are none
+  std::string FormatDiagnostics() const;
+
+ private:
+  std::string diagnostics_;
+};
+
+/**
+ * Turns Boyo programs into executables. compile() only reads the options,
+ * so one Compiler may be used from several threads at once.
+ */
 class Compiler {
  public:
   // Constructor
   Compiler();
 
+  // Constructor with compile options
+  explicit Compiler(CompileOptions options);
+
   // Destructor
   ~Compiler();
 
@@ -36,15 +198,147 @@ class Compiler {
   // Generate the C++ code for the given statements
   static std::string GenerateProgramCode(const StatementList& statements);
 
-  // Get the main function template snippet
+  // Generate the C++ code for the given statements using the given options
+  static std::string GenerateProgramCode(const StatementList& statements,
+                                         const CompileOptions& options);
+
+  // Generate one program that holds every given program in a namespace of
+  // its own, with a main() that runs the program named by argv[0]'s
+  // basename or, failing that, by the first argument (like busybox)
+  // @throws std::runtime_error for an invalid or duplicate program name
+  static std::string GenerateFusedProgramCode(
+      const std::vector<FusedProgram>& programs,
+      const CompileOptions& options);
+
+  // Split the program for the given statements into
+  // options.translation_units translation units, or one per let and def
+  // when options.incremental is set
+  static TranslationUnits GenerateTranslationUnits(
+      const StatementList& statements, const CompileOptions& options);
+
+  // Generate the sources of GenerateTranslationUnits' units with their
+  // preludes. runtime_fingerprint identifies the prebuilt runtime the units
+  // are linked against and is part of every identity; empty means the
+  // runtime source is compiled in.
+  static TranslationUnitSources GenerateTranslationUnitSources(
+      const StatementList& statements, const CompileOptions& options,
+      const std::string& runtime_fingerprint);
+
+  // Content hash of every let and def, by name: a SHA-256 over its
+  // generated code and the hashes of the lets and defs it refers to, so it
+  // changes whenever the statement or anything it depends on changes
+  // @throws std::runtime_error if definitions refer to each other in a cycle
+  static std::map<std::string, std::string> ComputeContentHashes(
+      const StatementList& statements, const CompileOptions& options);
+
+  // Generate the code of a shared object: the lets and defs of statements,
+  // each def exported as extern "C" EntrySymbol(def, params) and each let as
+  // GlobalSymbol(let). defs limits it to the named defs and the lets they
+  // use; empty means every let and def. Mains are left out.
+  static std::string GenerateSharedObjectCode(
+      const StatementList& statements,
+      const std::vector<std::string>& defs = {});
+
+  // C symbol of a def in a shared object, a
+  // void(const std::vector<uint8_t>* const* args, std::vector<uint8_t>* result)
+  static std::string EntrySymbol(const std::string& def, size_t params);
+
+  // Generate the code of a library for other programs to link: every def
+  // exported as a C function with the ABI of DefStatement::GenerateSpanCode
+  // under LibrarySymbol's name, and nothing else visible. Lets are
+  // compile-time constants; mains are left out. Needs no runtime. With
+  // call_entries, each def is also exported as CallSymbol(def, params) for
+  // callers that look it up with dlsym.
+  // @throws std::runtime_error if two defs would export the same name, or
+  // one a name of the C language or library (such as free or restrict)
+  static std::string GenerateLibraryCode(const StatementList& statements,
+                                         bool call_entries = false);
+
+  // Generate the C header declaring what GenerateLibraryCode exports,
+  // guarded by guard
+  static std::string GenerateLibraryHeader(const StatementList& statements,
+                                           const std::string& guard);
+
+  // C name of a def in a library: the def's name, or <name>_<params> if it
+  // is overloaded
+  static std::string LibrarySymbol(const StatementList& statements,
+                                   const std::string& def, size_t params);
+
+  // C symbol of a def's span kernel in a library taking its inputs as
+  // arrays (see GenerateLibraryCode), a
+  // size_t(const uint8_t* const* data, const size_t* lengths, uint8_t* out,
+  //        size_t out_cap)
+  // so it can be called whatever its number of parameters
+  static std::string CallSymbol(const std::string& def, size_t params);
+
+  // C symbol of a let in a shared object, a std::vector<uint8_t>*() returning
+  // the let's address, through which it can be rebound
+  static std::string GlobalSymbol(const std::string& let);
+
+  // Get the main function template snippet, with the runtime source embedded
   static std::string GetMainFunctionSnippet();
 
+  // Get the g++ flags used to build a program with the given options
+  // @throws std::runtime_error for an unknown optimization level or -march
+  static std::vector<std::string> GetCompilerFlags(
+      const CompileOptions& options);
+
+  // Whether the prebuilt runtime library and header are available to link
+  // generated programs against
+  static bool RuntimeLibraryAvailable();
+
   // Compile the given lines into C++ code
+  // @throws CompileError if g++ rejects the generated program
   void compile(const std::vector<std::string>& lines,
-               const std::string& output_file);
+               const std::string& output_file) const;
+
+  // Compile already parsed statements
+  void compile(const StatementList& statements,
+               const std::string& output_file) const;
+
+  // Compile several programs into one multi-call binary with a single g++
+  // run (see GenerateFusedProgramCode)
+  void compile(const std::vector<FusedProgram>& programs,
+               const std::string& output_file) const;
+
+  // Compile lets and defs into a shared object to load with dlopen (see
+  // GenerateSharedObjectCode); translation unit options are ignored
+  // @throws CompileError if g++ rejects the generated code
+  // @throws std::runtime_error if PGO is requested
+  void compile_shared_object(const StatementList& statements,
+                             const std::string& output_file,
+                             const std::vector<std::string>& defs = {}) const;
+
+  // Compile the defs into a library (see GenerateLibraryCode): a static
+  // library if output_file ends in .a, otherwise a shared object, with its
+  // C header written to header_file unless that is empty. Built at -O3
+  // unless opt_level or size_profile say otherwise; translation unit,
+  // threading and output options do not apply.
+  // @throws CompileError if g++ rejects the generated code
+  // @throws std::runtime_error for PGO, LTO static libraries, clashing
+  // export names, or if the archive or header cannot be written
+  void compile_library(const StatementList& statements,
+                       const std::string& output_file,
+                       const std::string& header_file,
+                       bool call_entries = false) const;
+
+  // Build the program into an anonymous in-memory file (memfd_create)
+  // and replace this process with it (fexecve), so it inherits stdin,
+  // stdout and stderr and no binary is written to disk. The compile cache
+  // applies as it does for compile().
+  // @param args NAME=SOURCE arguments of the program
+  // @throws CompileError if g++ rejects the generated program
+  // @throws std::runtime_error if PGO is requested or the program cannot
+  // be built or started; it does not return otherwise
+  [[noreturn]] void exec(const StatementList& statements,
+                         const std::vector<std::string>& args) const;
+
+  // Get the options used by compile()
+  const CompileOptions& GetOptions() const { return options_; }
 
  private:
   int* data_;
+  CompileOptions options_;
 };
 
 }  // namespace boyo
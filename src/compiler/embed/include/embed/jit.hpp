@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+
+namespace boyo {
+
+class Library;
+
+/**
+ * A def of a Module, callable on caller-owned buffers. Calls go straight to
+ * the def's native kernel: inputs are read in place and the result is
+ * written to the caller's buffer, so nothing is copied or allocated. Thread
+ * safe; keeps its module loaded.
+ */
+class Function {
+public:
+  size_t Params() const { return params_; }
+
+  /**
+   * Compute the def on inputs, one per parameter, into out.
+   * @return The result length; out is only written if it is at least that
+   * long, so a call with an empty out measures the result
+   * @throws std::runtime_error if the number of inputs is not Params()
+   */
+  size_t operator()(std::span<const std::span<const uint8_t>> inputs,
+                    std::span<uint8_t> out) const;
+
+  size_t operator()(std::initializer_list<std::span<const uint8_t>> inputs,
+                    std::span<uint8_t> out) const {
+    return (*this)(std::span(inputs.begin(), inputs.size()), out);
+  }
+
+  // Compute the def into a new vector
+  std::vector<uint8_t>
+  operator()(std::initializer_list<std::span<const uint8_t>> inputs) const;
+
+private:
+  friend class Module;
+
+  using Call = size_t (*)(const uint8_t *const *data, const size_t *lengths,
+                          uint8_t *out, size_t out_cap);
+
+  Function(std::shared_ptr<const Library> library, Call call, size_t params)
+      : library_(std::move(library)), call_(call), params_(params) {}
+
+  std::shared_ptr<const Library> library_;
+  Call call_;
+  size_t params_;
+};
+
+/**
+ * The defs of a program compiled by Jit::Compile. Lets keep the values the
+ * source gives them. Copies share the loaded code.
+ */
+class Module {
+public:
+  /**
+   * The def called name.
+   * @throws std::runtime_error if there is no such def, or several
+   * overloads of it
+   */
+  Function Get(const std::string &name) const;
+
+  // The overload of name taking params inputs
+  // @throws std::runtime_error if there is no such def
+  Function Get(const std::string &name, size_t params) const;
+
+private:
+  friend class Jit;
+
+  explicit Module(std::shared_ptr<const Library> library)
+      : library_(std::move(library)) {}
+
+  std::shared_ptr<const Library> library_;
+};
+
+/**
+ * Compiles Boyo source into native code loaded into this process, for
+ * calling defs from C++. Source is built with the Compiler's g++ path into
+ * a shared library of span kernels (see Compiler::GenerateLibraryCode),
+ * which is loaded with dlopen and whose file is removed straight away.
+ */
+class Jit {
+public:
+  /**
+   * Compile source, or return the module already loaded for the same
+   * source and options. Builds are -O3 unless options say otherwise (see
+   * Compiler::compile_library); with options.use_cache, they also go
+   * through the on-disk compile cache.
+   * @throws std::runtime_error if the program is invalid or cannot be
+   * built or loaded (CompileError if g++ rejects it)
+   */
+  static Module Compile(std::string_view source,
+                        const CompileOptions &options = {});
+};
+
+} // namespace boyo
@@ -0,0 +1,208 @@
+#include "embed/jit.hpp"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "parser/parser.hpp"
+#include "utils/sha256.hpp"
+#include "vm/bytecode.hpp"
+
+namespace boyo {
+
+/**
+ * A loaded shared object and the call symbols of its defs, by name and
+ * number of parameters. Unloaded when the last Module or Function using it
+ * is gone.
+ */
+class Library {
+public:
+  explicit Library(void *handle) : handle(handle) {}
+  ~Library() { dlclose(handle); }
+
+  Library(const Library &) = delete;
+  Library &operator=(const Library &) = delete;
+
+  void *handle;
+  std::map<std::pair<std::string, size_t>, void *> calls;
+};
+
+size_t Function::operator()(std::span<const std::span<const uint8_t>> inputs,
+                            std::span<uint8_t> out) const {
+  if (inputs.size() != params_) {
+    throw std::runtime_error("Expected " + std::to_string(params_) +
+                             " inputs, got " + std::to_string(inputs.size()));
+  }
+
+  // Defs rarely take more than a few parameters; their arrays stay on the
+  // stack then
+  constexpr size_t kInlineParams = 8;
+  const uint8_t *inline_data[kInlineParams];
+  size_t inline_lengths[kInlineParams];
+  std::vector<const uint8_t *> heap_data;
+  std::vector<size_t> heap_lengths;
+  const uint8_t **data = inline_data;
+  size_t *lengths = inline_lengths;
+  if (params_ > kInlineParams) {
+    heap_data.resize(params_);
+    heap_lengths.resize(params_);
+    data = heap_data.data();
+    lengths = heap_lengths.data();
+  }
+  for (size_t i = 0; i < params_; ++i) {
+    data[i] = inputs[i].data();
+    lengths[i] = inputs[i].size();
+  }
+  return call_(data, lengths, out.data(), out.size());
+}
+
+std::vector<uint8_t> Function::operator()(
+    std::initializer_list<std::span<const uint8_t>> inputs) const {
+  std::vector<uint8_t> result((*this)(inputs, {}));
+  (*this)(inputs, result);
+  return result;
+}
+
+Function Module::Get(const std::string &name) const {
+  auto it = library_->calls.lower_bound({name, 0});
+  if (it == library_->calls.end() || it->first.first != name) {
+    throw std::runtime_error("Unknown def: " + name);
+  }
+  auto next = std::next(it);
+  if (next != library_->calls.end() && next->first.first == name) {
+    throw std::runtime_error("Def " + name +
+                             " is overloaded; give its number of parameters");
+  }
+  return Function(library_, reinterpret_cast<Function::Call>(it->second),
+                  it->first.second);
+}
+
+Function Module::Get(const std::string &name, size_t params) const {
+  auto it = library_->calls.find({name, params});
+  if (it == library_->calls.end()) {
+    throw std::runtime_error("Unknown def: " + name + " with " +
+                             std::to_string(params) + " parameters");
+  }
+  return Function(library_, reinterpret_cast<Function::Call>(it->second),
+                  params);
+}
+
+// Build statements into a shared object and load it; the file is only
+// needed until dlopen has mapped it
+static std::shared_ptr<const Library> Load(const StatementList &statements,
+                                           const CompileOptions &options) {
+  std::string scratch_template =
+      (std::filesystem::temp_directory_path() / "boyo-embed-XXXXXX").string();
+  if (mkdtemp(scratch_template.data()) == nullptr) {
+    throw std::runtime_error("Failed to create directory for module");
+  }
+  std::filesystem::path scratch = scratch_template;
+  std::string path = (scratch / "module.so").string();
+  void *handle = nullptr;
+  try {
+    Compiler(options).compile_library(statements, path, "", true);
+    handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  } catch (...) {
+    std::filesystem::remove_all(scratch);
+    throw;
+  }
+  std::filesystem::remove_all(scratch);
+  if (!handle) {
+    throw std::runtime_error(std::string("Failed to load module: ") +
+                             dlerror());
+  }
+
+  auto library = std::make_shared<Library>(handle);
+  for (const auto &statement : statements) {
+    auto *def = dynamic_cast<const DefStatement *>(statement.get());
+    if (!def) {
+      continue;
+    }
+    size_t params = def->GetParams().size();
+    void *call = dlsym(
+        handle, Compiler::CallSymbol(def->GetFuncName(), params).c_str());
+    if (!call) {
+      throw std::runtime_error("Missing def in module: " + def->GetFuncName());
+    }
+    library->calls[{def->GetFuncName(), params}] = call;
+  }
+  return library;
+}
+
+Module Jit::Compile(std::string_view source, const CompileOptions &options) {
+  std::vector<std::string> lines;
+  std::istringstream source_lines{std::string(source)};
+  for (std::string line; std::getline(source_lines, line);) {
+    lines.push_back(line);
+  }
+  auto statements = Parser().Parse(lines);
+
+  // Names g++ would reject are reported here rather than as g++ errors
+  CompileBytecode(statements);
+
+  // Modules are shared while any is alive, keyed by everything that
+  // determines their code
+  std::string key = Sha256::Hash(source);
+  for (const auto &flag : Compiler::GetCompilerFlags(options)) {
+    key += " " + flag;
+  }
+  key += options.link_runtime ? " linked" : " embedded";
+
+  // A module is built by the first caller asking for it; others asking
+  // meanwhile wait for that build rather than start their own, and the lock
+  // is only held to look modules up
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<const Library>> loaded;
+  static std::map<std::string,
+                  std::shared_future<std::shared_ptr<const Library>>>
+      loading;
+  std::promise<std::shared_ptr<const Library>> promise;
+  std::shared_future<std::shared_ptr<const Library>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = loaded.find(key);
+    if (it != loaded.end()) {
+      if (auto library = it->second.lock()) {
+        return Module(std::move(library));
+      }
+    }
+    auto building = loading.find(key);
+    if (building != loading.end()) {
+      pending = building->second;
+    } else {
+      std::erase_if(loaded,
+                    [](const auto &entry) { return entry.second.expired(); });
+      loading[key] = promise.get_future().share();
+    }
+  }
+  if (pending.valid()) {
+    return Module(pending.get());
+  }
+
+  std::shared_ptr<const Library> library;
+  try {
+    library = Load(statements, options);
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      loading.erase(key);
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    loaded[key] = library;
+    loading.erase(key);
+  }
+  promise.set_value(library);
+  return Module(std::move(library));
+}
+
+} // namespace boyo
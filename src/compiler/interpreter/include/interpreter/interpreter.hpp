@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "statement/statement.hpp"
+
+namespace boyo {
+
+/**
+ * Runs a program straight from its statements, with no C++ generated and no
+ * g++ involved. Results match the compiled program's byte for byte:
+ * operators call the runtime's vector kernels and results are printed with
+ * print_vector.
+ */
+class Interpreter {
+public:
+  /**
+   * Resolve every name in the program and evaluate its lets
+   * @throws std::runtime_error for a program g++ would reject: an unknown
+   * or redefined name, a literal wider than a byte, or a call with the
+   * wrong number of arguments
+   */
+  explicit Interpreter(const StatementList &statements);
+  ~Interpreter();
+
+  Interpreter(Interpreter &&other) noexcept;
+  Interpreter &operator=(Interpreter &&other) noexcept;
+
+  /**
+   * Evaluate every main statement in order and print its result to os
+   * @param args NAME=SOURCE bindings of main arguments, as a compiled
+   * program takes them
+   * @throws std::runtime_error for an unknown argument or unreadable input
+   */
+  void Run(std::ostream &os, const std::vector<std::string> &args = {}) const;
+
+  /**
+   * Call a def
+   * @throws std::runtime_error if no def of that name takes args.size()
+   * arguments
+   */
+  std::vector<uint8_t> Call(const std::string &name,
+                            const std::vector<std::vector<uint8_t>> &args) const;
+
+private:
+  // Expression with its names resolved to global or parameter indices
+  struct Node;
+
+  struct Function {
+    std::unique_ptr<Node> body;
+  };
+
+  struct MainCall {
+    const Function *function;
+    std::vector<size_t> args; // Indices of globals
+  };
+
+  std::unique_ptr<Node> Resolve(const Expression &expr,
+                                const std::vector<std::string> &params,
+                                const std::string &context) const;
+
+  static std::vector<uint8_t>
+  Evaluate(const Node &node, const std::vector<std::vector<uint8_t>> &globals,
+           const std::vector<uint8_t> *const *args);
+
+  // Values of the lets, in definition order
+  std::vector<std::vector<uint8_t>> globals_;
+  std::map<std::string, size_t> global_indices_;
+
+  // Defs by name and parameter count, as C++ overloads them
+  std::map<std::pair<std::string, size_t>, Function> functions_;
+
+  std::vector<MainCall> mains_;
+};
+
+} // namespace boyo
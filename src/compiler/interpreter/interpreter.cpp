@@ -0,0 +1,249 @@
+#include "interpreter/interpreter.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+#include "runtime/boyo_runtime.hpp"
+#include "statement/expression.hpp"
+
+namespace boyo {
+
+struct Interpreter::Node {
+  enum class Kind { kConstant, kGlobal, kParam, kOperator };
+
+  Kind kind;
+  char op = 0;                // '+', '-' or '*' for operators
+  size_t index = 0;           // Global or parameter index
+  std::vector<uint8_t> value; // Constant value
+  std::unique_ptr<Node> left;
+  std::unique_ptr<Node> right;
+};
+
+Interpreter::Interpreter(const StatementList &statements) {
+  std::set<std::string> def_names;
+  for (const auto &statement : statements) {
+    if (auto *let_stmt = dynamic_cast<const LetStatement *>(statement.get())) {
+      const std::string &name = let_stmt->GetVarName();
+      if (IsReservedName(name)) {
+        throw std::runtime_error("Reserved name: " + name);
+      }
+      if (global_indices_.count(name) || def_names.count(name)) {
+        throw std::runtime_error("Redefinition of " + name);
+      }
+      const Expression &value = let_stmt->GetValueExpr();
+      if (auto *literal = dynamic_cast<const HexLiteralExpression *>(&value)) {
+        globals_.push_back({literal->GetByte()});
+      } else if (auto *identifier =
+                     dynamic_cast<const IdentifierExpression *>(&value)) {
+        auto it = global_indices_.find(identifier->GetName());
+        if (it == global_indices_.end()) {
+          throw std::runtime_error("Unknown identifier in let " + name + ": " +
+                                   identifier->GetName());
+        }
+        globals_.push_back(globals_[it->second]);
+      } else {
+        throw std::runtime_error("let " + name +
+                                 " must be a literal or another let");
+      }
+      global_indices_[name] = globals_.size() - 1;
+    } else if (auto *def_stmt =
+                   dynamic_cast<const DefStatement *>(statement.get())) {
+      const std::string &name = def_stmt->GetFuncName();
+      if (IsReservedName(name)) {
+        throw std::runtime_error("Reserved name: " + name);
+      }
+      const auto &params = def_stmt->GetParams();
+      if (global_indices_.count(name) ||
+          functions_.count({name, params.size()})) {
+        throw std::runtime_error("Redefinition of " + name);
+      }
+      std::set<std::string> distinct(params.begin(), params.end());
+      if (distinct.size() != params.size()) {
+        throw std::runtime_error("Repeated parameter in def " + name);
+      }
+      functions_[{name, params.size()}].body =
+          Resolve(def_stmt->GetBodyExpr(), params, "def " + name);
+      def_names.insert(name);
+    }
+  }
+
+  // main() runs after every let and def is defined
+  for (const auto &statement : statements) {
+    auto *main_stmt = dynamic_cast<const MainStatement *>(statement.get());
+    if (!main_stmt) {
+      continue;
+    }
+    MainCall call;
+    const auto &args = main_stmt->GetArgs();
+    auto function = functions_.find({main_stmt->GetFuncName(), args.size()});
+    if (function == functions_.end()) {
+      throw std::runtime_error("No def " + main_stmt->GetFuncName() +
+                               " taking " + std::to_string(args.size()) +
+                               " arguments");
+    }
+    call.function = &function->second;
+    for (const auto &arg : args) {
+      auto it = global_indices_.find(arg);
+      if (it == global_indices_.end()) {
+        throw std::runtime_error("Unknown identifier in main " +
+                                 main_stmt->GetFuncName() + ": " + arg);
+      }
+      call.args.push_back(it->second);
+    }
+    mains_.push_back(std::move(call));
+  }
+}
+
+Interpreter::~Interpreter() = default;
+Interpreter::Interpreter(Interpreter &&other) noexcept = default;
+Interpreter &Interpreter::operator=(Interpreter &&other) noexcept = default;
+
+std::unique_ptr<Interpreter::Node>
+Interpreter::Resolve(const Expression &expr,
+                     const std::vector<std::string> &params,
+                     const std::string &context) const {
+  auto node = std::make_unique<Node>();
+  if (auto *op = dynamic_cast<const OperatorExpression *>(&expr)) {
+    const std::string &symbol = op->GetOperator();
+    if (symbol != "+" && symbol != "-" && symbol != "*") {
+      throw std::runtime_error("Unknown operator: " + symbol);
+    }
+    node->kind = Node::Kind::kOperator;
+    node->op = symbol[0];
+    node->left = Resolve(op->GetLeft(), params, context);
+    node->right = Resolve(op->GetRight(), params, context);
+  } else if (auto *literal = dynamic_cast<const HexLiteralExpression *>(&expr)) {
+    node->kind = Node::Kind::kConstant;
+    node->value = {literal->GetByte()};
+  } else if (auto *param = dynamic_cast<const ParameterExpression *>(&expr)) {
+    auto it = std::find(params.begin(), params.end(), param->GetParamName());
+    if (it == params.end()) {
+      throw std::runtime_error("Unknown parameter in " + context + ": " +
+                               param->GetParamName());
+    }
+    node->kind = Node::Kind::kParam;
+    node->index = it - params.begin();
+  } else if (auto *identifier = dynamic_cast<const IdentifierExpression *>(&expr)) {
+    // Only lets defined above are visible, as in the generated C++
+    auto it = global_indices_.find(identifier->GetName());
+    if (it == global_indices_.end()) {
+      throw std::runtime_error("Unknown identifier in " + context + ": " +
+                               identifier->GetName());
+    }
+    node->kind = Node::Kind::kGlobal;
+    node->index = it->second;
+  } else {
+    throw std::runtime_error("Unexpected expression in " + context + ": " +
+                             expr.ToString());
+  }
+  return node;
+}
+
+// Apply a kernel, passing temporaries on so their buffers are reused
+template <typename A, typename B>
+static std::vector<uint8_t> Apply(char op, A &&a, B &&b) {
+  switch (op) {
+  case '+':
+    return add_vectors(std::forward<A>(a), std::forward<B>(b));
+  case '-':
+    return subtract_vectors(std::forward<A>(a), std::forward<B>(b));
+  default:
+    return multiply_vectors(std::forward<A>(a), std::forward<B>(b));
+  }
+}
+
+std::vector<uint8_t>
+Interpreter::Evaluate(const Node &node,
+                      const std::vector<std::vector<uint8_t>> &globals,
+                      const std::vector<uint8_t> *const *args) {
+  // Leaves are used in place; only operators produce new vectors
+  auto leaf = [&](const Node &leaf_node) -> const std::vector<uint8_t> & {
+    switch (leaf_node.kind) {
+    case Node::Kind::kGlobal:
+      return globals[leaf_node.index];
+    case Node::Kind::kParam:
+      return *args[leaf_node.index];
+    default:
+      return leaf_node.value;
+    }
+  };
+
+  if (node.kind != Node::Kind::kOperator) {
+    return leaf(node);
+  }
+  bool left_computed = node.left->kind == Node::Kind::kOperator;
+  bool right_computed = node.right->kind == Node::Kind::kOperator;
+  if (left_computed && right_computed) {
+    return Apply(node.op, Evaluate(*node.left, globals, args),
+                 Evaluate(*node.right, globals, args));
+  }
+  if (left_computed) {
+    return Apply(node.op, Evaluate(*node.left, globals, args),
+                 leaf(*node.right));
+  }
+  if (right_computed) {
+    return Apply(node.op, leaf(*node.left),
+                 Evaluate(*node.right, globals, args));
+  }
+  return Apply(node.op, leaf(*node.left), leaf(*node.right));
+}
+
+void Interpreter::Run(std::ostream &os,
+                      const std::vector<std::string> &args) const {
+  // Main arguments are bound exactly as boyo_check_arguments and boyo_bind
+  // bind them in a compiled program
+  std::set<std::string> bindable;
+  for (const auto &[name, index] : global_indices_) {
+    for (const auto &call : mains_) {
+      if (std::find(call.args.begin(), call.args.end(), index) !=
+          call.args.end()) {
+        bindable.insert(name);
+      }
+    }
+  }
+  std::vector<std::string> argv_storage = {"boyo"};
+  for (const auto &arg : args) {
+    size_t equals = arg.find('=');
+    if (equals == std::string::npos || !bindable.count(arg.substr(0, equals))) {
+      throw std::runtime_error("unknown argument: " + arg);
+    }
+    argv_storage.push_back(arg);
+  }
+  std::vector<char *> argv;
+  for (auto &arg : argv_storage) {
+    argv.push_back(arg.data());
+  }
+
+  std::vector<std::vector<uint8_t>> globals = globals_;
+  for (const auto &name : bindable) {
+    boyo_bind(static_cast<int>(argv.size()), argv.data(), name.c_str(),
+              globals[global_indices_.at(name)], false);
+  }
+
+  std::vector<const std::vector<uint8_t> *> call_args;
+  for (const auto &call : mains_) {
+    call_args.clear();
+    for (size_t index : call.args) {
+      call_args.push_back(&globals[index]);
+    }
+    print_vector(os, Evaluate(*call.function->body, globals, call_args.data()));
+  }
+}
+
+std::vector<uint8_t>
+Interpreter::Call(const std::string &name,
+                  const std::vector<std::vector<uint8_t>> &args) const {
+  auto function = functions_.find({name, args.size()});
+  if (function == functions_.end()) {
+    throw std::runtime_error("No def " + name + " taking " +
+                             std::to_string(args.size()) + " arguments");
+  }
+  std::vector<const std::vector<uint8_t> *> call_args;
+  for (const auto &arg : args) {
+    call_args.push_back(&arg);
+  }
+  return Evaluate(*function->second.body, globals_, call_args.data());
+}
+
+} // namespace boyo
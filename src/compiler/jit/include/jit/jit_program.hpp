@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vm/bytecode.hpp"
+#include "vm/vm.hpp"
+
+namespace boyo {
+
+class X86Assembler;
+
+struct JitOptions {
+  enum class Isa { kAuto, kSse2, kAvx2 };
+
+  // kAuto picks AVX2 when the CPU has it
+  Isa isa = Isa::kAuto;
+
+  // Describe the generated functions in /tmp/perf-<pid>.map for perf
+  bool perf_map = false;
+};
+
+/**
+ * Compiles the defs of verified bytecode straight to x86-64 machine code.
+ * Each def becomes one fused loop that loads a vector of every operand,
+ * evaluates the whole body in SSE2 or AVX2 registers and stores a vector of
+ * the result, so no intermediate vector is ever materialized. The code lives
+ * in anonymous pages that are writable while it is copied in and executable
+ * afterwards. A def whose body needs more registers than there are runs on
+ * the VM instead.
+ */
+class JitProgram {
+public:
+  /**
+   * @throws std::runtime_error if the bytecode is malformed, as Vm does, or
+   * the code pages cannot be mapped
+   */
+  explicit JitProgram(Bytecode bytecode, JitOptions options = {});
+  ~JitProgram();
+
+  JitProgram(const JitProgram &) = delete;
+  JitProgram &operator=(const JitProgram &) = delete;
+
+  // As Vm::Run
+  void Run(std::ostream &os, const std::vector<std::string> &args = {}) const;
+
+  // As Vm::FindFunction
+  size_t FindFunction(const std::string &name, size_t params) const;
+
+  // As Vm::Call; thread safe
+  std::vector<uint8_t> Call(size_t function,
+                            const std::vector<uint8_t> *const *args) const;
+
+  std::vector<uint8_t> Call(const std::string &name,
+                            const std::vector<std::vector<uint8_t>> &args) const;
+
+  // Whether function runs as machine code rather than on the VM
+  bool IsCompiled(size_t function) const;
+
+  // Bytes the generated loops process per iteration: 16 or 32
+  size_t VectorBytes() const { return avx2_ ? 32 : 16; }
+
+  static bool CpuHasAvx2();
+
+private:
+  // Computes out[i] for i in [0, n), n a multiple of VectorBytes(), from
+  // operand j at ptrs[j][i & masks[j]]. A mask of zero keeps an operand on
+  // one zero-padded block.
+  using Kernel = void (*)(const uint8_t *const *ptrs, const uint64_t *masks,
+                          uint8_t *out, size_t n);
+
+  // An operand of a def body
+  struct Leaf {
+    Opcode load; // kLoadParam, kLoadGlobal or kLoadConst
+    uint32_t index;
+  };
+
+  struct CompiledFunction {
+    Kernel kernel = nullptr;
+    std::vector<Leaf> leaves;
+  };
+
+  // Append the kernel of function to as and collect its operands; false,
+  // with nothing appended, if the body does not fit in registers
+  static bool Lower(const Bytecode &bytecode, const BytecodeFunction &function,
+                    X86Assembler &as, std::vector<Leaf> &leaves);
+
+  std::vector<uint8_t> Invoke(const CompiledFunction &function,
+                              const std::vector<uint8_t> *const *params,
+                              const std::vector<std::vector<uint8_t>> &globals) const;
+
+  Vm vm_;
+  bool avx2_;
+  std::vector<CompiledFunction> functions_;
+  // Whether main only loads, calls compiled defs and prints
+  bool main_compiled_ = false;
+
+  void *code_ = nullptr;
+  size_t code_size_ = 0;
+};
+
+} // namespace boyo
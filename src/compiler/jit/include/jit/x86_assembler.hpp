@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace boyo {
+
+// General purpose registers, numbered as in their encoding
+enum class Gpr : uint8_t {
+  kRax, kRcx, kRdx, kRbx, kRsp, kRbp, kRsi, kRdi,
+  kR8, kR9, kR10, kR11, kR12, kR13, kR14, kR15,
+};
+
+/**
+ * Encodes the few x86-64 instructions the JIT needs. Vector instructions
+ * work on xmm registers with SSE2 encodings, or on ymm registers with AVX2
+ * (VEX) encodings; the vector width is chosen at construction. Vector
+ * registers are numbered 0-15.
+ */
+class X86Assembler {
+public:
+  explicit X86Assembler(bool avx2) : avx2_(avx2) {}
+
+  // Bytes per vector register: 16 for SSE2, 32 for AVX2
+  size_t VectorBytes() const { return avx2_ ? 32 : 16; }
+
+  const std::vector<uint8_t> &Code() const { return code_; }
+  size_t Here() const { return code_.size(); }
+
+  // dst = [base + disp]
+  void MovLoad(Gpr dst, Gpr base, int32_t disp);
+  // dst = src
+  void Mov(Gpr dst, Gpr src);
+  // dst &= [base + disp]
+  void AndLoad(Gpr dst, Gpr base, int32_t disp);
+  // reg = 0
+  void Zero(Gpr reg);
+  // dst = imm (32-bit register, zero-extended)
+  void MovImm32(Gpr dst, uint32_t imm);
+  void AddImm8(Gpr reg, int8_t imm);
+  void Test(Gpr a, Gpr b);
+  void Cmp(Gpr a, Gpr b);
+
+  // Jump if zero / unsigned below; returns the position to Patch
+  size_t JumpIfZero();
+  void JumpIfBelow(size_t target);
+  // Point the jump at position to target
+  void Patch(size_t position, size_t target);
+  void Ret();
+
+  // Clear the upper halves of ymm registers before returning to SSE code
+  void Vzeroupper();
+
+  // Vector loads and stores at base + index, unaligned
+  void VectorLoad(int dst, Gpr base, Gpr index);
+  void VectorStore(Gpr base, Gpr index, int src);
+  void VectorMove(int dst, int src);
+
+  // dst = a op b, bytewise. The SSE2 forms overwrite a when dst is b and
+  // the operation does not commute.
+  void AddBytes(int dst, int a, int b);
+  void SubtractBytes(int dst, int a, int b);
+  // dst = a op b on 16-bit words and whole registers
+  void MultiplyWords(int dst, int a, int b);
+  void And(int dst, int a, int b);
+  void Or(int dst, int a, int b);
+  // dst = src shifted by bits, on 16-bit words
+  void ShiftRightWords(int dst, int src, uint8_t bits);
+  void ShiftLeftWords(int dst, int src, uint8_t bits);
+
+  // Every 32-bit lane of dst = src's low 32 bits
+  void BroadcastDword(int dst, Gpr src);
+
+private:
+  // An r/m operand: a register, [base + disp32] or [base + index]
+  struct Rm {
+    bool memory = false;
+    uint8_t reg = 0;
+    Gpr base = Gpr::kRax;
+    bool has_index = false;
+    Gpr index = Gpr::kRax;
+    int32_t disp = 0;
+  };
+  static Rm Reg(int reg);
+  static Rm Mem(Gpr base, int32_t disp);
+  static Rm Mem(Gpr base, Gpr index);
+
+  void Byte(uint8_t byte) { code_.push_back(byte); }
+  void Dword(uint32_t value);
+  void ModRm(uint8_t reg, const Rm &rm);
+
+  // Legacy encoding: [prefix] [REX] opcode... modrm
+  void Legacy(uint8_t prefix, bool rex_w, std::vector<uint8_t> opcode,
+              uint8_t reg, const Rm &rm);
+  // Three-byte VEX encoding; pp: 1 = 66, 2 = F3; map: 1 = 0F, 2 = 0F38
+  void Vex(uint8_t pp, uint8_t map, bool l, uint8_t vvvv, uint8_t opcode,
+           uint8_t reg, const Rm &rm);
+
+  // Two- or three-operand form of a bytewise SSE2/AVX2 operation
+  void VectorOp(uint8_t opcode, bool commutative, int dst, int a, int b);
+  void VectorShift(uint8_t ext, int dst, int src, uint8_t bits);
+
+  bool avx2_;
+  std::vector<uint8_t> code_;
+};
+
+} // namespace boyo
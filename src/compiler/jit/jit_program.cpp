@@ -0,0 +1,400 @@
+#include "jit/jit_program.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+#include "jit/x86_assembler.hpp"
+#include "runtime/boyo_runtime.hpp"
+
+namespace boyo {
+
+namespace {
+
+// Vector registers: values take 0-12, a byte multiply uses 13 and 14 as
+// scratch, and 15 holds the low byte mask of every 16-bit word
+constexpr int kValueRegisters = 13;
+constexpr int kProductRegister = 13;
+constexpr int kHighRegister = 14;
+constexpr int kByteMaskRegister = 15;
+
+// Bodies are trees once shared values are expanded; larger ones stay on
+// the VM rather than growing the code without bound
+constexpr size_t kMaxNodes = 4096;
+
+const uint8_t kZeros[32] = {};
+
+// A value of a def body: an operand (leaf) or an operation on two values
+struct Node {
+  Opcode op;
+  uint32_t left = 0;
+  uint32_t right = 0;
+  uint32_t leaf = 0;
+};
+
+bool IsLoad(Opcode op) {
+  return op == Opcode::kLoadParam || op == Opcode::kLoadGlobal ||
+         op == Opcode::kLoadConst;
+}
+
+// Bytewise multiply from 16-bit multiplies: the low bytes of a * b, and
+// the high bytes of (a >> 8) * (b >> 8) shifted back. Overwrites b.
+void EmitMultiply(X86Assembler &as, int dst, int a, int b) {
+  as.MultiplyWords(kProductRegister, a, b);
+  as.And(kProductRegister, kProductRegister, kByteMaskRegister);
+  as.ShiftRightWords(kHighRegister, a, 8);
+  as.ShiftRightWords(b, b, 8);
+  as.MultiplyWords(kHighRegister, kHighRegister, b);
+  as.ShiftLeftWords(kHighRegister, kHighRegister, 8);
+  as.Or(dst, kProductRegister, kHighRegister);
+}
+
+// Evaluate node into register base, using registers base and up. The
+// operand needing more registers goes first (Sethi-Ullman order).
+void EmitNode(X86Assembler &as, const std::vector<Node> &nodes,
+              const std::vector<int> &need, uint32_t index, int base) {
+  const Node &node = nodes[index];
+  if (IsLoad(node.op)) {
+    int32_t slot = static_cast<int32_t>(node.leaf * sizeof(uint64_t));
+    as.MovLoad(Gpr::kR9, Gpr::kRdi, slot);
+    as.Mov(Gpr::kR10, Gpr::kRax);
+    as.AndLoad(Gpr::kR10, Gpr::kRsi, slot);
+    as.VectorLoad(base, Gpr::kR9, Gpr::kR10);
+    return;
+  }
+  int a = base;
+  int b = base + 1;
+  if (need[node.left] >= need[node.right]) {
+    EmitNode(as, nodes, need, node.left, a);
+    EmitNode(as, nodes, need, node.right, b);
+  } else {
+    std::swap(a, b);
+    EmitNode(as, nodes, need, node.right, b);
+    EmitNode(as, nodes, need, node.left, a);
+  }
+  switch (node.op) {
+  case Opcode::kAdd:
+    as.AddBytes(base, a, b);
+    break;
+  case Opcode::kSubtract:
+    as.SubtractBytes(base, a, b);
+    break;
+  default:
+    EmitMultiply(as, base, a, b);
+    break;
+  }
+}
+
+void WritePerfMap(const std::string &name, const void *start, size_t size) {
+  std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+  FILE *file = std::fopen(path.c_str(), "a");
+  if (!file) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  std::fprintf(file, "%lx %zx %s\n", reinterpret_cast<unsigned long>(start),
+               size, name.c_str());
+  std::fclose(file);
+}
+
+} // namespace
+
+bool JitProgram::Lower(const Bytecode &bytecode,
+                       const BytecodeFunction &function, X86Assembler &as,
+                       std::vector<Leaf> &leaves) {
+#if !defined(__x86_64__)
+  return false;
+#endif
+  // Rebuild the body as nodes; the VM has verified the code, so every
+  // register is written before it is read
+  std::vector<Node> nodes;
+  std::vector<uint32_t> register_nodes(function.registers);
+  std::map<std::pair<Opcode, uint32_t>, uint32_t> leaf_slots;
+  uint32_t root = 0;
+  for (uint32_t i = function.entry; i < function.entry + function.size; ++i) {
+    const Instruction &instruction = bytecode.code[i];
+    Node node{instruction.op};
+    switch (instruction.op) {
+    case Opcode::kLoadParam:
+    case Opcode::kLoadGlobal:
+    case Opcode::kLoadConst: {
+      auto slot = leaf_slots.emplace(std::make_pair(instruction.op, instruction.b),
+                                     leaf_slots.size());
+      node.leaf = slot.first->second;
+      break;
+    }
+    case Opcode::kAdd:
+    case Opcode::kSubtract:
+    case Opcode::kMultiply:
+      node.left = register_nodes[instruction.b];
+      node.right = register_nodes[instruction.c];
+      break;
+    case Opcode::kReturn:
+      root = register_nodes[instruction.a];
+      continue;
+    default:
+      return false;
+    }
+    register_nodes[instruction.a] = nodes.size();
+    nodes.push_back(node);
+  }
+
+  std::vector<int> need(nodes.size());
+  std::vector<size_t> tree_size(nodes.size());
+  bool multiplies = false;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (IsLoad(nodes[i].op)) {
+      need[i] = 1;
+      tree_size[i] = 1;
+      continue;
+    }
+    int left = need[nodes[i].left];
+    int right = need[nodes[i].right];
+    need[i] = left == right ? left + 1 : std::max(left, right);
+    tree_size[i] = std::min(
+        kMaxNodes + 1, 1 + tree_size[nodes[i].left] + tree_size[nodes[i].right]);
+    multiplies = multiplies || nodes[i].op == Opcode::kMultiply;
+  }
+  if (need[root] > kValueRegisters || tree_size[root] > kMaxNodes) {
+    return false;
+  }
+
+  leaves.resize(leaf_slots.size());
+  for (const auto &[leaf, slot] : leaf_slots) {
+    leaves[slot] = {leaf.first, leaf.second};
+  }
+
+  // for (rax = 0; rax < n; rax += W) out[rax] = body(operands at rax)
+  as.Zero(Gpr::kRax);
+  as.Test(Gpr::kRcx, Gpr::kRcx);
+  size_t skip = as.JumpIfZero();
+  if (multiplies) {
+    as.MovImm32(Gpr::kR8, 0x00FF00FF);
+    as.BroadcastDword(kByteMaskRegister, Gpr::kR8);
+  }
+  size_t loop = as.Here();
+  EmitNode(as, nodes, need, root, 0);
+  as.VectorStore(Gpr::kRdx, Gpr::kRax, 0);
+  as.AddImm8(Gpr::kRax, static_cast<int8_t>(as.VectorBytes()));
+  as.Cmp(Gpr::kRax, Gpr::kRcx);
+  as.JumpIfBelow(loop);
+  as.Patch(skip, as.Here());
+  if (as.VectorBytes() == 32) {
+    as.Vzeroupper();
+  }
+  as.Ret();
+  return true;
+}
+
+JitProgram::JitProgram(Bytecode bytecode, JitOptions options)
+    : vm_(std::move(bytecode)),
+      avx2_(options.isa == JitOptions::Isa::kAvx2 ||
+            (options.isa == JitOptions::Isa::kAuto && CpuHasAvx2())) {
+  if (avx2_ && !CpuHasAvx2()) {
+    throw std::runtime_error("This CPU does not support AVX2");
+  }
+  const Bytecode &code = vm_.GetBytecode();
+  X86Assembler as(avx2_);
+  std::vector<size_t> entries(code.functions.size());
+  functions_.resize(code.functions.size());
+  main_compiled_ = true;
+  for (size_t i = 0; i < code.functions.size(); ++i) {
+    entries[i] = as.Here();
+    if (!Lower(code, code.functions[i], as, functions_[i].leaves)) {
+      main_compiled_ = false;
+    }
+  }
+  for (uint32_t i = code.main.entry; i < code.main.entry + code.main.size;
+       ++i) {
+    Opcode op = code.code[i].op;
+    main_compiled_ = main_compiled_ &&
+                     (op == Opcode::kLoadGlobal || op == Opcode::kLoadConst ||
+                      op == Opcode::kCall || op == Opcode::kPrint ||
+                      op == Opcode::kHalt);
+  }
+  if (as.Code().empty()) {
+    return;
+  }
+
+  // Copy the code into writable pages, then make them executable and no
+  // longer writable
+  size_t page = sysconf(_SC_PAGESIZE);
+  code_size_ = (as.Code().size() + page - 1) / page * page;
+  void *pages = mmap(nullptr, code_size_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    throw std::runtime_error("Failed to map JIT code pages");
+  }
+  code_ = pages;
+  std::memcpy(code_, as.Code().data(), as.Code().size());
+  if (mprotect(code_, code_size_, PROT_READ | PROT_EXEC) != 0) {
+    munmap(code_, code_size_);
+    throw std::runtime_error("Failed to make JIT code executable");
+  }
+
+  auto *start = static_cast<uint8_t *>(code_);
+  for (size_t i = 0; i < functions_.size(); ++i) {
+    size_t end = i + 1 < entries.size() ? entries[i + 1] : as.Here();
+    if (end == entries[i]) {
+      continue; // declined: runs on the VM
+    }
+    functions_[i].kernel = reinterpret_cast<Kernel>(start + entries[i]);
+    if (options.perf_map) {
+      const BytecodeFunction &function = code.functions[i];
+      WritePerfMap("boyo::" + function.name + "/" +
+                       std::to_string(function.params),
+                   start + entries[i], end - entries[i]);
+    }
+  }
+}
+
+JitProgram::~JitProgram() {
+  if (code_) {
+    munmap(code_, code_size_);
+  }
+}
+
+bool JitProgram::CpuHasAvx2() {
+#if defined(__x86_64__)
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+std::vector<uint8_t>
+JitProgram::Invoke(const CompiledFunction &function,
+                   const std::vector<uint8_t> *const *params,
+                   const std::vector<std::vector<uint8_t>> &globals) const {
+  const Bytecode &code = vm_.GetBytecode();
+  size_t count = function.leaves.size();
+  std::vector<const std::vector<uint8_t> *> values(count);
+  size_t size = 0;
+  for (size_t j = 0; j < count; ++j) {
+    const Leaf &leaf = function.leaves[j];
+    values[j] = leaf.load == Opcode::kLoadParam    ? params[leaf.index]
+                : leaf.load == Opcode::kLoadGlobal ? &globals[leaf.index]
+                                                   : &code.constants[leaf.index];
+    size = std::max(size, values[j]->size());
+  }
+
+  // The kernel covers runs of whole blocks where every operand either has
+  // the block or has ended (and reads zeros). A block where an operand
+  // ends runs on zero-padded copies.
+  size_t width = VectorBytes();
+  std::vector<uint8_t> result(size);
+  std::vector<const uint8_t *> ptrs(count);
+  std::vector<uint64_t> masks(count);
+  std::vector<uint8_t> padded;
+  std::vector<uint8_t> block;
+  size_t pos = 0;
+  while (pos < size) {
+    size_t end = size;
+    bool partial = false;
+    for (size_t j = 0; j < count; ++j) {
+      size_t length = values[j]->size();
+      if (length > pos && length < pos + width) {
+        partial = true;
+      } else if (length > pos) {
+        end = std::min(end, length);
+      }
+    }
+
+    if (partial) {
+      padded.assign(count * width, 0);
+      block.resize(width);
+      for (size_t j = 0; j < count; ++j) {
+        size_t length = values[j]->size();
+        if (length > pos) {
+          std::memcpy(&padded[j * width], values[j]->data() + pos,
+                      std::min(width, length - pos));
+        }
+        ptrs[j] = &padded[j * width];
+        masks[j] = ~uint64_t{0};
+      }
+      function.kernel(ptrs.data(), masks.data(), block.data(), width);
+      std::memcpy(result.data() + pos, block.data(),
+                  std::min(width, size - pos));
+      pos += width;
+      continue;
+    }
+
+    end = pos + (end - pos) / width * width;
+    for (size_t j = 0; j < count; ++j) {
+      bool present = values[j]->size() >= end;
+      ptrs[j] = present ? values[j]->data() + pos : kZeros;
+      masks[j] = present ? ~uint64_t{0} : 0;
+    }
+    function.kernel(ptrs.data(), masks.data(), result.data() + pos, end - pos);
+    pos = end;
+  }
+  return result;
+}
+
+void JitProgram::Run(std::ostream &os,
+                     const std::vector<std::string> &args) const {
+  if (!main_compiled_) {
+    vm_.Run(os, args);
+    return;
+  }
+  const Bytecode &code = vm_.GetBytecode();
+  std::vector<std::vector<uint8_t>> globals = vm_.BindGlobals(args);
+  const BytecodeFunction &main = code.main;
+  std::vector<const std::vector<uint8_t> *> registers(main.registers);
+  std::vector<std::vector<uint8_t>> results(main.registers);
+  for (uint32_t i = main.entry; i < main.entry + main.size; ++i) {
+    const Instruction &instruction = code.code[i];
+    switch (instruction.op) {
+    case Opcode::kLoadGlobal:
+      registers[instruction.a] = &globals[instruction.b];
+      break;
+    case Opcode::kLoadConst:
+      registers[instruction.a] = &code.constants[instruction.b];
+      break;
+    case Opcode::kCall:
+      results[instruction.a] = Invoke(functions_[instruction.b],
+                                      &registers[instruction.c], globals);
+      registers[instruction.a] = &results[instruction.a];
+      break;
+    case Opcode::kPrint:
+      print_vector(os, *registers[instruction.a]);
+      break;
+    default:
+      return;
+    }
+  }
+}
+
+size_t JitProgram::FindFunction(const std::string &name, size_t params) const {
+  return vm_.FindFunction(name, params);
+}
+
+bool JitProgram::IsCompiled(size_t function) const {
+  return functions_.at(function).kernel != nullptr;
+}
+
+std::vector<uint8_t>
+JitProgram::Call(size_t function,
+                 const std::vector<uint8_t> *const *args) const {
+  if (!IsCompiled(function)) {
+    return vm_.Call(function, args);
+  }
+  return Invoke(functions_[function], args, vm_.GetBytecode().globals);
+}
+
+std::vector<uint8_t>
+JitProgram::Call(const std::string &name,
+                 const std::vector<std::vector<uint8_t>> &args) const {
+  size_t function = FindFunction(name, args.size());
+  std::vector<const std::vector<uint8_t> *> pointers;
+  for (const auto &arg : args) {
+    pointers.push_back(&arg);
+  }
+  return Call(function, pointers.data());
+}
+
+} // namespace boyo
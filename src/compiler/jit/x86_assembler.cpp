@@ -0,0 +1,269 @@
+#include "jit/x86_assembler.hpp"
+
+#include <stdexcept>
+
+namespace boyo {
+
+namespace {
+
+uint8_t Low3(uint8_t reg) { return reg & 7; }
+uint8_t High(uint8_t reg) { return (reg >> 3) & 1; }
+uint8_t Number(Gpr reg) { return static_cast<uint8_t>(reg); }
+
+// Legacy prefixes and VEX pp values of the vector instructions
+constexpr uint8_t kPrefix66 = 0x66;
+constexpr uint8_t kPrefixF3 = 0xF3;
+constexpr uint8_t kPp66 = 1;
+constexpr uint8_t kPpF3 = 2;
+constexpr uint8_t kMap0F = 1;
+constexpr uint8_t kMap0F38 = 2;
+
+} // namespace
+
+X86Assembler::Rm X86Assembler::Reg(int reg) {
+  Rm rm;
+  rm.reg = static_cast<uint8_t>(reg);
+  return rm;
+}
+
+X86Assembler::Rm X86Assembler::Mem(Gpr base, int32_t disp) {
+  Rm rm;
+  rm.memory = true;
+  rm.base = base;
+  rm.disp = disp;
+  return rm;
+}
+
+X86Assembler::Rm X86Assembler::Mem(Gpr base, Gpr index) {
+  if (index == Gpr::kRsp) {
+    throw std::logic_error("rsp cannot be an index register");
+  }
+  Rm rm;
+  rm.memory = true;
+  rm.base = base;
+  rm.has_index = true;
+  rm.index = index;
+  return rm;
+}
+
+void X86Assembler::Dword(uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    Byte(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void X86Assembler::ModRm(uint8_t reg, const Rm &rm) {
+  if (!rm.memory) {
+    Byte(0xC0 | Low3(reg) << 3 | Low3(rm.reg));
+    return;
+  }
+  uint8_t base = Number(rm.base);
+  if (rm.has_index) {
+    // [base + index]: rbp and r13 as a base need an explicit zero disp8
+    bool disp8 = Low3(base) == 5;
+    Byte((disp8 ? 0x44 : 0x04) | Low3(reg) << 3);
+    Byte(Low3(Number(rm.index)) << 3 | Low3(base));
+    if (disp8) {
+      Byte(0);
+    }
+    return;
+  }
+  // [base + disp32]: rsp and r12 as a base need a SIB byte
+  Byte(0x80 | Low3(reg) << 3 | Low3(base));
+  if (Low3(base) == 4) {
+    Byte(0x24);
+  }
+  Dword(static_cast<uint32_t>(rm.disp));
+}
+
+void X86Assembler::Legacy(uint8_t prefix, bool rex_w,
+                          std::vector<uint8_t> opcode, uint8_t reg,
+                          const Rm &rm) {
+  if (prefix) {
+    Byte(prefix);
+  }
+  uint8_t b = rm.memory ? High(Number(rm.base)) : High(rm.reg);
+  uint8_t x = rm.memory && rm.has_index ? High(Number(rm.index)) : 0;
+  uint8_t rex = (rex_w ? 8 : 0) | High(reg) << 2 | x << 1 | b;
+  if (rex) {
+    Byte(0x40 | rex);
+  }
+  for (uint8_t byte : opcode) {
+    Byte(byte);
+  }
+  ModRm(reg, rm);
+}
+
+void X86Assembler::Vex(uint8_t pp, uint8_t map, bool l, uint8_t vvvv,
+                       uint8_t opcode, uint8_t reg, const Rm &rm) {
+  uint8_t b = rm.memory ? High(Number(rm.base)) : High(rm.reg);
+  uint8_t x = rm.memory && rm.has_index ? High(Number(rm.index)) : 0;
+  Byte(0xC4);
+  Byte((!High(reg)) << 7 | (!x) << 6 | (!b) << 5 | map);
+  Byte((~vvvv & 15) << 3 | (l ? 4 : 0) | pp);
+  Byte(opcode);
+  ModRm(reg, rm);
+}
+
+void X86Assembler::MovLoad(Gpr dst, Gpr base, int32_t disp) {
+  Legacy(0, true, {0x8B}, Number(dst), Mem(base, disp));
+}
+
+void X86Assembler::Mov(Gpr dst, Gpr src) {
+  Legacy(0, true, {0x8B}, Number(dst), Reg(Number(src)));
+}
+
+void X86Assembler::AndLoad(Gpr dst, Gpr base, int32_t disp) {
+  Legacy(0, true, {0x23}, Number(dst), Mem(base, disp));
+}
+
+void X86Assembler::Zero(Gpr reg) {
+  Legacy(0, false, {0x33}, Number(reg), Reg(Number(reg)));
+}
+
+void X86Assembler::MovImm32(Gpr dst, uint32_t imm) {
+  if (High(Number(dst))) {
+    Byte(0x41);
+  }
+  Byte(0xB8 + Low3(Number(dst)));
+  Dword(imm);
+}
+
+void X86Assembler::AddImm8(Gpr reg, int8_t imm) {
+  Legacy(0, true, {0x83}, 0, Reg(Number(reg)));
+  Byte(static_cast<uint8_t>(imm));
+}
+
+void X86Assembler::Test(Gpr a, Gpr b) {
+  Legacy(0, true, {0x85}, Number(b), Reg(Number(a)));
+}
+
+void X86Assembler::Cmp(Gpr a, Gpr b) {
+  Legacy(0, true, {0x3B}, Number(a), Reg(Number(b)));
+}
+
+size_t X86Assembler::JumpIfZero() {
+  Byte(0x0F);
+  Byte(0x84);
+  size_t position = Here();
+  Dword(0);
+  return position;
+}
+
+void X86Assembler::JumpIfBelow(size_t target) {
+  Byte(0x0F);
+  Byte(0x82);
+  Dword(static_cast<uint32_t>(target - (Here() + 4)));
+}
+
+void X86Assembler::Patch(size_t position, size_t target) {
+  uint32_t rel = static_cast<uint32_t>(target - (position + 4));
+  for (int i = 0; i < 4; ++i) {
+    code_[position + i] = static_cast<uint8_t>(rel >> (8 * i));
+  }
+}
+
+void X86Assembler::Ret() { Byte(0xC3); }
+
+void X86Assembler::Vzeroupper() {
+  Byte(0xC5);
+  Byte(0xF8);
+  Byte(0x77);
+}
+
+void X86Assembler::VectorLoad(int dst, Gpr base, Gpr index) {
+  if (avx2_) {
+    Vex(kPpF3, kMap0F, true, 0, 0x6F, dst, Mem(base, index));
+  } else {
+    Legacy(kPrefixF3, false, {0x0F, 0x6F}, dst, Mem(base, index));
+  }
+}
+
+void X86Assembler::VectorStore(Gpr base, Gpr index, int src) {
+  if (avx2_) {
+    Vex(kPpF3, kMap0F, true, 0, 0x7F, src, Mem(base, index));
+  } else {
+    Legacy(kPrefixF3, false, {0x0F, 0x7F}, src, Mem(base, index));
+  }
+}
+
+void X86Assembler::VectorMove(int dst, int src) {
+  if (dst == src) {
+    return;
+  }
+  if (avx2_) {
+    Vex(kPp66, kMap0F, true, 0, 0x6F, dst, Reg(src));
+  } else {
+    Legacy(kPrefix66, false, {0x0F, 0x6F}, dst, Reg(src));
+  }
+}
+
+void X86Assembler::VectorOp(uint8_t opcode, bool commutative, int dst, int a,
+                            int b) {
+  if (avx2_) {
+    Vex(kPp66, kMap0F, true, a, opcode, dst, Reg(b));
+    return;
+  }
+  if (dst == a) {
+    Legacy(kPrefix66, false, {0x0F, opcode}, dst, Reg(b));
+  } else if (dst == b && commutative) {
+    Legacy(kPrefix66, false, {0x0F, opcode}, dst, Reg(a));
+  } else if (dst == b) {
+    Legacy(kPrefix66, false, {0x0F, opcode}, a, Reg(b));
+    VectorMove(dst, a);
+  } else {
+    VectorMove(dst, a);
+    Legacy(kPrefix66, false, {0x0F, opcode}, dst, Reg(b));
+  }
+}
+
+void X86Assembler::AddBytes(int dst, int a, int b) {
+  VectorOp(0xFC, true, dst, a, b);
+}
+
+void X86Assembler::SubtractBytes(int dst, int a, int b) {
+  VectorOp(0xF8, false, dst, a, b);
+}
+
+void X86Assembler::MultiplyWords(int dst, int a, int b) {
+  VectorOp(0xD5, true, dst, a, b);
+}
+
+void X86Assembler::And(int dst, int a, int b) {
+  VectorOp(0xDB, true, dst, a, b);
+}
+
+void X86Assembler::Or(int dst, int a, int b) {
+  VectorOp(0xEB, true, dst, a, b);
+}
+
+void X86Assembler::VectorShift(uint8_t ext, int dst, int src, uint8_t bits) {
+  if (avx2_) {
+    Vex(kPp66, kMap0F, true, dst, 0x71, ext, Reg(src));
+  } else {
+    VectorMove(dst, src);
+    Legacy(kPrefix66, false, {0x0F, 0x71}, ext, Reg(dst));
+  }
+  Byte(bits);
+}
+
+void X86Assembler::ShiftRightWords(int dst, int src, uint8_t bits) {
+  VectorShift(2, dst, src, bits);
+}
+
+void X86Assembler::ShiftLeftWords(int dst, int src, uint8_t bits) {
+  VectorShift(6, dst, src, bits);
+}
+
+void X86Assembler::BroadcastDword(int dst, Gpr src) {
+  if (avx2_) {
+    Vex(kPp66, kMap0F, false, 0, 0x6E, dst, Reg(Number(src)));
+    Vex(kPp66, kMap0F38, true, 0, 0x58, dst, Reg(dst));
+  } else {
+    Legacy(kPrefix66, false, {0x0F, 0x6E}, dst, Reg(Number(src)));
+    Legacy(kPrefix66, false, {0x0F, 0x70}, dst, Reg(dst));
+    Byte(0);
+  }
+}
+
+} // namespace boyo
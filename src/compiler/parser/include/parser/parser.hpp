@@ -20,6 +20,15 @@ class Parser {
    * @throws std::runtime_error if the line is invalid
    */
   StatementList Parse(const std::vector<std::string>& lines) const;
+
+  /**
+   * Parse one line. Lines are independent statements, so a changed line can
+   * be reparsed on its own.
+   * @param line The line to parse
+   * @return The statement, or nullptr if the line holds none
+   * @throws std::runtime_error if the line is invalid
+   */
+  std::unique_ptr<Statement> ParseLine(const std::string& line) const;
 };
 
 }  // namespace boyo
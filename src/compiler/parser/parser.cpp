@@ -123,7 +123,11 @@ std::unique_ptr<Statement> ParseMainStatement(const Lexer::TokenList &tokens,
 }
 
 // Parse a single line into a statement
-std::unique_ptr<Statement> ParseLine(const std::string &line) {
+std::unique_ptr<Statement> Parser::ParseLine(const std::string &line) const {
+  if (line.empty()) {
+    return nullptr;
+  }
+
   Lexer lexer;
   auto tokens = lexer.Tokenize({line});
 
@@ -163,10 +167,6 @@ StatementList Parser::Parse(const std::vector<std::string> &lines) const {
   StatementList statements;
 
   for (const auto &line : lines) {
-    if (line.empty()) {
-      continue;
-    }
-
     auto statement = ParseLine(line);
     if (statement) {
       statements.push_back(std::move(statement));
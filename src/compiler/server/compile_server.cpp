@@ -0,0 +1,221 @@
+#include "server/compile_server.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace boyo {
+
+namespace {
+
+// Seconds a connected client may take to send its request
+constexpr int kRequestTimeoutSeconds = 30;
+
+sockaddr_un SocketAddress(const std::string &path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path);
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+// Connect to the server socket at path; -1 with errno set on failure
+int Connect(const std::string &path) {
+  sockaddr_un address = SocketAddress(path);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+      0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+} // namespace
+
+CompileServer::CompileServer(std::string socket_path, size_t workers)
+    : socket_path_(std::move(socket_path)),
+      workers_(workers ? workers
+                       : std::max(1u, std::thread::hardware_concurrency())) {
+  sockaddr_un address = SocketAddress(socket_path_);
+
+  // A socket nobody accepts on was left by a server that died
+  int existing = Connect(socket_path_);
+  if (existing >= 0) {
+    close(existing);
+    throw std::runtime_error("A compile server is already listening on " +
+                             socket_path_);
+  }
+  if (errno == ECONNREFUSED) {
+    unlink(socket_path_.c_str());
+  }
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0 ||
+      bind(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0 ||
+      pipe2(stop_pipe_, O_CLOEXEC | O_NONBLOCK) != 0) {
+    int error = errno;
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+    }
+    throw std::runtime_error("Cannot listen on " + socket_path_ + ": " +
+                             std::strerror(error));
+  }
+}
+
+CompileServer::~CompileServer() {
+  close(listen_fd_);
+  close(stop_pipe_[0]);
+  close(stop_pipe_[1]);
+  unlink(socket_path_.c_str());
+}
+
+std::string CompileServer::DefaultSocketPath() {
+  if (const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+      runtime_dir && *runtime_dir) {
+    return std::string(runtime_dir) + "/boyo.sock";
+  }
+  return "/tmp/boyo-" + std::to_string(getuid()) + ".sock";
+}
+
+void CompileServer::Stop() {
+  // Only async-signal-safe calls here
+  char byte = 0;
+  [[maybe_unused]] ssize_t written = write(stop_pipe_[1], &byte, 1);
+}
+
+void CompileServer::Run() {
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < workers_; ++i) {
+    workers.emplace_back([this]() {
+      for (;;) {
+        int connection;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          ready_.wait(lock,
+                      [this]() { return stopping_ || !connections_.empty(); });
+          if (connections_.empty()) {
+            return;
+          }
+          connection = connections_.front();
+          connections_.pop_front();
+        }
+        Serve(connection);
+        close(connection);
+      }
+    });
+  }
+
+  struct pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents) {
+      break;
+    }
+    int connection = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0) {
+      continue; // The client gave up before we accepted it
+    }
+    struct timeval timeout = {kRequestTimeoutSeconds, 0};
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      connections_.push_back(connection);
+    }
+    ready_.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  char byte;
+  while (read(stop_pipe_[0], &byte, 1) > 0) {
+  }
+}
+
+void CompileServer::Serve(int connection) {
+  try {
+    std::string message;
+    if (!ReadMessage(connection, message)) {
+      return;
+    }
+    CompileResponse response;
+    try {
+      response = Handle(DecodeRequest(message));
+    } catch (const std::exception &e) {
+      response.error = e.what();
+    }
+    WriteMessage(connection, EncodeResponse(response));
+  } catch (const std::exception &) {
+    // The client went away; nothing to answer
+  }
+}
+
+CompileResponse CompileServer::Handle(const CompileRequest &request) {
+  CompileResponse response;
+  try {
+    Compiler(request.options).compile(request.lines, request.output_file);
+    response.success = true;
+    response.output_file = request.output_file;
+  } catch (const CompileError &e) {
+    response.error = e.what();
+    response.diagnostics = e.GetDiagnostics();
+  } catch (const std::exception &e) {
+    response.error = e.what();
+  }
+  return response;
+}
+
+CompileClient::CompileClient(std::string socket_path)
+    : socket_path_(std::move(socket_path)) {}
+
+CompileResponse CompileClient::Compile(const CompileRequest &request) const {
+  int fd = Connect(socket_path_);
+  if (fd < 0) {
+    throw NoServerError("No compile server at " + socket_path_ + ": " +
+                        std::strerror(errno));
+  }
+  std::string message;
+  try {
+    WriteMessage(fd, EncodeRequest(request));
+    if (!ReadMessage(fd, message)) {
+      throw std::runtime_error("Compile server closed the connection");
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+  return DecodeResponse(message);
+}
+
+} // namespace boyo
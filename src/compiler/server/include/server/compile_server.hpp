@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "server/protocol.hpp"
+
+namespace boyo {
+
+/**
+ * Long-running compile server. Clients connect to a Unix domain socket and
+ * send one CompileRequest per connection; requests are compiled
+ * concurrently on a pool of workers, which share the process's warm state
+ * (the g++ version and runtime fingerprints computed once, the compile
+ * cache, and the page cache behind the precompiled runtime headers), so a
+ * request costs about as much as its g++ invocations.
+ */
+class CompileServer {
+public:
+  /**
+   * Listen on socket_path. A stale socket left by a server that is gone is
+   * replaced.
+   * @param workers Requests compiled at once (0 = one per hardware thread)
+   * @throws std::runtime_error if the socket cannot be bound, or another
+   * server is already listening on it
+   */
+  CompileServer(std::string socket_path, size_t workers = 0);
+
+  // Stops listening and removes the socket
+  ~CompileServer();
+
+  CompileServer(const CompileServer &) = delete;
+  CompileServer &operator=(const CompileServer &) = delete;
+
+  /**
+   * Serve requests until Stop() is called, then finish the requests already
+   * accepted.
+   */
+  void Run();
+
+  /**
+   * Make Run() return. Safe to call from any thread or a signal handler.
+   */
+  void Stop();
+
+  /**
+   * Compile one request. Never throws: failures are reported in the
+   * response.
+   */
+  static CompileResponse Handle(const CompileRequest &request);
+
+  /**
+   * $XDG_RUNTIME_DIR/boyo.sock, falling back to /tmp/boyo-<uid>.sock
+   */
+  static std::string DefaultSocketPath();
+
+private:
+  // Read a request from a connection, compile it and answer
+  void Serve(int connection);
+
+  std::string socket_path_;
+  size_t workers_;
+  int listen_fd_ = -1;
+  int stop_pipe_[2] = {-1, -1};
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<int> connections_;
+  bool stopping_ = false;
+};
+
+/**
+ * No compile server accepted a connection, so callers may build locally
+ * instead
+ */
+class NoServerError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * Client side of CompileServer
+ */
+class CompileClient {
+public:
+  explicit CompileClient(std::string socket_path);
+
+  /**
+   * Send request and wait for the server's response.
+   * @throws NoServerError if no server is listening
+   * @throws std::runtime_error if the connection fails after that
+   */
+  CompileResponse Compile(const CompileRequest &request) const;
+
+private:
+  std::string socket_path_;
+};
+
+} // namespace boyo
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+
+namespace boyo {
+
+/**
+ * A compile request sent to a boyo compile server
+ */
+struct CompileRequest {
+  // Source lines of the program
+  std::vector<std::string> lines;
+
+  // Absolute path the binary is written to
+  std::string output_file;
+
+  // Options, with every path in them absolute
+  CompileOptions options;
+};
+
+/**
+ * The server's answer to a CompileRequest
+ */
+struct CompileResponse {
+  bool success = false;
+
+  // Why the compile failed
+  std::string error;
+
+  // g++'s output when it rejected the program (see CompileError)
+  std::string diagnostics;
+
+  // The binary that was built
+  std::string output_file;
+};
+
+/**
+ * Messages are a sequence of length-prefixed fields ("<size>:<bytes>"),
+ * starting with a protocol version so mismatched clients and servers fail
+ * cleanly. On the socket every message is preceded by its size as a
+ * little-endian uint64.
+ */
+std::string EncodeRequest(const CompileRequest &request);
+std::string EncodeResponse(const CompileResponse &response);
+
+/**
+ * @throws std::runtime_error if message is malformed or from another
+ * protocol version
+ */
+CompileRequest DecodeRequest(std::string_view message);
+CompileResponse DecodeResponse(std::string_view message);
+
+/**
+ * Write one framed message to a socket.
+ * @throws std::runtime_error if the peer has gone away
+ */
+void WriteMessage(int fd, const std::string &message);
+
+/**
+ * Read one framed message from a socket.
+ * @return false if the peer closed the connection before sending anything
+ * @throws std::runtime_error on a truncated message or a read error
+ */
+bool ReadMessage(int fd, std::string &message);
+
+} // namespace boyo
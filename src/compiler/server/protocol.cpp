@@ -0,0 +1,252 @@
+#include "server/protocol.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace boyo {
+
+namespace {
+
+const std::string kProtocolVersion = "boyo-compile-1";
+
+// Messages larger than this are rejected rather than allocated
+constexpr uint64_t kMaxMessageSize = uint64_t{1} << 30;
+
+class FieldWriter {
+public:
+  void Add(std::string_view field) {
+    message_ += std::to_string(field.size());
+    message_ += ':';
+    message_ += field;
+  }
+  void Add(uint64_t value) { Add(std::to_string(value)); }
+  void Add(bool value) { Add(std::string_view(value ? "1" : "0")); }
+  void Add(const std::vector<std::string> &fields) {
+    Add(uint64_t{fields.size()});
+    for (const auto &field : fields) {
+      Add(field);
+    }
+  }
+
+  std::string Take() { return std::move(message_); }
+
+private:
+  std::string message_;
+};
+
+class FieldReader {
+public:
+  explicit FieldReader(std::string_view message) : message_(message) {}
+
+  std::string String() {
+    size_t colon = message_.find(':');
+    if (colon == std::string_view::npos || colon == 0) {
+      throw std::runtime_error("Malformed compile server message");
+    }
+    uint64_t size = 0;
+    for (char c : message_.substr(0, colon)) {
+      if (c < '0' || c > '9' || size > message_.size()) {
+        throw std::runtime_error("Malformed compile server message");
+      }
+      size = size * 10 + (c - '0');
+    }
+    if (size > message_.size() - colon - 1) {
+      throw std::runtime_error("Truncated compile server message");
+    }
+    std::string field(message_.substr(colon + 1, size));
+    message_.remove_prefix(colon + 1 + size);
+    return field;
+  }
+
+  uint64_t Number() {
+    std::string field = String();
+    if (field.empty() ||
+        field.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::runtime_error("Malformed number in compile server message");
+    }
+    return std::stoull(field);
+  }
+
+  bool Bool() { return Number() != 0; }
+
+  std::vector<std::string> Strings() {
+    uint64_t count = Number();
+    std::vector<std::string> fields;
+    for (uint64_t i = 0; i < count; ++i) {
+      fields.push_back(String());
+    }
+    return fields;
+  }
+
+  void ExpectVersion() {
+    if (String() != kProtocolVersion) {
+      throw std::runtime_error("Compile server speaks a different protocol");
+    }
+  }
+
+  void ExpectEnd() const {
+    if (!message_.empty()) {
+      throw std::runtime_error("Trailing data in compile server message");
+    }
+  }
+
+private:
+  std::string_view message_;
+};
+
+} // namespace
+
+std::string EncodeRequest(const CompileRequest &request) {
+  const CompileOptions &options = request.options;
+  FieldWriter writer;
+  writer.Add(kProtocolVersion);
+  writer.Add(request.lines);
+  writer.Add(request.output_file);
+  writer.Add(uint64_t{options.threads});
+  writer.Add(options.stream);
+  writer.Add(uint64_t{options.stream_chunk_size});
+  writer.Add(static_cast<uint64_t>(options.output_format));
+  writer.Add(options.batch);
+  writer.Add(options.link_runtime);
+  writer.Add(options.opt_level);
+  writer.Add(options.march);
+  writer.Add(options.lto);
+  writer.Add(options.size_profile);
+  writer.Add(options.pgo_runs);
+  writer.Add(uint64_t{options.translation_units});
+  writer.Add(options.incremental);
+  writer.Add(options.object_dir);
+  writer.Add(uint64_t{options.jobs});
+  writer.Add(options.use_cache);
+  writer.Add(options.cache_dir);
+  writer.Add(options.cache_max_bytes);
+  return writer.Take();
+}
+
+CompileRequest DecodeRequest(std::string_view message) {
+  FieldReader reader(message);
+  reader.ExpectVersion();
+  CompileRequest request;
+  CompileOptions &options = request.options;
+  request.lines = reader.Strings();
+  request.output_file = reader.String();
+  options.threads = reader.Number();
+  options.stream = reader.Bool();
+  options.stream_chunk_size = reader.Number();
+  uint64_t format = reader.Number();
+  if (format > static_cast<uint64_t>(OutputFormat::kRawLengthPrefixed)) {
+    throw std::runtime_error("Unknown output format in compile request");
+  }
+  options.output_format = static_cast<OutputFormat>(format);
+  options.batch = reader.Bool();
+  options.link_runtime = reader.Bool();
+  options.opt_level = reader.String();
+  options.march = reader.String();
+  options.lto = reader.Bool();
+  options.size_profile = reader.Bool();
+  options.pgo_runs = reader.Strings();
+  options.translation_units = reader.Number();
+  options.incremental = reader.Bool();
+  options.object_dir = reader.String();
+  options.jobs = reader.Number();
+  options.use_cache = reader.Bool();
+  options.cache_dir = reader.String();
+  options.cache_max_bytes = reader.Number();
+  reader.ExpectEnd();
+  return request;
+}
+
+std::string EncodeResponse(const CompileResponse &response) {
+  FieldWriter writer;
+  writer.Add(kProtocolVersion);
+  writer.Add(response.success);
+  writer.Add(response.error);
+  writer.Add(response.diagnostics);
+  writer.Add(response.output_file);
+  return writer.Take();
+}
+
+CompileResponse DecodeResponse(std::string_view message) {
+  FieldReader reader(message);
+  reader.ExpectVersion();
+  CompileResponse response;
+  response.success = reader.Bool();
+  response.error = reader.String();
+  response.diagnostics = reader.String();
+  response.output_file = reader.String();
+  reader.ExpectEnd();
+  return response;
+}
+
+void WriteMessage(int fd, const std::string &message) {
+  uint8_t header[8];
+  for (int i = 0; i < 8; ++i) {
+    header[i] = static_cast<uint8_t>(uint64_t{message.size()} >> (8 * i));
+  }
+  std::string framed(reinterpret_cast<const char *>(header), sizeof(header));
+  framed += message;
+
+  // MSG_NOSIGNAL: a client that hung up is an error, not a SIGPIPE
+  for (size_t sent = 0; sent < framed.size();) {
+    ssize_t written = send(fd, framed.data() + sent, framed.size() - sent,
+                           MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("Failed to send message: ") +
+                               std::strerror(errno));
+    }
+    sent += written;
+  }
+}
+
+// Read exactly size bytes; returns the number read before EOF
+static size_t ReadFully(int fd, char *data, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t count = read(fd, data + done, size - done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("Failed to read message: ") +
+                               std::strerror(errno));
+    }
+    if (count == 0) {
+      break;
+    }
+    done += count;
+  }
+  return done;
+}
+
+bool ReadMessage(int fd, std::string &message) {
+  uint8_t header[8];
+  size_t got = ReadFully(fd, reinterpret_cast<char *>(header), sizeof(header));
+  if (got == 0) {
+    return false;
+  }
+  if (got < sizeof(header)) {
+    throw std::runtime_error("Truncated message");
+  }
+  uint64_t size = 0;
+  for (int i = 0; i < 8; ++i) {
+    size |= uint64_t{header[i]} << (8 * i);
+  }
+  if (size > kMaxMessageSize) {
+    throw std::runtime_error("Message too large");
+  }
+  message.resize(size);
+  if (ReadFully(fd, message.data(), size) < size) {
+    throw std::runtime_error("Truncated message");
+  }
+  return true;
+}
+
+} // namespace boyo
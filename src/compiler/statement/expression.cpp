@@ -21,6 +21,26 @@ HexLiteralExpression::HexLiteralExpression(const std::string &hex_string)
   }
 }
 
+uint8_t HexLiteralExpression::GetByte() const {
+  unsigned value = 0;
+  for (size_t i = 2; i < hex_string_.size(); ++i) {
+    char c = hex_string_[i];
+    int digit = c >= '0' && c <= '9'   ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                       : -1;
+    if (digit < 0) {
+      throw std::runtime_error("Invalid hex literal: " + hex_string_);
+    }
+    value = value * 16 + digit;
+    if (value > 0xFF) {
+      throw std::runtime_error("Hex literal does not fit in a byte: " +
+                               hex_string_);
+    }
+  }
+  return static_cast<uint8_t>(value);
+}
+
 std::string OperatorExpression::ToString() const {
   // Return Polish notation: "operator left right"
   std::ostringstream oss;
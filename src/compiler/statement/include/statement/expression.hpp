@@ -35,6 +35,11 @@ public:
 
   const std::string &GetHexString() const { return hex_string_; }
 
+  // The value as the one byte generated code holds: the literal initializes
+  // a vector in braces, so g++ rejects anything wider as narrowing
+  // @throws std::runtime_error if the value does not fit in a byte
+  uint8_t GetByte() const;
+
 private:
   std::string hex_string_; // Original string (e.g., "0x10")
 };
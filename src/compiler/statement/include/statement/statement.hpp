@@ -15,6 +15,14 @@ public:
   // Generate the C++ code for this statement
   virtual std::string GenerateCode() const = 0;
 
+  // Generate a declaration through which other translation units can use
+  // this statement's definition (empty if it defines nothing)
+  virtual std::string GenerateDeclarationCode() const { return ""; }
+
+  // Names of the lets and defs this statement's code refers to, sorted and
+  // without duplicates
+  virtual std::vector<std::string> GetDependencies() const { return {}; }
+
   // Get the expressions in this statement
   const ExpressionList &GetExpressions() const { return expressions_; }
 
@@ -36,6 +44,12 @@ class LetStatement : public Statement {
 public:
   LetStatement(std::string var_name, std::unique_ptr<Expression> value_expr);
   std::string GenerateCode() const override;
+  std::string GenerateDeclarationCode() const override;
+  std::vector<std::string> GetDependencies() const override;
+
+  // Generate the let as a compile-time constant, for code that never
+  // rebinds it: static constexpr std::array<uint8_t, 1> A = {0x10};
+  std::string GenerateConstantCode() const;
 
   const std::string &GetVarName() const { return var_name_; }
   const Expression &GetValueExpr() const { return *value_expr_; }
@@ -54,12 +68,36 @@ public:
   DefStatement(std::string func_name, std::vector<std::string> params,
                std::unique_ptr<Expression> body_expr);
   std::string GenerateCode() const override;
+  std::string GenerateDeclarationCode() const override;
+  std::vector<std::string> GetDependencies() const override;
+
+  // Generate boyo_chunk_<name>, which computes one streaming chunk of the
+  // result: globals and literals are windowed to the chunk at boyo_offset
+  std::string GenerateChunkCode() const;
+
+  // Generate the prototype of boyo_chunk_<name>
+  std::string GenerateChunkDeclarationCode() const;
+
+  // Generate extern "C" function symbol over raw buffers:
+  //   size_t symbol(const uint8_t* _a, size_t _a_len, ...,
+  //                 uint8_t* boyo_out, size_t boyo_out_cap)
+  // It returns the result length and writes the result only if it fits in
+  // boyo_out_cap, without allocating. The body is one fused loop per byte;
+  // lets are read in place.
+  std::string GenerateSpanCode(const std::string &symbol) const;
+
+  // Generate the prototype of GenerateSpanCode(symbol), without extern "C"
+  std::string GenerateSpanDeclarationCode(const std::string &symbol) const;
 
   const std::string &GetFuncName() const { return func_name_; }
   const std::vector<std::string> &GetParams() const { return params_; }
   const Expression &GetBodyExpr() const { return *body_expr_; }
 
 private:
+  // "std::vector<uint8_t> name(<leading>const std::vector<uint8_t>& _a, ...)"
+  std::string GenerateSignature(const std::string &name,
+                                const std::string &leading_params) const;
+
   std::string func_name_;
   std::vector<std::string> params_;
   std::unique_ptr<Expression> body_expr_;
@@ -74,6 +112,20 @@ public:
   MainStatement(std::string func_name, std::vector<std::string> args);
   std::string GenerateCode() const override;
 
+  // Generate the call expression only, e.g. "double(A)"
+  std::string GenerateCallCode() const;
+
+  // Generate a chunked evaluation that streams arguments bound at runtime
+  // and writes each result chunk to sink as it is computed
+  std::string
+  GenerateStreamCode(size_t chunk_size,
+                     const std::string &sink = "boyo_hex_sink{std::cout}") const;
+
+  // Generate batch mode: the call is applied to every runtime record, with
+  // arguments a record leaves out taking their global values
+  std::string GenerateBatchCode(size_t threads,
+                                const std::string &format) const;
+
   const std::string &GetFuncName() const { return func_name_; }
   const std::vector<std::string> &GetArgs() const { return args_; }
 
@@ -84,4 +136,8 @@ private:
 
 using StatementList = std::vector<std::unique_ptr<Statement>>;
 
+// Whether name cannot name a let or def: names become C++ names in the
+// generated code, so the C++17 keywords and main are taken
+bool IsReservedName(const std::string &name);
+
 } // namespace boyo
@@ -1,5 +1,7 @@
 #include "statement/statement.hpp"
 
+#include <algorithm>
+#include <set>
 #include <sstream>
 
 #include "statement/expression.hpp"
@@ -7,7 +9,8 @@
 namespace boyo {
 
 // Forward declaration
-std::string GenerateExpressionCode(const Expression *expr);
+std::string GenerateExpressionCode(const Expression *expr,
+                                   bool windowed = false);
 
 /**
  * Constructor for PrintStatement
@@ -58,32 +61,231 @@ std::string LetStatement::GenerateCode() const {
   return oss.str();
 }
 
+std::string LetStatement::GenerateDeclarationCode() const {
+  // Generate: extern std::vector<uint8_t> A;
+  return "extern std::vector<uint8_t> " + var_name_ + ";\n";
+}
+
+std::string LetStatement::GenerateConstantCode() const {
+  if (auto *hex_expr =
+          dynamic_cast<const HexLiteralExpression *>(value_expr_.get())) {
+    return "static constexpr std::array<uint8_t, 1> " + var_name_ + " = {" +
+           hex_expr->GetHexString() + "};\n";
+  }
+  return "static constexpr auto " + var_name_ + " = " +
+         value_expr_->ToString() + ";\n";
+}
+
+std::vector<std::string> LetStatement::GetDependencies() const {
+  if (auto *identifier =
+          dynamic_cast<const IdentifierExpression *>(value_expr_.get())) {
+    return {identifier->GetName()};
+  }
+  return {};
+}
+
+// Collect the names of the identifiers in expr into names
+static void CollectIdentifiers(const Expression &expr,
+                               std::vector<std::string> &names) {
+  if (auto *identifier = dynamic_cast<const IdentifierExpression *>(&expr)) {
+    names.push_back(identifier->GetName());
+  } else if (auto *op = dynamic_cast<const OperatorExpression *>(&expr)) {
+    CollectIdentifiers(op->GetLeft(), names);
+    CollectIdentifiers(op->GetRight(), names);
+  }
+}
+
 DefStatement::DefStatement(std::string func_name,
                            std::vector<std::string> params,
                            std::unique_ptr<Expression> body_expr)
     : func_name_(std::move(func_name)), params_(std::move(params)),
       body_expr_(std::move(body_expr)) {}
 
-std::string DefStatement::GenerateCode() const {
-  // Generate: std::vector<uint8_t> double(const std::vector<uint8_t>& _a) { ...
-  // }
+std::string
+DefStatement::GenerateSignature(const std::string &name,
+                                const std::string &leading_params) const {
   std::ostringstream oss;
-  oss << "std::vector<uint8_t> " << func_name_ << "(";
+  oss << "std::vector<uint8_t> " << name << "(" << leading_params;
 
   // Generate parameters
   for (size_t i = 0; i < params_.size(); ++i) {
-    if (i > 0)
+    if (i > 0 || !leading_params.empty())
       oss << ", ";
     oss << "const std::vector<uint8_t>& " << params_[i];
   }
 
-  oss << ") {\n";
+  oss << ")";
+  return oss.str();
+}
+
+std::string DefStatement::GenerateCode() const {
+  // Generate: std::vector<uint8_t> double(const std::vector<uint8_t>& _a) { ...
+  // }
+  std::ostringstream oss;
+  oss << GenerateSignature(func_name_, "") << " {\n";
   oss << "  return " << GenerateExpressionCode(body_expr_.get()) << ";\n";
   oss << "}\n";
 
   return oss.str();
 }
 
+std::string DefStatement::GenerateDeclarationCode() const {
+  // Generate: std::vector<uint8_t> double(const std::vector<uint8_t>& _a);
+  return GenerateSignature(func_name_, "") + ";\n";
+}
+
+std::vector<std::string> DefStatement::GetDependencies() const {
+  std::vector<std::string> names;
+  CollectIdentifiers(*body_expr_, names);
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  return names;
+}
+
+std::string DefStatement::GenerateChunkCode() const {
+  // Generate: std::vector<uint8_t> boyo_chunk_double(size_t boyo_offset,
+  // size_t boyo_size, const std::vector<uint8_t>& _a) { ... }
+  std::ostringstream oss;
+  oss << GenerateSignature("boyo_chunk_" + func_name_,
+                           "size_t boyo_offset, size_t boyo_size")
+      << " {\n";
+  oss << "  return " << GenerateExpressionCode(body_expr_.get(), true)
+      << ";\n";
+  oss << "}\n";
+
+  return oss.str();
+}
+
+std::string DefStatement::GenerateChunkDeclarationCode() const {
+  return GenerateSignature("boyo_chunk_" + func_name_,
+                           "size_t boyo_offset, size_t boyo_size") +
+         ";\n";
+}
+
+// The operands of a span kernel by length: parameters, and the lets and
+// literals, which are short (a let is one byte unless it is rebound)
+struct SpanOperands {
+  std::vector<std::string> params;
+  std::vector<std::string> shorts;
+  bool literal = false;
+};
+
+static void AddLength(std::vector<std::string> &lengths,
+                      const std::string &length) {
+  if (std::find(lengths.begin(), lengths.end(), length) == lengths.end()) {
+    lengths.push_back(length);
+  }
+}
+
+static void CollectSpanOperands(const Expression &expr,
+                                SpanOperands &operands) {
+  if (auto *param = dynamic_cast<const ParameterExpression *>(&expr)) {
+    AddLength(operands.params, param->GetParamName() + "_len");
+  } else if (auto *identifier =
+                 dynamic_cast<const IdentifierExpression *>(&expr)) {
+    AddLength(operands.shorts, "boyo_" + identifier->GetName() + "_len");
+  } else if (auto *op = dynamic_cast<const OperatorExpression *>(&expr)) {
+    CollectSpanOperands(op->GetLeft(), operands);
+    CollectSpanOperands(op->GetRight(), operands);
+  } else {
+    operands.literal = true;
+  }
+}
+
+// One byte of expr at boyo_i, computed in unsigned so it wraps. When
+// in_range, every parameter is known to be longer than boyo_i and lets and
+// literals to be shorter, so nothing is bounds checked.
+static std::string GenerateElementCode(const Expression &expr, bool in_range) {
+  if (auto *op = dynamic_cast<const OperatorExpression *>(&expr)) {
+    return "(" + GenerateElementCode(op->GetLeft(), in_range) + " " +
+           op->GetOperator() + " " +
+           GenerateElementCode(op->GetRight(), in_range) + ")";
+  }
+  if (auto *hex = dynamic_cast<const HexLiteralExpression *>(&expr)) {
+    return in_range ? "0u"
+                    : "(boyo_i == 0 ? " + hex->GetHexString() + "u : 0u)";
+  }
+  std::string data;
+  if (auto *param = dynamic_cast<const ParameterExpression *>(&expr)) {
+    data = param->GetParamName();
+    if (in_range) {
+      return "unsigned(" + data + "[boyo_i])";
+    }
+  } else if (auto *identifier =
+                 dynamic_cast<const IdentifierExpression *>(&expr)) {
+    data = "boyo_" + identifier->GetName();
+    if (in_range) {
+      return "0u";
+    }
+  } else {
+    throw std::runtime_error("Unknown expression type in code generation");
+  }
+  return "(boyo_i < " + data + "_len ? unsigned(" + data + "[boyo_i]) : 0u)";
+}
+
+std::string
+DefStatement::GenerateSpanDeclarationCode(const std::string &symbol) const {
+  // Generate: size_t symbol(const uint8_t* _a, size_t _a_len,
+  // uint8_t* boyo_out, size_t boyo_out_cap)
+  std::ostringstream oss;
+  oss << "size_t " << symbol << "(";
+  for (const auto &param : params_) {
+    oss << "const uint8_t* " << param << ", size_t " << param << "_len, ";
+  }
+  oss << "uint8_t* boyo_out, size_t boyo_out_cap)";
+  return oss.str();
+}
+
+std::string DefStatement::GenerateSpanCode(const std::string &symbol) const {
+  SpanOperands operands;
+  CollectSpanOperands(*body_expr_, operands);
+
+  std::ostringstream oss;
+  oss << "extern \"C\" " << GenerateSpanDeclarationCode(symbol) << " {\n";
+  // Hoisted, since stores through boyo_out may alias the vectors themselves
+  for (const auto &name : GetDependencies()) {
+    oss << "  const uint8_t* boyo_" << name << " = " << name << ".data();\n";
+    oss << "  size_t boyo_" << name << "_len = " << name << ".size();\n";
+  }
+  oss << "  size_t boyo_len = " << (operands.literal ? "1" : "0") << ";\n";
+  for (const auto &length : operands.params) {
+    oss << "  if (" << length << " > boyo_len) boyo_len = " << length
+        << ";\n";
+  }
+  for (const auto &length : operands.shorts) {
+    oss << "  if (" << length << " > boyo_len) boyo_len = " << length
+        << ";\n";
+  }
+  oss << "  if (boyo_len > boyo_out_cap) return boyo_len;\n";
+
+  // Bytes split into a head where lets and literals still have bytes, the
+  // stretch after it where every parameter does, which needs no bounds
+  // checks and vectorizes, and a tail past the shortest parameter
+  oss << "  size_t boyo_head = " << (operands.literal ? "1" : "0") << ";\n";
+  for (const auto &length : operands.shorts) {
+    oss << "  if (" << length << " > boyo_head) boyo_head = " << length
+        << ";\n";
+  }
+  oss << "  size_t boyo_common = boyo_len;\n";
+  for (const auto &length : operands.params) {
+    oss << "  if (" << length << " < boyo_common) boyo_common = " << length
+        << ";\n";
+  }
+  std::string checked = GenerateElementCode(*body_expr_, false);
+  oss << "  size_t boyo_i = 0;\n";
+  oss << "  for (; boyo_i < boyo_head && boyo_i < boyo_len; ++boyo_i)\n";
+  oss << "    boyo_out[boyo_i] = uint8_t(" << checked << ");\n";
+  oss << "  for (; boyo_i < boyo_common; ++boyo_i)\n";
+  oss << "    boyo_out[boyo_i] = uint8_t("
+      << GenerateElementCode(*body_expr_, true) << ");\n";
+  oss << "  for (; boyo_i < boyo_len; ++boyo_i)\n";
+  oss << "    boyo_out[boyo_i] = uint8_t(" << checked << ");\n";
+  oss << "  return boyo_len;\n";
+  oss << "}\n";
+
+  return oss.str();
+}
+
 MainStatement::MainStatement(std::string func_name,
                              std::vector<std::string> args)
     : func_name_(std::move(func_name)), args_(std::move(args)) {}
@@ -92,7 +294,17 @@ std::string MainStatement::GenerateCode() const {
   // Generate: auto result = double(A); print_vector(std::cout, result);
   std::ostringstream oss;
 
-  oss << "auto result = " << func_name_ << "(";
+  oss << "auto result = " << GenerateCallCode() << ";\n";
+  oss << "print_vector(std::cout, result);\n";
+
+  return oss.str();
+}
+
+std::string MainStatement::GenerateCallCode() const {
+  // Generate: double(A)
+  std::ostringstream oss;
+
+  oss << func_name_ << "(";
 
   // Generate arguments
   for (size_t i = 0; i < args_.size(); ++i) {
@@ -101,14 +313,71 @@ std::string MainStatement::GenerateCode() const {
     oss << args_[i];
   }
 
+  oss << ")";
+
+  return oss.str();
+}
+
+std::string MainStatement::GenerateStreamCode(size_t chunk_size,
+                                              const std::string &sink) const {
+  // Each distinct argument gets one source, so repeated arguments share a
+  // stream instead of reading it twice
+  std::vector<std::string> sources;
+  std::vector<size_t> arg_sources;
+  for (const auto &arg : args_) {
+    auto it = std::find(sources.begin(), sources.end(), arg);
+    arg_sources.push_back(it - sources.begin());
+    if (it == sources.end()) {
+      sources.push_back(arg);
+    }
+  }
+
+  std::ostringstream oss;
+  oss << "{\n";
+  oss << "std::vector<boyo_source> boyo_sources;\n";
+  for (const auto &source : sources) {
+    oss << "boyo_sources.emplace_back(" << source
+        << ", boyo_find_binding(argc, argv, \"" << source << "\"));\n";
+  }
+  oss << "boyo_stream(" << sink << ", boyo_sources, " << chunk_size
+      << ", [](size_t boyo_offset, size_t boyo_size, "
+         "const std::vector<std::vector<uint8_t>>& boyo_args) {\n";
+  oss << "return boyo_chunk_" << func_name_ << "(boyo_offset, boyo_size";
+  for (size_t index : arg_sources) {
+    oss << ", boyo_args[" << index << "]";
+  }
   oss << ");\n";
-  oss << "print_vector(std::cout, result);\n";
+  oss << "});\n";
+  oss << "}\n";
+
+  return oss.str();
+}
+
+std::string MainStatement::GenerateBatchCode(size_t threads,
+                                             const std::string &format) const {
+  std::ostringstream oss;
+  oss << "boyo_run_batch(argc, argv, " << threads << ", " << format << ", {";
+  for (size_t i = 0; i < args_.size(); ++i) {
+    if (i > 0)
+      oss << ", ";
+    oss << "&" << args_[i];
+  }
+  oss << "}, [](const std::vector<uint8_t>* const* boyo_args) {\n";
+  oss << "return " << func_name_ << "(";
+  for (size_t i = 0; i < args_.size(); ++i) {
+    if (i > 0)
+      oss << ", ";
+    oss << "*boyo_args[" << i << "]";
+  }
+  oss << ");\n";
+  oss << "});\n";
 
   return oss.str();
 }
 
-// Helper function to generate code for expressions (especially operators)
-std::string GenerateExpressionCode(const Expression *expr) {
+// Helper function to generate code for expressions (especially operators).
+// When windowed, globals and literals are sliced to the current stream chunk.
+std::string GenerateExpressionCode(const Expression *expr, bool windowed) {
   if (auto *op_expr = dynamic_cast<const OperatorExpression *>(expr)) {
     // Generate operator function call: multiply_vectors(left, right)
     std::string op_func;
@@ -122,12 +391,17 @@ std::string GenerateExpressionCode(const Expression *expr) {
       throw std::runtime_error("Unknown operator: " + op_expr->GetOperator());
     }
 
-    return op_func + "(" + GenerateExpressionCode(&op_expr->GetLeft()) + ", " +
-           GenerateExpressionCode(&op_expr->GetRight()) + ")";
+    return op_func + "(" +
+           GenerateExpressionCode(&op_expr->GetLeft(), windowed) + ", " +
+           GenerateExpressionCode(&op_expr->GetRight(), windowed) + ")";
   }
 
   if (auto *hex_expr = dynamic_cast<const HexLiteralExpression *>(expr)) {
     // Generate: {0x10}
+    if (windowed) {
+      return "boyo_window({" + hex_expr->GetHexString() +
+             "}, boyo_offset, boyo_size)";
+    }
     return "{" + hex_expr->GetHexString() + "}";
   }
 
@@ -138,10 +412,31 @@ std::string GenerateExpressionCode(const Expression *expr) {
 
   if (auto *id_expr = dynamic_cast<const IdentifierExpression *>(expr)) {
     // Generate: identifier name
+    if (windowed) {
+      return "boyo_window(" + id_expr->GetName() + ", boyo_offset, boyo_size)";
+    }
     return id_expr->GetName();
   }
 
   throw std::runtime_error("Unknown expression type in code generation");
 }
 
+bool IsReservedName(const std::string &name) {
+  static const std::set<std::string> kReservedNames = {
+      "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+      "bool", "break", "case", "catch", "char", "char16_t", "char32_t",
+      "class", "compl", "const", "constexpr", "const_cast", "continue",
+      "decltype", "default", "delete", "do", "double", "dynamic_cast", "else",
+      "enum", "explicit", "export", "extern", "false", "float", "for",
+      "friend", "goto", "if", "inline", "int", "long", "main", "mutable",
+      "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator",
+      "or", "or_eq", "private", "protected", "public", "register",
+      "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+      "static_assert", "static_cast", "struct", "switch", "template", "this",
+      "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+      "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t",
+      "while", "xor", "xor_eq"};
+  return kReservedNames.count(name) > 0;
+}
+
 } // namespace boyo
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+#include "statement/statement.hpp"
+#include "vm/vm.hpp"
+
+namespace boyo {
+
+struct TieredOptions {
+  // Calls after which a def is compiled to native code
+  size_t threshold = 1000;
+
+  // Options of the g++ builds of hot defs
+  CompileOptions compile_options;
+};
+
+/**
+ * Runs a program on the VM from the start and moves its hot defs to native
+ * code without stopping. Calls are counted per def; the call that reaches
+ * the threshold queues the def for a background thread that builds it into
+ * a shared object with the Compiler's g++ path and loads it with dlopen.
+ * The def's call target is then swapped atomically, so calls already on the
+ * VM finish there and later ones run natively. A def whose build fails
+ * stays on the VM.
+ */
+class TieredProgram {
+public:
+  /**
+   * @param args NAME=SOURCE bindings of main arguments, as a compiled
+   * program takes them; bound once for every run and call
+   * @throws std::runtime_error if the program is invalid, or for an unknown
+   * argument or unreadable input
+   */
+  explicit TieredProgram(StatementList statements,
+                         const std::vector<std::string> &args = {},
+                         TieredOptions options = {});
+
+  // Waits for the build in progress, if any; queued builds are dropped
+  ~TieredProgram();
+
+  TieredProgram(const TieredProgram &) = delete;
+  TieredProgram &operator=(const TieredProgram &) = delete;
+
+  // Print the result of every main statement to os
+  void Run(std::ostream &os);
+
+  // As Vm::FindFunction
+  size_t FindFunction(const std::string &name, size_t params) const;
+
+  // Call a def on its current tier; thread safe
+  std::vector<uint8_t> Call(size_t function,
+                            const std::vector<uint8_t> *const *args);
+
+  std::vector<uint8_t> Call(const std::string &name,
+                            const std::vector<std::vector<uint8_t>> &args);
+
+  // Whether function has moved to native code
+  bool IsNative(size_t function) const;
+
+  // Block until every build queued so far has finished
+  void WaitForCompiles();
+
+private:
+  using Entry = void (*)(const std::vector<uint8_t> *const *args,
+                         std::vector<uint8_t> *result);
+
+  struct Tier {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<Entry> native{nullptr};
+  };
+
+  // Build, load and install function; runs on the background thread
+  void Promote(size_t function);
+  void CompileLoop();
+
+  StatementList statements_;
+  Compiler compiler_;
+  size_t threshold_;
+  std::unique_ptr<Vm> vm_;
+  std::unique_ptr<Tier[]> tiers_;
+
+  // Shared objects are built in scratch_ and stay loaded until destruction
+  std::string scratch_;
+  std::vector<void *> handles_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<size_t> queue_;
+  bool compiling_ = false;
+  bool stopping_ = false;
+  std::thread worker_;
+};
+
+} // namespace boyo
@@ -0,0 +1,191 @@
+#include "tiered/tiered_program.hpp"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#include "runtime/boyo_runtime.hpp"
+#include "vm/bytecode.hpp"
+
+namespace boyo {
+
+TieredProgram::TieredProgram(StatementList statements,
+                             const std::vector<std::string> &args,
+                             TieredOptions options)
+    : statements_(std::move(statements)),
+      compiler_(std::move(options.compile_options)),
+      threshold_(std::max<size_t>(options.threshold, 1)) {
+  // The VM and every shared object see the bound globals, so both tiers
+  // compute the same results
+  Bytecode bytecode = CompileBytecode(statements_);
+  bytecode.globals = Vm(bytecode).BindGlobals(args);
+  vm_ = std::make_unique<Vm>(std::move(bytecode));
+  tiers_ = std::make_unique<Tier[]>(vm_->GetBytecode().functions.size());
+}
+
+TieredProgram::~TieredProgram() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+  }
+  changed_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+  for (void *handle : handles_) {
+    dlclose(handle);
+  }
+  if (!scratch_.empty()) {
+    std::error_code error;
+    std::filesystem::remove_all(scratch_, error);
+  }
+}
+
+size_t TieredProgram::FindFunction(const std::string &name,
+                                   size_t params) const {
+  return vm_->FindFunction(name, params);
+}
+
+bool TieredProgram::IsNative(size_t function) const {
+  if (function >= vm_->GetBytecode().functions.size()) {
+    throw std::out_of_range("No function " + std::to_string(function));
+  }
+  return tiers_[function].native.load(std::memory_order_acquire) != nullptr;
+}
+
+std::vector<uint8_t>
+TieredProgram::Call(size_t function, const std::vector<uint8_t> *const *args) {
+  if (function >= vm_->GetBytecode().functions.size()) {
+    throw std::out_of_range("No function " + std::to_string(function));
+  }
+  Tier &tier = tiers_[function];
+  if (Entry native = tier.native.load(std::memory_order_acquire)) {
+    std::vector<uint8_t> result;
+    native(args, &result);
+    return result;
+  }
+
+  // Exactly one call sees the count reach the threshold
+  if (tier.calls.fetch_add(1, std::memory_order_relaxed) + 1 == threshold_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(function);
+    if (!worker_.joinable()) {
+      worker_ = std::thread(&TieredProgram::CompileLoop, this);
+    }
+    changed_.notify_all();
+  }
+  return vm_->Call(function, args);
+}
+
+std::vector<uint8_t>
+TieredProgram::Call(const std::string &name,
+                    const std::vector<std::vector<uint8_t>> &args) {
+  size_t function = FindFunction(name, args.size());
+  std::vector<const std::vector<uint8_t> *> pointers;
+  for (const auto &arg : args) {
+    pointers.push_back(&arg);
+  }
+  return Call(function, pointers.data());
+}
+
+void TieredProgram::Run(std::ostream &os) {
+  // Main only loads globals, calls defs and prints (see CompileBytecode)
+  const Bytecode &bytecode = vm_->GetBytecode();
+  const BytecodeFunction &main = bytecode.main;
+  std::vector<const std::vector<uint8_t> *> registers(main.registers);
+  std::vector<std::vector<uint8_t>> results(main.registers);
+  for (uint32_t i = main.entry; i < main.entry + main.size; ++i) {
+    const Instruction &instruction = bytecode.code[i];
+    switch (instruction.op) {
+    case Opcode::kLoadGlobal:
+      registers[instruction.a] = &bytecode.globals[instruction.b];
+      break;
+    case Opcode::kCall:
+      results[instruction.a] =
+          Call(instruction.b, &registers[instruction.c]);
+      registers[instruction.a] = &results[instruction.a];
+      break;
+    case Opcode::kPrint:
+      print_vector(os, *registers[instruction.a]);
+      break;
+    default:
+      return;
+    }
+  }
+}
+
+void TieredProgram::WaitForCompiles() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this]() { return queue_.empty() && !compiling_; });
+}
+
+void TieredProgram::CompileLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+    if (stopping_) {
+      return;
+    }
+    size_t function = queue_.front();
+    queue_.pop_front();
+    compiling_ = true;
+    lock.unlock();
+    try {
+      Promote(function);
+    } catch (const std::exception &) {
+      // The def keeps running on the VM
+    }
+    lock.lock();
+    compiling_ = false;
+    changed_.notify_all();
+  }
+}
+
+void TieredProgram::Promote(size_t index) {
+  if (scratch_.empty()) {
+    std::string scratch_template =
+        (std::filesystem::temp_directory_path() / "boyo-tiers-XXXXXX")
+            .string();
+    if (mkdtemp(scratch_template.data()) == nullptr) {
+      throw std::runtime_error("Failed to create directory for tiers");
+    }
+    scratch_ = scratch_template;
+  }
+
+  const Bytecode &bytecode = vm_->GetBytecode();
+  const BytecodeFunction &function = bytecode.functions[index];
+  std::string path = scratch_ + "/" + function.name + "_" +
+                     std::to_string(function.params) + ".so";
+  compiler_.compile_shared_object(statements_, path, {function.name});
+
+  void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    throw std::runtime_error(std::string("Failed to load ") + path + ": " +
+                             dlerror());
+  }
+  handles_.push_back(handle);
+
+  // The shared object's lets start out with their values in the source
+  using Global = std::vector<uint8_t> *(*)();
+  for (size_t i = 0; i < bytecode.global_names.size(); ++i) {
+    auto global = reinterpret_cast<Global>(
+        dlsym(handle, Compiler::GlobalSymbol(bytecode.global_names[i]).c_str()));
+    if (global) {
+      *global() = bytecode.globals[i];
+    }
+  }
+  auto entry = reinterpret_cast<Entry>(dlsym(
+      handle,
+      Compiler::EntrySymbol(function.name, function.params).c_str()));
+  if (!entry) {
+    throw std::runtime_error("Missing entry point in " + path);
+  }
+  tiers_[index].native.store(entry, std::memory_order_release);
+}
+
+} // namespace boyo
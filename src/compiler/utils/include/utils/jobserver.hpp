@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace boyo {
+
+/**
+ * Client of a GNU make jobserver, so compiles started from a parallel make
+ * share make's job slots instead of oversubscribing the machine. make
+ * reserves one slot for this process; every further concurrent job needs a
+ * token read from the jobserver, which is written back when the job ends.
+ */
+class JobServer {
+public:
+  // A held job slot: a token byte, or kImplicitToken for the reserved slot
+  using Token = int;
+  static constexpr Token kImplicitToken = -1;
+
+  /**
+   * Use the jobserver behind the given file descriptors.
+   * @param read_fd Descriptor tokens are read from
+   * @param write_fd Descriptor tokens are returned to
+   * @param owns_fds Close the descriptors on destruction
+   */
+  JobServer(int read_fd, int write_fd, bool owns_fds = false);
+  ~JobServer();
+
+  JobServer(const JobServer &) = delete;
+  JobServer &operator=(const JobServer &) = delete;
+
+  /**
+   * Connect to the jobserver named in MAKEFLAGS text, given either as
+   * --jobserver-auth=R,W (inherited descriptors) or
+   * --jobserver-auth=fifo:PATH.
+   * @return The jobserver, or nullptr if there is none or it is unusable
+   */
+  static std::unique_ptr<JobServer> FromMakeflags(const std::string &makeflags);
+
+  /**
+   * Connect to the jobserver of the make that started this process, if any
+   */
+  static std::unique_ptr<JobServer> FromEnvironment();
+
+  /**
+   * Take a job slot, blocking until one is free.
+   * @throws std::runtime_error if the jobserver fails
+   */
+  Token Acquire();
+
+  /**
+   * Give back a slot taken with Acquire().
+   */
+  void Release(Token token);
+
+private:
+  int read_fd_;
+  int write_fd_;
+  bool owns_fds_;
+  std::atomic<bool> implicit_free_{true};
+};
+
+} // namespace boyo
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace boyo {
+
+/**
+ * Run task(0) .. task(count - 1) on a pool of threads. Tasks are claimed in
+ * index order; the first exception thrown is rethrown once every thread has
+ * finished.
+ * @param count Number of tasks
+ * @param threads Maximum threads to use (0 = one per hardware thread)
+ * @param task The task to run for each index
+ */
+void ParallelFor(size_t count, size_t threads,
+                 const std::function<void(size_t)> &task);
+
+} // namespace boyo
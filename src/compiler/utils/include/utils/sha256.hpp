@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace boyo {
+
+/**
+ * Incremental SHA-256 hasher, used to key content-addressed caches.
+ */
+class Sha256 {
+public:
+  Sha256();
+
+  /**
+   * Feed more data into the hash.
+   * @param data The bytes to hash
+   */
+  void Update(std::string_view data);
+
+  /**
+   * Finish hashing and return the digest as 64 lowercase hex characters.
+   * The hasher must not be updated afterwards.
+   */
+  std::string HexDigest();
+
+  /**
+   * Hash data in one call.
+   * @param data The bytes to hash
+   * @return The digest as 64 lowercase hex characters
+   */
+  static std::string Hash(std::string_view data);
+
+private:
+  void ProcessBlock(const uint8_t *block);
+
+  std::array<uint32_t, 8> state_;
+  std::array<uint8_t, 64> buffer_;
+  size_t buffer_size_ = 0;
+  uint64_t total_bytes_ = 0;
+};
+
+} // namespace boyo
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace boyo {
+
+/**
+ * A child process started with posix_spawn, without a shell. Its stdin is a
+ * pipe fed with Write(), and its stdout and stderr are captured together
+ * through a second pipe, which is drained while writing so neither process
+ * blocks on a full pipe.
+ */
+class Subprocess {
+public:
+  /**
+   * Start a process.
+   * @param args Program path followed by its arguments
+   * @param capture_output Capture stdout and stderr; otherwise stdout is
+   * discarded and stderr is inherited
+   * @throws std::runtime_error if the process cannot be started
+   */
+  explicit Subprocess(const std::vector<std::string> &args,
+                      bool capture_output = true);
+
+  // Closes stdin and waits for the process if Wait() was not called
+  ~Subprocess();
+
+  Subprocess(const Subprocess &) = delete;
+  Subprocess &operator=(const Subprocess &) = delete;
+
+  /**
+   * Write data to the process's stdin.
+   * @param data The bytes to write
+   * @return false if the process stopped reading its input
+   */
+  bool Write(std::string_view data);
+
+  /**
+   * Close stdin, collect the remaining output and wait for the process.
+   * @return The exit code, or 128 + the signal number if it was killed
+   */
+  int Wait();
+
+  /**
+   * The captured stdout and stderr, complete once Wait() returns
+   */
+  const std::string &GetOutput() const { return output_; }
+
+private:
+  // Read one block of output into output_; false at EOF
+  bool ReadOutput();
+
+  pid_t pid_ = -1;
+  int input_fd_ = -1;
+  int output_fd_ = -1;
+  std::string output_;
+  int exit_code_ = -1;
+};
+
+} // namespace boyo
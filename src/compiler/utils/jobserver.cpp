@@ -0,0 +1,103 @@
+#include "utils/jobserver.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace boyo {
+
+JobServer::JobServer(int read_fd, int write_fd, bool owns_fds)
+    : read_fd_(read_fd), write_fd_(write_fd), owns_fds_(owns_fds) {}
+
+JobServer::~JobServer() {
+  if (owns_fds_) {
+    close(read_fd_);
+    if (write_fd_ != read_fd_) {
+      close(write_fd_);
+    }
+  }
+}
+
+std::unique_ptr<JobServer>
+JobServer::FromMakeflags(const std::string &makeflags) {
+  // The last option wins; older makes spell it --jobserver-fds
+  std::string auth;
+  for (const char *option : {"--jobserver-fds=", "--jobserver-auth="}) {
+    size_t pos = makeflags.rfind(option);
+    if (pos != std::string::npos) {
+      pos += std::strlen(option);
+      auth = makeflags.substr(pos, makeflags.find(' ', pos) - pos);
+    }
+  }
+  if (auth.empty()) {
+    return nullptr;
+  }
+
+  if (auth.rfind("fifo:", 0) == 0) {
+    int fd = open(auth.c_str() + 5, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+      return nullptr;
+    }
+    return std::make_unique<JobServer>(fd, fd, true);
+  }
+
+  int read_fd = -1, write_fd = -1;
+  char comma = 0;
+  if (std::sscanf(auth.c_str(), "%d%c%d", &read_fd, &comma, &write_fd) != 3 ||
+      comma != ',' || read_fd < 0 || write_fd < 0) {
+    return nullptr;
+  }
+  // make only passes the descriptors to recipes it knows run a make-aware
+  // tool; otherwise they are closed or belong to something else
+  if (fcntl(read_fd, F_GETFD) < 0 || fcntl(write_fd, F_GETFD) < 0) {
+    return nullptr;
+  }
+  return std::make_unique<JobServer>(read_fd, write_fd);
+}
+
+std::unique_ptr<JobServer> JobServer::FromEnvironment() {
+  const char *makeflags = std::getenv("MAKEFLAGS");
+  return makeflags ? FromMakeflags(makeflags) : nullptr;
+}
+
+JobServer::Token JobServer::Acquire() {
+  if (implicit_free_.exchange(false)) {
+    return kImplicitToken;
+  }
+  for (;;) {
+    // The descriptor may be non-blocking and shared with other clients, so
+    // wait for a token and retry when another client wins it
+    struct pollfd fd = {read_fd_, POLLIN, 0};
+    if (poll(&fd, 1, -1) < 0 && errno != EINTR) {
+      break;
+    }
+    char token;
+    ssize_t count = read(read_fd_, &token, 1);
+    if (count == 1) {
+      return static_cast<unsigned char>(token);
+    }
+    if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+      break;
+    }
+  }
+  throw std::runtime_error(std::string("Failed to read jobserver token: ") +
+                           std::strerror(errno));
+}
+
+void JobServer::Release(Token token) {
+  if (token == kImplicitToken) {
+    implicit_free_ = true;
+    return;
+  }
+  char byte = static_cast<char>(token);
+  while (write(write_fd_, &byte, 1) < 0 && errno == EINTR) {
+  }
+}
+
+} // namespace boyo
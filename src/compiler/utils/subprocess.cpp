@@ -0,0 +1,168 @@
+#include "utils/subprocess.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+extern char **environ;
+
+namespace boyo {
+
+Subprocess::Subprocess(const std::vector<std::string> &args,
+                       bool capture_output) {
+  if (args.empty()) {
+    throw std::runtime_error("No program to run");
+  }
+
+  int input_pipe[2];
+  int output_pipe[2] = {-1, -1};
+  if (pipe2(input_pipe, O_CLOEXEC) != 0) {
+    throw std::runtime_error(std::string("Failed to create pipe: ") +
+                             std::strerror(errno));
+  }
+  if (capture_output && pipe2(output_pipe, O_CLOEXEC) != 0) {
+    int pipe_error = errno;
+    close(input_pipe[0]);
+    close(input_pipe[1]);
+    throw std::runtime_error(std::string("Failed to create pipe: ") +
+                             std::strerror(pipe_error));
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, input_pipe[0], STDIN_FILENO);
+  if (capture_output) {
+    posix_spawn_file_actions_adddup2(&actions, output_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, output_pipe[1], STDERR_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+  }
+
+  std::vector<char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  int error =
+      posix_spawnp(&pid_, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(input_pipe[0]);
+  if (capture_output) {
+    close(output_pipe[1]);
+  }
+  if (error != 0) {
+    close(input_pipe[1]);
+    if (capture_output) {
+      close(output_pipe[0]);
+    }
+    throw std::runtime_error("Failed to start " + args[0] + ": " +
+                             std::strerror(error));
+  }
+
+  // Writes must not block while the output pipe needs draining
+  input_fd_ = input_pipe[1];
+  fcntl(input_fd_, F_SETFL, fcntl(input_fd_, F_GETFL) | O_NONBLOCK);
+  output_fd_ = output_pipe[0];
+}
+
+Subprocess::~Subprocess() {
+  if (pid_ > 0 && exit_code_ < 0) {
+    Wait();
+  }
+}
+
+bool Subprocess::Write(std::string_view data) {
+  if (input_fd_ < 0) {
+    return false;
+  }
+
+  // A process that exits early must not kill us with SIGPIPE, so block it
+  // on this thread and discard it if it was raised
+  sigset_t sigpipe, previous;
+  sigemptyset(&sigpipe);
+  sigaddset(&sigpipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &sigpipe, &previous);
+
+  bool open = true;
+  while (!data.empty() && open) {
+    struct pollfd fds[2] = {{input_fd_, POLLOUT, 0}, {output_fd_, POLLIN, 0}};
+    int count = output_fd_ >= 0 ? 2 : 1;
+    if (poll(fds, count, -1) < 0) {
+      open = errno == EINTR;
+      continue;
+    }
+    if (count == 2 && fds[1].revents != 0 && !ReadOutput()) {
+      close(output_fd_);
+      output_fd_ = -1;
+    }
+    if (fds[0].revents & (POLLOUT | POLLERR | POLLHUP)) {
+      ssize_t written = write(input_fd_, data.data(), data.size());
+      if (written > 0) {
+        data.remove_prefix(written);
+      } else if (written < 0 && errno != EAGAIN && errno != EINTR) {
+        open = false;
+      }
+    }
+  }
+
+  if (!open) {
+    static const struct timespec kNoWait = {0, 0};
+    sigtimedwait(&sigpipe, nullptr, &kNoWait);
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  return open;
+}
+
+bool Subprocess::ReadOutput() {
+  char buffer[1 << 16];
+  ssize_t count;
+  do {
+    count = read(output_fd_, buffer, sizeof(buffer));
+  } while (count < 0 && errno == EINTR);
+  if (count <= 0) {
+    return false;
+  }
+  output_.append(buffer, count);
+  return true;
+}
+
+int Subprocess::Wait() {
+  if (exit_code_ >= 0) {
+    return exit_code_;
+  }
+  if (input_fd_ >= 0) {
+    close(input_fd_);
+    input_fd_ = -1;
+  }
+  if (output_fd_ >= 0) {
+    // Blocking reads are fine now that stdin is closed
+    while (ReadOutput()) {
+    }
+    close(output_fd_);
+    output_fd_ = -1;
+  }
+
+  int status = 0;
+  while (waitpid(pid_, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (WIFEXITED(status)) {
+    exit_code_ = WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    exit_code_ = 128 + WTERMSIG(status);
+  } else {
+    exit_code_ = 1;
+  }
+  return exit_code_;
+}
+
+} // namespace boyo
@@ -0,0 +1,342 @@
+#include "vm/bytecode.hpp"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+#include "statement/expression.hpp"
+
+namespace boyo {
+
+namespace {
+
+const std::string kBytecodeMagic = "boyo-bytecode-1\n";
+
+// Builds the code of one function, allocating a register per value
+class FunctionBuilder {
+public:
+  FunctionBuilder(Bytecode &bytecode,
+                  const std::map<std::string, uint32_t> &globals,
+                  std::map<uint8_t, uint32_t> &constants)
+      : bytecode_(bytecode), globals_(globals), constants_(constants) {}
+
+  uint32_t Emit(Opcode op, uint32_t b = 0, uint32_t c = 0) {
+    uint32_t a = registers_++;
+    bytecode_.code.push_back({op, a, b, c});
+    return a;
+  }
+
+  void EmitNoResult(Opcode op, uint32_t a = 0) {
+    bytecode_.code.push_back({op, a, 0, 0});
+  }
+
+  // Emit the code of expr; returns the register holding its value
+  uint32_t EmitExpression(const Expression &expr,
+                          const std::vector<std::string> &params,
+                          const std::string &context) {
+    if (auto *op = dynamic_cast<const OperatorExpression *>(&expr)) {
+      Opcode opcode;
+      if (op->GetOperator() == "+") {
+        opcode = Opcode::kAdd;
+      } else if (op->GetOperator() == "-") {
+        opcode = Opcode::kSubtract;
+      } else if (op->GetOperator() == "*") {
+        opcode = Opcode::kMultiply;
+      } else {
+        throw std::runtime_error("Unknown operator: " + op->GetOperator());
+      }
+      uint32_t left = EmitExpression(op->GetLeft(), params, context);
+      uint32_t right = EmitExpression(op->GetRight(), params, context);
+      return Emit(opcode, left, right);
+    }
+    if (auto *literal = dynamic_cast<const HexLiteralExpression *>(&expr)) {
+      uint8_t byte = literal->GetByte();
+      auto it = constants_.find(byte);
+      if (it == constants_.end()) {
+        it = constants_.emplace(byte, bytecode_.constants.size()).first;
+        bytecode_.constants.push_back({byte});
+      }
+      return Emit(Opcode::kLoadConst, it->second);
+    }
+    if (auto *param = dynamic_cast<const ParameterExpression *>(&expr)) {
+      auto it = std::find(params.begin(), params.end(), param->GetParamName());
+      if (it == params.end()) {
+        throw std::runtime_error("Unknown parameter in " + context + ": " +
+                                 param->GetParamName());
+      }
+      return Emit(Opcode::kLoadParam, it - params.begin());
+    }
+    if (auto *identifier = dynamic_cast<const IdentifierExpression *>(&expr)) {
+      auto it = globals_.find(identifier->GetName());
+      if (it == globals_.end()) {
+        throw std::runtime_error("Unknown identifier in " + context + ": " +
+                                 identifier->GetName());
+      }
+      return Emit(Opcode::kLoadGlobal, it->second);
+    }
+    throw std::runtime_error("Unexpected expression in " + context + ": " +
+                             expr.ToString());
+  }
+
+  uint32_t Registers() const { return registers_; }
+
+private:
+  Bytecode &bytecode_;
+  const std::map<std::string, uint32_t> &globals_;
+  std::map<uint8_t, uint32_t> &constants_;
+  uint32_t registers_ = 0;
+};
+
+class ByteWriter {
+public:
+  void U32(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      data_ += static_cast<char>(value >> (8 * i));
+    }
+  }
+  void Bytes(std::string_view bytes) {
+    U32(bytes.size());
+    data_ += bytes;
+  }
+  void Bytes(const std::vector<uint8_t> &bytes) {
+    Bytes(std::string_view(reinterpret_cast<const char *>(bytes.data()),
+                           bytes.size()));
+  }
+  void Function(const BytecodeFunction &function) {
+    Bytes(function.name);
+    U32(function.params);
+    U32(function.registers);
+    U32(function.entry);
+    U32(function.size);
+  }
+
+  std::string Take() { return std::move(data_); }
+
+private:
+  std::string data_;
+};
+
+class ByteReader {
+public:
+  explicit ByteReader(std::string_view data) : data_(data) {}
+
+  uint32_t U32() {
+    Need(4);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      value |= uint32_t{static_cast<uint8_t>(data_[i])} << (8 * i);
+    }
+    data_.remove_prefix(4);
+    return value;
+  }
+  std::string_view Bytes() {
+    uint32_t size = U32();
+    Need(size);
+    std::string_view bytes = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return bytes;
+  }
+  std::vector<uint8_t> ByteVector() {
+    std::string_view bytes = Bytes();
+    return std::vector<uint8_t>(bytes.begin(), bytes.end());
+  }
+  BytecodeFunction Function() {
+    BytecodeFunction function;
+    function.name = Bytes();
+    function.params = U32();
+    function.registers = U32();
+    function.entry = U32();
+    function.size = U32();
+    return function;
+  }
+
+  // Element count of a list whose elements take at least min_size bytes,
+  // checked against the data left so a bad count cannot exhaust memory
+  uint32_t Count(size_t min_size) {
+    uint32_t count = U32();
+    Need(size_t{count} * min_size);
+    return count;
+  }
+
+  void ExpectEnd() const {
+    if (!data_.empty()) {
+      throw std::runtime_error("Trailing data in bytecode");
+    }
+  }
+
+private:
+  void Need(size_t size) const {
+    if (data_.size() < size) {
+      throw std::runtime_error("Truncated bytecode");
+    }
+  }
+
+  std::string_view data_;
+};
+
+} // namespace
+
+Bytecode CompileBytecode(const StatementList &statements) {
+  Bytecode bytecode;
+  std::map<std::string, uint32_t> globals;
+  std::map<uint8_t, uint32_t> constants;
+  std::map<std::pair<std::string, size_t>, uint32_t> functions;
+  std::set<std::string> def_names;
+
+  for (const auto &statement : statements) {
+    if (auto *let_stmt = dynamic_cast<const LetStatement *>(statement.get())) {
+      const std::string &name = let_stmt->GetVarName();
+      if (IsReservedName(name)) {
+        throw std::runtime_error("Reserved name: " + name);
+      }
+      if (globals.count(name) || def_names.count(name)) {
+        throw std::runtime_error("Redefinition of " + name);
+      }
+      const Expression &value = let_stmt->GetValueExpr();
+      if (auto *literal = dynamic_cast<const HexLiteralExpression *>(&value)) {
+        bytecode.globals.push_back({literal->GetByte()});
+      } else if (auto *identifier =
+                     dynamic_cast<const IdentifierExpression *>(&value)) {
+        auto it = globals.find(identifier->GetName());
+        if (it == globals.end()) {
+          throw std::runtime_error("Unknown identifier in let " + name + ": " +
+                                   identifier->GetName());
+        }
+        bytecode.globals.push_back(bytecode.globals[it->second]);
+      } else {
+        throw std::runtime_error("let " + name +
+                                 " must be a literal or another let");
+      }
+      bytecode.global_names.push_back(name);
+      globals[name] = bytecode.globals.size() - 1;
+    } else if (auto *def_stmt =
+                   dynamic_cast<const DefStatement *>(statement.get())) {
+      const std::string &name = def_stmt->GetFuncName();
+      const auto &params = def_stmt->GetParams();
+      if (IsReservedName(name)) {
+        throw std::runtime_error("Reserved name: " + name);
+      }
+      if (globals.count(name) || functions.count({name, params.size()})) {
+        throw std::runtime_error("Redefinition of " + name);
+      }
+      std::set<std::string> distinct(params.begin(), params.end());
+      if (distinct.size() != params.size()) {
+        throw std::runtime_error("Repeated parameter in def " + name);
+      }
+
+      BytecodeFunction function;
+      function.name = name;
+      function.params = params.size();
+      function.entry = bytecode.code.size();
+      FunctionBuilder builder(bytecode, globals, constants);
+      uint32_t result =
+          builder.EmitExpression(def_stmt->GetBodyExpr(), params, "def " + name);
+      builder.EmitNoResult(Opcode::kReturn, result);
+      function.registers = builder.Registers();
+      function.size = bytecode.code.size() - function.entry;
+
+      functions[{name, params.size()}] = bytecode.functions.size();
+      bytecode.functions.push_back(std::move(function));
+      def_names.insert(name);
+    }
+  }
+
+  // main() runs after every let and def is defined. The arguments of a
+  // call are loaded into consecutive registers.
+  bytecode.main.name = "main";
+  bytecode.main.entry = bytecode.code.size();
+  FunctionBuilder builder(bytecode, globals, constants);
+  for (const auto &statement : statements) {
+    auto *main_stmt = dynamic_cast<const MainStatement *>(statement.get());
+    if (!main_stmt) {
+      continue;
+    }
+    const auto &args = main_stmt->GetArgs();
+    auto function = functions.find({main_stmt->GetFuncName(), args.size()});
+    if (function == functions.end()) {
+      throw std::runtime_error("No def " + main_stmt->GetFuncName() +
+                               " taking " + std::to_string(args.size()) +
+                               " arguments");
+    }
+    uint32_t first = builder.Registers();
+    for (const auto &arg : args) {
+      auto it = globals.find(arg);
+      if (it == globals.end()) {
+        throw std::runtime_error("Unknown identifier in main " +
+                                 main_stmt->GetFuncName() + ": " + arg);
+      }
+      builder.Emit(Opcode::kLoadGlobal, it->second);
+    }
+    uint32_t result = builder.Emit(Opcode::kCall, function->second, first);
+    builder.EmitNoResult(Opcode::kPrint, result);
+  }
+  builder.EmitNoResult(Opcode::kHalt);
+  bytecode.main.registers = builder.Registers();
+  bytecode.main.size = bytecode.code.size() - bytecode.main.entry;
+  return bytecode;
+}
+
+std::string EncodeBytecode(const Bytecode &bytecode) {
+  ByteWriter writer;
+  writer.U32(bytecode.globals.size());
+  for (size_t i = 0; i < bytecode.globals.size(); ++i) {
+    writer.Bytes(bytecode.global_names[i]);
+    writer.Bytes(bytecode.globals[i]);
+  }
+  writer.U32(bytecode.constants.size());
+  for (const auto &constant : bytecode.constants) {
+    writer.Bytes(constant);
+  }
+  writer.U32(bytecode.functions.size());
+  for (const auto &function : bytecode.functions) {
+    writer.Function(function);
+  }
+  writer.Function(bytecode.main);
+  writer.U32(bytecode.code.size());
+  for (const auto &instruction : bytecode.code) {
+    writer.U32(static_cast<uint32_t>(instruction.op));
+    writer.U32(instruction.a);
+    writer.U32(instruction.b);
+    writer.U32(instruction.c);
+  }
+  return kBytecodeMagic + writer.Take();
+}
+
+bool IsBytecode(std::string_view data) {
+  return data.substr(0, kBytecodeMagic.size()) == kBytecodeMagic;
+}
+
+Bytecode DecodeBytecode(std::string_view data) {
+  if (!IsBytecode(data)) {
+    throw std::runtime_error("Not Boyo bytecode");
+  }
+  ByteReader reader(data.substr(kBytecodeMagic.size()));
+  Bytecode bytecode;
+  for (uint32_t i = 0, count = reader.Count(8); i < count; ++i) {
+    bytecode.global_names.emplace_back(reader.Bytes());
+    bytecode.globals.push_back(reader.ByteVector());
+  }
+  for (uint32_t i = 0, count = reader.Count(4); i < count; ++i) {
+    bytecode.constants.push_back(reader.ByteVector());
+  }
+  for (uint32_t i = 0, count = reader.Count(20); i < count; ++i) {
+    bytecode.functions.push_back(reader.Function());
+  }
+  bytecode.main = reader.Function();
+  for (uint32_t i = 0, count = reader.Count(16); i < count; ++i) {
+    uint32_t op = reader.U32();
+    if (op > static_cast<uint32_t>(Opcode::kHalt)) {
+      throw std::runtime_error("Unknown opcode in bytecode");
+    }
+    Instruction instruction{static_cast<Opcode>(op)};
+    instruction.a = reader.U32();
+    instruction.b = reader.U32();
+    instruction.c = reader.U32();
+    bytecode.code.push_back(instruction);
+  }
+  reader.ExpectEnd();
+  return bytecode;
+}
+
+} // namespace boyo
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "statement/statement.hpp"
+
+namespace boyo {
+
+/**
+ * Operations of the Boyo register machine. Registers hold byte vectors and
+ * belong to the function being run; loads make a register refer to a value
+ * without copying it.
+ */
+enum class Opcode : uint8_t {
+  kLoadConst,  // r[a] = constants[b]
+  kLoadGlobal, // r[a] = globals[b]
+  kLoadParam,  // r[a] = parameter b
+  kAdd,        // r[a] = r[b] + r[c]
+  kSubtract,   // r[a] = r[b] - r[c]
+  kMultiply,   // r[a] = r[b] * r[c]
+  kCall,       // r[a] = functions[b](r[c], r[c + 1], ...)
+  kPrint,      // print r[a]
+  kReturn,     // return r[a]
+  kHalt,       // end of main
+};
+
+struct Instruction {
+  Opcode op;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint32_t c = 0;
+};
+
+/**
+ * A def, or main: code[entry, entry + size) run with `registers` registers
+ */
+struct BytecodeFunction {
+  std::string name;
+  uint32_t params = 0;
+  uint32_t registers = 0;
+  uint32_t entry = 0;
+  uint32_t size = 0;
+};
+
+/**
+ * A whole program: main calls defs and prints their results; defs only
+ * read their parameters, lets and literals.
+ */
+struct Bytecode {
+  // Lets, with their values before runtime binding
+  std::vector<std::string> global_names;
+  std::vector<std::vector<uint8_t>> globals;
+
+  // Literals of the defs
+  std::vector<std::vector<uint8_t>> constants;
+
+  std::vector<BytecodeFunction> functions;
+  BytecodeFunction main;
+  std::vector<Instruction> code;
+};
+
+/**
+ * Compile parsed statements to bytecode. Each def gets one register per
+ * node of its expression tree.
+ * @throws std::runtime_error for a program g++ would reject (see
+ * Interpreter)
+ */
+Bytecode CompileBytecode(const StatementList &statements);
+
+/**
+ * Serialize bytecode to a self-describing little-endian byte string
+ */
+std::string EncodeBytecode(const Bytecode &bytecode);
+
+/**
+ * Read bytecode written by EncodeBytecode. The result still has to pass
+ * Vm's checks before it runs.
+ * @throws std::runtime_error if data is not bytecode or is truncated
+ */
+Bytecode DecodeBytecode(std::string_view data);
+
+/**
+ * Whether data starts like encoded bytecode
+ */
+bool IsBytecode(std::string_view data);
+
+} // namespace boyo
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vm/bytecode.hpp"
+
+namespace boyo {
+
+/**
+ * Runs bytecode on a register machine with threaded (computed goto)
+ * dispatch. Registers refer to globals, constants and parameters in place,
+ * and a temporary is handed to the next kernel as an rvalue at its last use
+ * so its buffer is reused. Register files are kept per thread, so a call
+ * allocates nothing but its result.
+ */
+class Vm {
+public:
+  /**
+   * @throws std::runtime_error if the bytecode is malformed: an index out
+   * of range, a register read before it is written, or a function that
+   * does not end in its terminator
+   */
+  explicit Vm(Bytecode bytecode);
+
+  /**
+   * Run main: print the result of every main statement to os
+   * @param args NAME=SOURCE bindings of main arguments, as a compiled
+   * program takes them
+   * @throws std::runtime_error for an unknown argument or unreadable input
+   */
+  void Run(std::ostream &os, const std::vector<std::string> &args = {}) const;
+
+  /**
+   * Globals with the main arguments in args bound, as Run binds them
+   * @throws std::runtime_error for an unknown argument or unreadable input
+   */
+  std::vector<std::vector<uint8_t>>
+  BindGlobals(const std::vector<std::string> &args) const;
+
+  /**
+   * Index of the def name taking params arguments, for Call
+   * @throws std::runtime_error if there is none
+   */
+  size_t FindFunction(const std::string &name, size_t params) const;
+
+  /**
+   * Call a def found with FindFunction; thread safe
+   * @param args One pointer per parameter
+   */
+  std::vector<uint8_t> Call(size_t function,
+                            const std::vector<uint8_t> *const *args) const;
+
+  std::vector<uint8_t> Call(const std::string &name,
+                            const std::vector<std::vector<uint8_t>> &args) const;
+
+  const Bytecode &GetBytecode() const { return bytecode_; }
+
+private:
+  // An instruction prepared for dispatch
+  struct Step {
+    Opcode op;
+    uint8_t moves; // kMoveLeft | kMoveRight: operands at their last use
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+  };
+
+  // Check one function and prepare its steps
+  void Prepare(const BytecodeFunction &function, bool is_main);
+
+  std::vector<uint8_t> Execute(const BytecodeFunction &function,
+                               const std::vector<uint8_t> *const *params,
+                               const std::vector<std::vector<uint8_t>> &globals,
+                               std::ostream *os) const;
+
+  Bytecode bytecode_;
+  std::vector<Step> steps_;
+  std::map<std::pair<std::string, size_t>, size_t> function_indices_;
+
+  // Registers and parameters a run needs at most
+  size_t max_registers_ = 0;
+  size_t max_params_ = 0;
+};
+
+} // namespace boyo
@@ -0,0 +1,422 @@
+#include "vm/vm.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+#include "runtime/boyo_runtime.hpp"
+
+namespace boyo {
+
+namespace {
+
+constexpr uint8_t kMoveLeft = 1;
+constexpr uint8_t kMoveRight = 2;
+
+// A register refers to its value: a global, constant or parameter in place,
+// or the result it owns
+struct Register {
+  const std::vector<uint8_t> *value = nullptr;
+  std::vector<uint8_t> owned;
+};
+
+[[noreturn]] void Malformed(const std::string &what) {
+  throw std::runtime_error("Malformed bytecode: " + what);
+}
+
+// Apply a kernel to operands b and c into a, moving operands at their last
+// use so the kernel can reuse their buffers
+template <typename Kernel>
+inline void Apply(Register *r, uint32_t a, uint32_t b, uint32_t c,
+                  uint8_t moves, const Kernel &kernel) {
+  Register &left = r[b];
+  Register &right = r[c];
+  std::vector<uint8_t> result;
+  switch (moves) {
+  case 0:
+    result = kernel(*left.value, *right.value);
+    break;
+  case kMoveLeft:
+    result = kernel(std::move(left.owned), *right.value);
+    break;
+  case kMoveRight:
+    result = kernel(*left.value, std::move(right.owned));
+    break;
+  default:
+    result = kernel(std::move(left.owned), std::move(right.owned));
+    break;
+  }
+  r[a].owned = std::move(result);
+  r[a].value = &r[a].owned;
+}
+
+} // namespace
+
+Vm::Vm(Bytecode bytecode) : bytecode_(std::move(bytecode)) {
+  if (bytecode_.global_names.size() != bytecode_.globals.size()) {
+    Malformed("global names do not match globals");
+  }
+  steps_.resize(bytecode_.code.size());
+  std::vector<bool> covered(bytecode_.code.size());
+  auto claim = [&](const BytecodeFunction &function) {
+    if (function.size == 0 ||
+        uint64_t{function.entry} + function.size > bytecode_.code.size()) {
+      Malformed("code of " + function.name + " out of range");
+    }
+    for (uint32_t i = function.entry; i < function.entry + function.size; ++i) {
+      if (covered[i]) {
+        Malformed("functions share code");
+      }
+      covered[i] = true;
+    }
+  };
+
+  for (size_t i = 0; i < bytecode_.functions.size(); ++i) {
+    const auto &function = bytecode_.functions[i];
+    claim(function);
+    Prepare(function, false);
+    function_indices_[{function.name, function.params}] = i;
+    max_params_ = std::max<size_t>(max_params_, function.params);
+  }
+  claim(bytecode_.main);
+  if (bytecode_.main.params != 0) {
+    Malformed("main takes parameters");
+  }
+  Prepare(bytecode_.main, true);
+
+  size_t max_function_registers = 0;
+  for (const auto &function : bytecode_.functions) {
+    max_function_registers =
+        std::max<size_t>(max_function_registers, function.registers);
+  }
+  max_registers_ = bytecode_.main.registers + max_function_registers;
+}
+
+void Vm::Prepare(const BytecodeFunction &function, bool is_main) {
+  const Instruction *code = bytecode_.code.data() + function.entry;
+  uint32_t size = function.size;
+  auto check_register = [&](uint32_t index) {
+    if (index >= function.registers) {
+      Malformed("register out of range in " + function.name);
+    }
+  };
+
+  // Forward: every register is written before it is read, and which
+  // operands are owned results that may be moved from
+  std::vector<bool> written(function.registers);
+  std::vector<bool> owned(function.registers);
+  std::vector<uint8_t> movable(size);
+  auto read = [&](uint32_t index) {
+    check_register(index);
+    if (!written[index]) {
+      Malformed("register read before it is written in " + function.name);
+    }
+  };
+  for (uint32_t i = 0; i < size; ++i) {
+    const Instruction &instruction = code[i];
+    bool last = i + 1 == size;
+    switch (instruction.op) {
+    case Opcode::kLoadConst:
+      if (instruction.b >= bytecode_.constants.size()) {
+        Malformed("constant out of range");
+      }
+      break;
+    case Opcode::kLoadGlobal:
+      if (instruction.b >= bytecode_.globals.size()) {
+        Malformed("global out of range");
+      }
+      break;
+    case Opcode::kLoadParam:
+      if (is_main || instruction.b >= function.params) {
+        Malformed("parameter out of range in " + function.name);
+      }
+      break;
+    case Opcode::kAdd:
+    case Opcode::kSubtract:
+    case Opcode::kMultiply:
+      read(instruction.b);
+      read(instruction.c);
+      movable[i] = (owned[instruction.b] ? kMoveLeft : 0) |
+                   (owned[instruction.c] ? kMoveRight : 0);
+      break;
+    case Opcode::kCall: {
+      // Defs never call, so calls only go one level deep
+      if (!is_main || instruction.b >= bytecode_.functions.size()) {
+        Malformed("call out of range in " + function.name);
+      }
+      uint64_t params = bytecode_.functions[instruction.b].params;
+      if (instruction.c + params > function.registers) {
+        Malformed("call arguments out of range in " + function.name);
+      }
+      for (uint32_t arg = 0; arg < params; ++arg) {
+        read(instruction.c + arg);
+      }
+      break;
+    }
+    case Opcode::kPrint:
+      if (!is_main) {
+        Malformed("print outside main");
+      }
+      read(instruction.a);
+      break;
+    case Opcode::kReturn:
+      if (is_main || !last) {
+        Malformed(function.name + " returns early");
+      }
+      read(instruction.a);
+      break;
+    case Opcode::kHalt:
+      if (!is_main || !last) {
+        Malformed(function.name + " halts early");
+      }
+      break;
+    }
+    if (last && instruction.op != (is_main ? Opcode::kHalt : Opcode::kReturn)) {
+      Malformed(function.name + " does not end in " +
+                (is_main ? "halt" : "return"));
+    }
+
+    switch (instruction.op) {
+    case Opcode::kLoadConst:
+    case Opcode::kLoadGlobal:
+    case Opcode::kLoadParam:
+      check_register(instruction.a);
+      written[instruction.a] = true;
+      owned[instruction.a] = false;
+      break;
+    case Opcode::kAdd:
+    case Opcode::kSubtract:
+    case Opcode::kMultiply:
+    case Opcode::kCall:
+      check_register(instruction.a);
+      written[instruction.a] = true;
+      owned[instruction.a] = true;
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Backward: an owned operand may be moved from where it is last read
+  std::vector<bool> live(function.registers);
+  for (uint32_t i = size; i-- > 0;) {
+    const Instruction &instruction = code[i];
+    Step &step = steps_[function.entry + i];
+    step = {instruction.op, 0, instruction.a, instruction.b, instruction.c};
+    switch (instruction.op) {
+    case Opcode::kAdd:
+    case Opcode::kSubtract:
+    case Opcode::kMultiply:
+      if (instruction.b != instruction.c) {
+        step.moves = movable[i] & ((live[instruction.b] ? 0 : kMoveLeft) |
+                                   (live[instruction.c] ? 0 : kMoveRight));
+      }
+      live[instruction.a] = false;
+      live[instruction.b] = true;
+      live[instruction.c] = true;
+      break;
+    case Opcode::kLoadConst:
+    case Opcode::kLoadGlobal:
+    case Opcode::kLoadParam:
+      live[instruction.a] = false;
+      break;
+    case Opcode::kCall:
+      live[instruction.a] = false;
+      for (uint32_t arg = 0; arg < bytecode_.functions[instruction.b].params;
+           ++arg) {
+        live[instruction.c + arg] = true;
+      }
+      break;
+    case Opcode::kPrint:
+    case Opcode::kReturn:
+      live[instruction.a] = true;
+      break;
+    case Opcode::kHalt:
+      break;
+    }
+  }
+}
+
+size_t Vm::FindFunction(const std::string &name, size_t params) const {
+  auto it = function_indices_.find({name, params});
+  if (it == function_indices_.end()) {
+    throw std::runtime_error("No def " + name + " taking " +
+                             std::to_string(params) + " arguments");
+  }
+  return it->second;
+}
+
+std::vector<uint8_t> Vm::Execute(const BytecodeFunction &function,
+                                 const std::vector<uint8_t> *const *params,
+                                 const std::vector<std::vector<uint8_t>> &globals,
+                                 std::ostream *os) const {
+  // Sized before any register refers to another, and never resized while
+  // running
+  thread_local std::vector<Register> stack;
+  thread_local std::vector<const std::vector<uint8_t> *> call_args;
+  if (stack.size() < max_registers_) {
+    stack.resize(max_registers_);
+  }
+  if (call_args.size() < max_params_) {
+    call_args.resize(max_params_);
+  }
+
+  const auto &constants = bytecode_.constants;
+  Register *r = stack.data();
+  const std::vector<uint8_t> *const *args = params;
+  const Step *ip = steps_.data() + function.entry;
+
+  // Main's frame while one of its calls runs
+  Register *caller = nullptr;
+  const Step *return_ip = nullptr;
+
+  // Threaded dispatch: every handler jumps straight to the next one, in
+  // Opcode order (a GNU extension, like the rest of the toolchain)
+  static void *const kHandlers[] = {
+      &&load_const, &&load_global, &&load_param, &&add,  &&subtract,
+      &&multiply,   &&call,        &&print,      &&ret,  &&halt};
+#define BOYO_DISPATCH() goto *kHandlers[static_cast<uint8_t>(ip->op)]
+
+  BOYO_DISPATCH();
+
+load_const:
+  r[ip->a].value = &constants[ip->b];
+  ++ip;
+  BOYO_DISPATCH();
+
+load_global:
+  r[ip->a].value = &globals[ip->b];
+  ++ip;
+  BOYO_DISPATCH();
+
+load_param:
+  r[ip->a].value = args[ip->b];
+  ++ip;
+  BOYO_DISPATCH();
+
+add:
+  Apply(r, ip->a, ip->b, ip->c, ip->moves, [](auto &&a, auto &&b) {
+    return add_vectors(std::forward<decltype(a)>(a),
+                       std::forward<decltype(b)>(b));
+  });
+  ++ip;
+  BOYO_DISPATCH();
+
+subtract:
+  Apply(r, ip->a, ip->b, ip->c, ip->moves, [](auto &&a, auto &&b) {
+    return subtract_vectors(std::forward<decltype(a)>(a),
+                            std::forward<decltype(b)>(b));
+  });
+  ++ip;
+  BOYO_DISPATCH();
+
+multiply:
+  Apply(r, ip->a, ip->b, ip->c, ip->moves, [](auto &&a, auto &&b) {
+    return multiply_vectors(std::forward<decltype(a)>(a),
+                            std::forward<decltype(b)>(b));
+  });
+  ++ip;
+  BOYO_DISPATCH();
+
+call: {
+  const BytecodeFunction &callee = bytecode_.functions[ip->b];
+  for (uint32_t i = 0; i < callee.params; ++i) {
+    call_args[i] = r[ip->c + i].value;
+  }
+  caller = r;
+  return_ip = ip;
+  r += function.registers;
+  args = call_args.data();
+  ip = steps_.data() + callee.entry;
+  BOYO_DISPATCH();
+}
+
+print:
+  print_vector(*os, *r[ip->a].value);
+  ++ip;
+  BOYO_DISPATCH();
+
+ret: {
+  // Results the def did not compute are copies, as in generated code
+  Register &result = r[ip->a];
+  std::vector<uint8_t> value = result.value == &result.owned
+                                   ? std::move(result.owned)
+                                   : *result.value;
+  if (!caller) {
+    return value;
+  }
+  Register &out = caller[return_ip->a];
+  out.owned = std::move(value);
+  out.value = &out.owned;
+  r = caller;
+  args = params;
+  ip = return_ip + 1;
+  caller = nullptr;
+  BOYO_DISPATCH();
+}
+
+halt:
+  return {};
+
+#undef BOYO_DISPATCH
+}
+
+std::vector<std::vector<uint8_t>>
+Vm::BindGlobals(const std::vector<std::string> &args) const {
+  // Main arguments are bound exactly as boyo_check_arguments and boyo_bind
+  // bind them in a compiled program
+  std::set<uint32_t> bindable;
+  const auto &main = bytecode_.main;
+  for (uint32_t i = main.entry; i < main.entry + main.size; ++i) {
+    if (bytecode_.code[i].op == Opcode::kLoadGlobal) {
+      bindable.insert(bytecode_.code[i].b);
+    }
+  }
+  std::vector<std::string> argv_storage = {"boyo"};
+  for (const auto &arg : args) {
+    size_t equals = arg.find('=');
+    bool known = false;
+    for (uint32_t global : bindable) {
+      known = known || (equals != std::string::npos &&
+                        arg.compare(0, equals, bytecode_.global_names[global]) == 0);
+    }
+    if (!known) {
+      throw std::runtime_error("unknown argument: " + arg);
+    }
+    argv_storage.push_back(arg);
+  }
+  std::vector<char *> argv;
+  for (auto &arg : argv_storage) {
+    argv.push_back(arg.data());
+  }
+
+  std::vector<std::vector<uint8_t>> globals = bytecode_.globals;
+  for (uint32_t global : bindable) {
+    boyo_bind(static_cast<int>(argv.size()), argv.data(),
+              bytecode_.global_names[global].c_str(), globals[global], false);
+  }
+  return globals;
+}
+
+void Vm::Run(std::ostream &os, const std::vector<std::string> &args) const {
+  Execute(bytecode_.main, nullptr, BindGlobals(args), &os);
+}
+
+std::vector<uint8_t>
+Vm::Call(size_t function, const std::vector<uint8_t> *const *args) const {
+  return Execute(bytecode_.functions.at(function), args, bytecode_.globals,
+                 nullptr);
+}
+
+std::vector<uint8_t>
+Vm::Call(const std::string &name,
+         const std::vector<std::vector<uint8_t>> &args) const {
+  size_t function = FindFunction(name, args.size());
+  std::vector<const std::vector<uint8_t> *> pointers;
+  for (const auto &arg : args) {
+    pointers.push_back(&arg);
+  }
+  return Call(function, pointers.data());
+}
+
+} // namespace boyo
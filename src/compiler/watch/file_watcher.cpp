@@ -0,0 +1,84 @@
+#include "watch/file_watcher.hpp"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace boyo {
+
+FileWatcher::FileWatcher(const std::string &path)
+    : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      name_(std::filesystem::path(path).filename().string()) {
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string("inotify_init1 failed: ") +
+                             std::strerror(errno));
+  }
+  std::string directory = std::filesystem::path(path).parent_path().string();
+  if (directory.empty()) {
+    directory = ".";
+  }
+  // Writes in place end with IN_CLOSE_WRITE; saves through a temporary
+  // file end with IN_MOVED_TO
+  if (inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) <
+      0) {
+    int error = errno;
+    close(fd_);
+    throw std::runtime_error("Cannot watch " + directory + ": " +
+                             std::strerror(error));
+  }
+}
+
+FileWatcher::~FileWatcher() { close(fd_); }
+
+bool FileWatcher::ReadEvents() {
+  alignas(struct inotify_event) char buffer[4096];
+  bool changed = false;
+  for (;;) {
+    ssize_t size = read(fd_, buffer, sizeof(buffer));
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        return changed;
+      }
+      throw std::runtime_error(std::string("Reading inotify events failed: ") +
+                               std::strerror(errno));
+    }
+    for (char *next = buffer; next < buffer + size;) {
+      auto *event = reinterpret_cast<struct inotify_event *>(next);
+      if (event->len > 0 && name_ == event->name) {
+        changed = true;
+      }
+      next += sizeof(struct inotify_event) + event->len;
+    }
+  }
+}
+
+bool FileWatcher::Wait(int timeout_ms, int settle_ms) {
+  struct pollfd fd = {fd_, POLLIN, 0};
+  bool changed = false;
+  while (!changed) {
+    int ready = poll(&fd, 1, timeout_ms);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      return false;
+    }
+    changed = ReadEvents();
+  }
+
+  // Editors may write a file in several steps; wait for them to finish
+  while (poll(&fd, 1, settle_ms) > 0) {
+    ReadEvents();
+  }
+  return true;
+}
+
+} // namespace boyo
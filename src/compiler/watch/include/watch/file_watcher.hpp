@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+namespace boyo {
+
+/**
+ * Waits for a file to be saved, using inotify on its directory so that
+ * editors which save by writing a new file and renaming it over the old one
+ * are seen too.
+ */
+class FileWatcher {
+public:
+  /**
+   * @param path The file to watch (it need not exist yet)
+   * @throws std::runtime_error if inotify cannot watch its directory
+   */
+  explicit FileWatcher(const std::string &path);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  /**
+   * Block until the file is written and closed or renamed into place.
+   * Further events that follow within settle_ms are folded into the same
+   * change, so one save triggers one rebuild.
+   * @param timeout_ms How long to wait, or -1 to wait forever
+   * @param settle_ms Quiet period that ends a burst of events
+   * @return true if the file changed, false on timeout
+   * @throws std::runtime_error if reading inotify events fails
+   */
+  bool Wait(int timeout_ms = -1, int settle_ms = 20);
+
+private:
+  // Read the pending events; true if any of them is about the file
+  bool ReadEvents();
+
+  int fd_;
+  std::string name_;
+};
+
+} // namespace boyo
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+#include "parser/parser.hpp"
+#include "statement/statement.hpp"
+
+namespace boyo {
+
+/**
+ * State kept warm between rebuilds of one program in watch mode: the parsed
+ * statement of every source line, the compiler, and the objects of the last
+ * build (in <output>.objects unless CompileOptions::object_dir is set).
+ * Each edit only reparses the lines that changed, and rebuilds are
+ * incremental (see CompileOptions::incremental), so only the changed
+ * definitions are recompiled.
+ */
+class WatchSession {
+public:
+  /**
+   * @param options Compile options; incremental is always turned on
+   * @param output_file Where each rebuild writes the binary
+   */
+  WatchSession(CompileOptions options, std::string output_file);
+
+  /**
+   * Bring the statements up to date with the new source. Lines whose text
+   * appeared in the previous version keep their statement, wherever they
+   * moved; only the others are parsed. On a parse error the previous state
+   * is kept.
+   * @param lines The whole new source
+   * @return The number of lines parsed
+   * @throws std::runtime_error if a changed line is invalid
+   */
+  size_t Update(const std::vector<std::string> &lines);
+
+  /**
+   * Compile the current statements into the output file
+   * @throws std::runtime_error if the program fails to compile
+   */
+  void Build();
+
+  /**
+   * Rebuild from the file at input_file every time it is saved, forever.
+   * Each rebuild reports the time from the save to the new binary; errors
+   * are reported and the session keeps watching.
+   */
+  [[noreturn]] void Run(const std::string &input_file);
+
+  const StatementList &GetStatements() const { return statements_; }
+
+private:
+  Parser parser_;
+  Compiler compiler_;
+  std::string output_file_;
+
+  // Non-empty source lines, and the statement parsed from each
+  std::vector<std::string> lines_;
+  StatementList statements_;
+};
+
+} // namespace boyo
@@ -0,0 +1,133 @@
+#include "watch/watch_session.hpp"
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "watch/file_watcher.hpp"
+
+namespace boyo {
+
+namespace {
+
+// Wall clock time in milliseconds, comparable with file modification times
+int64_t NowMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return int64_t{now.tv_sec} * 1000 + now.tv_nsec / 1000000;
+}
+
+// When path was last saved, or -1 if it cannot be read
+int64_t ModifiedMs(const std::string &path) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return -1;
+  }
+  return int64_t{info.st_mtim.tv_sec} * 1000 + info.st_mtim.tv_nsec / 1000000;
+}
+
+std::vector<std::string> ReadLines(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Failed to open input file: " + path);
+  }
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+} // namespace
+
+WatchSession::WatchSession(CompileOptions options, std::string output_file)
+    : compiler_([&options, &output_file]() {
+        options.incremental = true;
+        if (options.object_dir.empty()) {
+          options.object_dir = output_file + ".objects";
+        }
+        return options;
+      }()),
+      output_file_(std::move(output_file)) {}
+
+size_t WatchSession::Update(const std::vector<std::string> &lines) {
+  // Previous lines by text, so moved lines are found as well as edited ones
+  std::unordered_map<std::string, std::vector<size_t>> previous;
+  for (size_t i = lines_.size(); i-- > 0;) {
+    previous[lines_[i]].push_back(i);
+  }
+
+  // Parse every new line first, so an invalid one leaves the state alone
+  std::vector<size_t> reused(lines.size(), SIZE_MAX);
+  StatementList parsed(lines.size());
+  size_t parsed_count = 0;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].empty()) {
+      continue;
+    }
+    auto found = previous.find(lines[i]);
+    if (found != previous.end() && !found->second.empty()) {
+      reused[i] = found->second.back();
+      found->second.pop_back();
+      continue;
+    }
+    parsed[i] = parser_.ParseLine(lines[i]);
+    parsed_count++;
+  }
+
+  std::vector<std::string> new_lines;
+  StatementList new_statements;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    auto statement = reused[i] != SIZE_MAX ? std::move(statements_[reused[i]])
+                                           : std::move(parsed[i]);
+    if (statement) {
+      new_lines.push_back(lines[i]);
+      new_statements.push_back(std::move(statement));
+    }
+  }
+  lines_ = std::move(new_lines);
+  statements_ = std::move(new_statements);
+  return parsed_count;
+}
+
+void WatchSession::Build() { compiler_.compile(statements_, output_file_); }
+
+void WatchSession::Run(const std::string &input_file) {
+  FileWatcher watcher(input_file);
+  int64_t saved = NowMs();
+  bool first = true;
+  for (;;) {
+    try {
+      size_t parsed = Update(ReadLines(input_file));
+      Build();
+      std::printf("%s %s in %lld ms (%zu of %zu lines parsed)\n",
+                  first ? "Built" : "Rebuilt", output_file_.c_str(),
+                  static_cast<long long>(NowMs() - saved), parsed,
+                  lines_.size());
+    } catch (const CompileError &e) {
+      std::fprintf(stderr, "Error: %s\n%s", e.what(),
+                   e.FormatDiagnostics().c_str());
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "Error: %s\n", e.what());
+    }
+    first = false;
+    std::printf("Watching %s for changes\n", input_file.c_str());
+    std::fflush(stdout);
+
+    watcher.Wait();
+    // Latency counts from the save itself, not from when it was noticed
+    int64_t noticed = NowMs();
+    saved = ModifiedMs(input_file);
+    if (saved < 0 || saved > noticed) {
+      saved = noticed;
+    }
+  }
+}
+
+} // namespace boyo
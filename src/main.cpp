@@ -1,20 +1,63 @@
+#include <csignal>
 #include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "cache/compile_cache.hpp"
 #include "cli.hpp"
+#include "compiler/compile_files.hpp"
 #include "compiler/compiler.hpp"
+#include "interpreter/interpreter.hpp"
+#include "jit/jit_program.hpp"
 #include "parser/parser.hpp"
+#include "server/compile_server.hpp"
 #include "statement/statement.hpp"
+#include "tiered/tiered_program.hpp"
 #include "utils/code_printer.hpp"
+#include "vm/bytecode.hpp"
+#include "vm/vm.hpp"
+#include "watch/watch_session.hpp"
+
+// Parse the value of a count flag such as --threads. std::stoul would take
+// "-1" as SIZE_MAX and ignore trailing junk, so only plain digits pass.
+static size_t ParseCount(const std::string &flag, const std::string &value) {
+  if (value.empty() ||
+      value.find_first_not_of("0123456789") != std::string::npos) {
+    throw std::runtime_error(flag + " expects a non-negative number: " +
+                             value);
+  }
+  try {
+    return std::stoull(value);
+  } catch (const std::out_of_range &) {
+    throw std::runtime_error(flag + " is out of range: " + value);
+  }
+}
 
 int main(int argc, char *argv[]) {
   cli::CliExecutor executor("boyo", "Boyo compiler");
 
   // Set usage string
-  executor.set_usage("<input.boyo> [-o <output>] [--print-code] [--print-ast]");
+  executor.set_usage("<input.boyo>... [-o <output> | --out-dir <dir> [-j <n>]] "
+                     "[--print-code] [--print-ast] [--threads <n>] "
+                     "[--stream [--chunk-size <bytes>]] "
+                     "[--output-format <hex|raw|raw-prefixed>] [--batch] "
+                     "[--cache [--cache-dir <dir>] [--cache-max-size <MiB>]] "
+                     "[--cache-stats] [--watch] [--server [--socket <path>]] "
+                     "[--emit-bytecode] [--emit-lib]\n"
+                     "       boyo <input.boyo>... --fuse -o <output>\n"
+                     "       boyo exec [--cache] [--opt-level <level>] "
+                     "<input.boyo> [NAME=SOURCE]...\n"
+                     "       boyo serve [--socket <path>] [--workers <n>]\n"
+                     "       boyo run [--vm | --jit [--perf-map] | --tiered "
+                     "[--tier-threshold <calls>] [--opt-level <level>]] "
+                     "<input.boyo | input.boyc> "
+                     "[NAME=SOURCE]...");
 
   // Add output flag
   executor.add_flag("-o,--output", cli::FlagType::MultiArg,
@@ -28,46 +71,449 @@ int main(int argc, char *argv[]) {
   executor.add_flag("--print-ast", cli::FlagType::Boolean,
                     "Print Abstract Syntax Tree (AST) structure", false);
 
+  // Add threads flag
+  executor.add_flag("--threads", cli::FlagType::MultiArg,
+                    "Worker threads for independent main statements "
+                    "(default 1, 0 = all cores)",
+                    false);
+
+  // Add streaming flags
+  executor.add_flag("--stream", cli::FlagType::Boolean,
+                    "Stream main arguments bound at runtime (NAME=- or "
+                    "NAME=@path) through the program in fixed-size chunks",
+                    false);
+  executor.add_flag("--chunk-size", cli::FlagType::MultiArg,
+                    "Bytes per chunk in streaming mode (default 65536)", false);
+
+  // Add output format flag
+  executor.add_flag("--output-format", cli::FlagType::MultiArg,
+                    "How the program writes results: hex (default), raw, or "
+                    "raw-prefixed (uint64 little-endian length before each "
+                    "result); raw output goes to stdout or --output=PATH",
+                    false);
+
+  // Add batch flag
+  executor.add_flag("--batch", cli::FlagType::Boolean,
+                    "Apply the main statement to every record read at runtime "
+                    "(--records=@path or stdin, --record-format=hex|binary) "
+                    "using --threads workers",
+                    false);
+
+  // Add optimization flags
+  executor.add_flag("--opt-level", cli::FlagType::MultiArg,
+                    "Optimization level of the generated program: 0, 1, 2, 3, "
+                    "s, z, g or fast",
+                    false);
+  executor.add_flag("--march", cli::FlagType::MultiArg,
+                    "Target architecture of the generated program (e.g. "
+                    "native)",
+                    false);
+  executor.add_flag("--lto", cli::FlagType::Boolean,
+                    "Build the generated program with link-time optimization",
+                    false);
+  executor.add_flag("--size", cli::FlagType::Boolean,
+                    "Size-optimized profile: -Os, unused sections removed and "
+                    "symbols stripped",
+                    false);
+  executor.add_flag("--pgo", cli::FlagType::MultiArg,
+                    "Profile-guided optimization: program arguments of a "
+                    "training run (e.g. \"A=@train.bin\"); repeatable. "
+                    "Profiles are kept in <output>.pgo",
+                    false);
+
+  // Add library flag
+  executor.add_flag("--emit-lib", cli::FlagType::Boolean,
+                    "Build the defs into a library for C and C++ programs, a "
+                    "static one if -o ends in .a, else a shared object, with "
+                    "a C header next to it",
+                    false);
+
+  // Add translation unit flags
+  executor.add_flag("--units", cli::FlagType::MultiArg,
+                    "Split the program into N translation units compiled in "
+                    "parallel",
+                    false);
+  executor.add_flag("--incremental", cli::FlagType::Boolean,
+                    "Compile each let and def into its own cached object, so "
+                    "rebuilds only recompile what changed",
+                    false);
+  executor.add_flag("-j,--jobs", cli::FlagType::MultiArg,
+                    "Maximum concurrent g++ processes (default: one per core, "
+                    "or the make jobserver's limit); with several input files, "
+                    "files compiled at once",
+                    false);
+  executor.add_flag("--out-dir", cli::FlagType::MultiArg,
+                    "Directory for the binaries of several input files, each "
+                    "named after its input",
+                    false);
+
+  // Add program fusion flag
+  executor.add_flag("--fuse", cli::FlagType::Boolean,
+                    "Compile all input files into one multi-call binary that "
+                    "runs the program named by its first argument or by the "
+                    "name it is invoked as (e.g. a symlink)",
+                    false);
+
+  // Add interpreter flags
+  executor.add_flag("--vm", cli::FlagType::Boolean,
+                    "With run, compile the program to bytecode and run it on "
+                    "the register VM instead of walking its syntax tree",
+                    false);
+  executor.add_flag("--jit", cli::FlagType::Boolean,
+                    "With run, compile the program's defs to x86-64 machine "
+                    "code in memory and run them there",
+                    false);
+  executor.add_flag("--perf-map", cli::FlagType::Boolean,
+                    "With --jit, describe the generated code in "
+                    "/tmp/perf-<pid>.map so perf can name it",
+                    false);
+  executor.add_flag("--tiered", cli::FlagType::Boolean,
+                    "With run, start on the VM and move defs called more than "
+                    "--tier-threshold times to g++-built native code in the "
+                    "background",
+                    false);
+  executor.add_flag("--tier-threshold", cli::FlagType::MultiArg,
+                    "Calls after which --tiered compiles a def (default 1000)",
+                    false);
+  executor.add_flag("--emit-bytecode", cli::FlagType::Boolean,
+                    "Write the program's bytecode to the output file instead "
+                    "of compiling it; `boyo run` runs bytecode files",
+                    false);
+
+  // Add watch flag
+  executor.add_flag("--watch", cli::FlagType::Boolean,
+                    "Rebuild the output incrementally every time the input "
+                    "file is saved",
+                    false);
+
+  // Add compile server flags
+  executor.add_flag("--server", cli::FlagType::Boolean,
+                    "Send the compile to a running `boyo serve` (compiles "
+                    "locally if none is listening)",
+                    false);
+  executor.add_flag("--socket", cli::FlagType::MultiArg,
+                    "Compile server socket (default "
+                    "$XDG_RUNTIME_DIR/boyo.sock)",
+                    false);
+  executor.add_flag("--workers", cli::FlagType::MultiArg,
+                    "Requests `boyo serve` compiles at once (default: one per "
+                    "core)",
+                    false);
+
+  // Add runtime linking flag
+  executor.add_flag("--embed-runtime", cli::FlagType::Boolean,
+                    "Compile the runtime source into the program instead of "
+                    "linking the prebuilt runtime library",
+                    false);
+
+  // Add compile cache flags
+  executor.add_flag("--cache", cli::FlagType::Boolean,
+                    "Reuse binaries from the on-disk compile cache", false);
+  executor.add_flag("--cache-dir", cli::FlagType::MultiArg,
+                    "Compile cache directory (default $XDG_CACHE_HOME/boyo)",
+                    false);
+  executor.add_flag("--cache-max-size", cli::FlagType::MultiArg,
+                    "Compile cache size limit in MiB (default 1024)", false);
+  executor.add_flag("--cache-stats", cli::FlagType::Boolean,
+                    "Print compile cache statistics and exit", false);
+
   // Set handler for command-less mode
   executor.set_handler([](const cli::ParseResult &result) {
+    auto cache_dir_args = result.get_args("--cache-dir");
+    std::string cache_dir = cache_dir_args.empty()
+                                ? boyo::CompileCache::DefaultDirectory().string()
+                                : cache_dir_args[0];
+
+    if (result.has_flag("--cache-stats")) {
+      auto stats = boyo::CompileCache(cache_dir).Stats();
+      uint64_t lookups = stats.hits + stats.misses;
+      std::printf("Cache directory: %s\n", cache_dir.c_str());
+      std::printf("Entries:         %llu\n",
+                  static_cast<unsigned long long>(stats.entries));
+      std::printf("Size:            %.1f MiB\n", stats.bytes / 1048576.0);
+      std::printf("Hits:            %llu\n",
+                  static_cast<unsigned long long>(stats.hits));
+      std::printf("Misses:          %llu\n",
+                  static_cast<unsigned long long>(stats.misses));
+      std::printf("Hit rate:        %.1f%%\n",
+                  lookups ? 100.0 * stats.hits / lookups : 0.0);
+      return 0;
+    }
+
+    auto socket_args = result.get_args("--socket");
+    std::string socket_path = socket_args.empty()
+                                  ? boyo::CompileServer::DefaultSocketPath()
+                                  : socket_args[0];
+
+    if (!result.positional_args.empty() &&
+        result.positional_args[0] == "serve") {
+      try {
+        auto workers_args = result.get_args("--workers");
+        static boyo::CompileServer *running = nullptr;
+        boyo::CompileServer server(
+            socket_path, workers_args.empty()
+                             ? 0
+                             : ParseCount("--workers", workers_args[0]));
+        running = &server;
+        for (int signal_number : {SIGINT, SIGTERM}) {
+          std::signal(signal_number, [](int) { running->Stop(); });
+        }
+        std::printf("Serving compile requests on %s\n", socket_path.c_str());
+        std::fflush(stdout);
+        server.Run();
+        return 0;
+      } catch (const std::exception &e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+      }
+    }
+
+    // Interpret the program directly: no C++ is generated and g++ never
+    // runs. Further arguments bind main arguments like a compiled program's.
+    // Bytecode files run on the VM, or the JIT with --jit.
+    if (!result.positional_args.empty() && result.positional_args[0] == "run") {
+      if (result.positional_args.size() < 2) {
+        std::fprintf(stderr, "Error: No input file specified\n");
+        return 1;
+      }
+      try {
+        std::ifstream in(result.positional_args[1]);
+        if (!in) {
+          throw std::runtime_error("Failed to open input file: " +
+                                   result.positional_args[1]);
+        }
+        std::string source{std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>()};
+        std::vector<std::string> program_args(
+            result.positional_args.begin() + 2, result.positional_args.end());
+        boyo::JitOptions jit_options;
+        jit_options.perf_map = result.has_flag("--perf-map");
+        if (boyo::IsBytecode(source)) {
+          if (result.has_flag("--jit")) {
+            boyo::JitProgram(boyo::DecodeBytecode(source), jit_options)
+                .Run(std::cout, program_args);
+          } else {
+            boyo::Vm(boyo::DecodeBytecode(source)).Run(std::cout, program_args);
+          }
+          return 0;
+        }
+
+        std::vector<std::string> lines;
+        std::istringstream source_lines(source);
+        for (std::string line; std::getline(source_lines, line);) {
+          lines.push_back(line);
+        }
+        auto statements = boyo::Parser().Parse(lines);
+        if (result.has_flag("--tiered")) {
+          boyo::TieredOptions tiered_options;
+          auto threshold_args = result.get_args("--tier-threshold");
+          if (!threshold_args.empty()) {
+            tiered_options.threshold =
+                ParseCount("--tier-threshold", threshold_args[0]);
+          }
+          auto opt_level_args = result.get_args("--opt-level");
+          if (!opt_level_args.empty()) {
+            tiered_options.compile_options.opt_level = opt_level_args[0];
+          }
+          boyo::TieredProgram(std::move(statements), program_args,
+                              tiered_options)
+              .Run(std::cout);
+        } else if (result.has_flag("--jit")) {
+          boyo::JitProgram(boyo::CompileBytecode(statements), jit_options)
+              .Run(std::cout, program_args);
+        } else if (result.has_flag("--vm")) {
+          boyo::Vm(boyo::CompileBytecode(statements))
+              .Run(std::cout, program_args);
+        } else {
+          boyo::Interpreter(statements).Run(std::cout, program_args);
+        }
+        return 0;
+      } catch (const std::exception &e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+      }
+    }
+
+    // Compile into memory and replace boyo with the program; further
+    // arguments are the program's
+    bool exec = !result.positional_args.empty() &&
+                result.positional_args[0] == "exec";
+
     // Get input file (first positional argument)
-    if (result.positional_args.empty()) {
+    if (result.positional_args.size() < (exec ? 2u : 1u)) {
       std::fprintf(stderr, "Error: No input file specified\n");
       return 1;
     }
 
-    const std::string &input_file = result.positional_args[0];
+    const std::string &input_file = result.positional_args[exec ? 1 : 0];
 
     // Check if --print-code flag is set
     bool print_code = result.has_flag("--print-code");
     bool print_ast = result.has_flag("--print-ast");
 
+    // Several inputs, or --out-dir, compile a batch of files, unless they
+    // are fused into one binary
+    bool fuse = result.has_flag("--fuse");
+    auto out_dir_args = result.get_args("--out-dir");
+    bool many_files =
+        !fuse && !exec &&
+        (result.positional_args.size() > 1 || !out_dir_args.empty());
+
     // Get output file (required unless --print-code or --print-ast is used)
     auto output_args = result.get_args("--output");
-    if (!print_code && !print_ast && output_args.empty()) {
-      std::fprintf(stderr,
-                   "Error: Output file not specified (use -o or --output)\n");
+    if (fuse && (output_args.empty() || !out_dir_args.empty() || print_code ||
+                 print_ast)) {
+      std::fprintf(stderr, "Error: --fuse needs -o and cannot be combined "
+                           "with --out-dir, --print-code or --print-ast\n");
       return 1;
     }
-
-    // Read the input file
-    std::ifstream in(input_file);
-    if (!in) {
-      std::fprintf(stderr, "Error: Failed to open input file: %s\n",
-                   input_file.c_str());
+    if (many_files && (!output_args.empty() || print_code || print_ast)) {
+      std::fprintf(stderr, "Error: Several input files need --out-dir and "
+                           "cannot be combined with -o, --print-code or "
+                           "--print-ast\n");
+      return 1;
+    }
+    if (many_files && out_dir_args.empty()) {
+      std::fprintf(stderr, "Error: Output directory not specified (use "
+                           "--out-dir with several input files)\n");
+      return 1;
+    }
+    if (!exec && !many_files && !print_code && !print_ast &&
+        output_args.empty()) {
+      std::fprintf(stderr,
+                   "Error: Output file not specified (use -o or --output)\n");
       return 1;
     }
 
     // Read all lines from the input file
     std::vector<std::string> lines;
-    std::string line;
-    while (std::getline(in, line)) {
-      lines.push_back(line);
+    if (!many_files && !fuse) {
+      std::ifstream in(input_file);
+      if (!in) {
+        std::fprintf(stderr, "Error: Failed to open input file: %s\n",
+                     input_file.c_str());
+        return 1;
+      }
+      std::string line;
+      while (std::getline(in, line)) {
+        lines.push_back(line);
+      }
     }
-    in.close();
 
     try {
-      if (print_ast) {
+      // Collect compile options from flags
+      boyo::CompileOptions options;
+      auto threads_args = result.get_args("--threads");
+      if (!threads_args.empty()) {
+        options.threads = ParseCount("--threads", threads_args[0]);
+      }
+      options.stream = result.has_flag("--stream");
+      auto chunk_size_args = result.get_args("--chunk-size");
+      if (!chunk_size_args.empty()) {
+        options.stream_chunk_size =
+            ParseCount("--chunk-size", chunk_size_args[0]);
+        if (options.stream_chunk_size == 0) {
+          throw std::runtime_error("--chunk-size must be greater than zero");
+        }
+      }
+      options.batch = result.has_flag("--batch");
+      auto opt_level_args = result.get_args("--opt-level");
+      if (!opt_level_args.empty()) {
+        options.opt_level = opt_level_args[0];
+      }
+      auto march_args = result.get_args("--march");
+      if (!march_args.empty()) {
+        options.march = march_args[0];
+      }
+      options.lto = result.has_flag("--lto");
+      options.size_profile = result.has_flag("--size");
+      options.pgo_runs = result.get_args("--pgo");
+      auto units_args = result.get_args("--units");
+      if (!units_args.empty()) {
+        options.translation_units = ParseCount("--units", units_args[0]);
+      }
+      options.incremental = result.has_flag("--incremental");
+      auto jobs_args = result.get_args("--jobs");
+      if (!jobs_args.empty()) {
+        options.jobs = ParseCount("--jobs", jobs_args[0]);
+      }
+      options.link_runtime = !result.has_flag("--embed-runtime");
+      options.use_cache = result.has_flag("--cache");
+      options.cache_dir = cache_dir;
+      auto cache_size_args = result.get_args("--cache-max-size");
+      if (!cache_size_args.empty()) {
+        options.cache_max_bytes =
+            ParseCount("--cache-max-size", cache_size_args[0]) << 20;
+      }
+      auto format_args = result.get_args("--output-format");
+      if (!format_args.empty()) {
+        if (format_args[0] == "hex") {
+          options.output_format = boyo::OutputFormat::kHex;
+        } else if (format_args[0] == "raw") {
+          options.output_format = boyo::OutputFormat::kRaw;
+        } else if (format_args[0] == "raw-prefixed") {
+          options.output_format = boyo::OutputFormat::kRawLengthPrefixed;
+        } else {
+          throw std::runtime_error("Unknown output format: " + format_args[0]);
+        }
+      }
+
+      if (exec) {
+        std::vector<std::string> program_args(
+            result.positional_args.begin() + 2, result.positional_args.end());
+        boyo::Compiler(options).exec(boyo::Parser().Parse(lines),
+                                     program_args);
+      }
+
+      if (fuse) {
+        // Each program is named after its input file
+        boyo::Parser parser;
+        std::vector<boyo::FusedProgram> programs;
+        for (const auto &file : result.positional_args) {
+          std::ifstream in(file);
+          if (!in) {
+            throw std::runtime_error("Failed to open input file: " + file);
+          }
+          std::vector<std::string> file_lines;
+          std::string line;
+          while (std::getline(in, line)) {
+            file_lines.push_back(line);
+          }
+          programs.push_back({std::filesystem::path(file).stem().string(),
+                              parser.Parse(file_lines)});
+        }
+        boyo::Compiler(options).compile(programs, output_args[0]);
+        std::printf("Successfully compiled %zu programs -> %s\n",
+                    programs.size(), output_args[0].c_str());
+        return 0;
+      } else if (many_files) {
+        auto jobs_args = result.get_args("--jobs");
+        auto results = boyo::CompileFiles(
+            result.positional_args, out_dir_args[0], options,
+            jobs_args.empty() ? 0 : ParseCount("--jobs", jobs_args[0]),
+            [](const boyo::FileCompileResult &file) {
+              if (file.success) {
+                std::printf("Compiled %s -> %s (%.2f s)\n",
+                            file.input_file.c_str(), file.output_file.c_str(),
+                            file.seconds);
+              } else {
+                std::printf("Failed %s: %s\n", file.input_file.c_str(),
+                            file.error.c_str());
+                std::fprintf(stderr, "%s",
+                             boyo::CompileError(file.error, file.diagnostics)
+                                 .FormatDiagnostics()
+                                 .c_str());
+              }
+              std::fflush(stdout);
+            });
+        size_t failed = 0;
+        for (const auto &file : results) {
+          failed += file.success ? 0 : 1;
+        }
+        std::printf("%zu of %zu files compiled\n", results.size() - failed,
+                    results.size());
+        return failed == 0 ? 0 : 1;
+      } else if (print_ast) {
         // Parse and print AST structure
         boyo::Parser parser;
         auto statements = parser.Parse(lines);
@@ -116,7 +562,8 @@ int main(int argc, char *argv[]) {
         // Parse and generate code without compiling
         boyo::Parser parser;
         auto statements = parser.Parse(lines);
-        auto program_code = boyo::Compiler::GenerateProgramCode(statements);
+        auto program_code =
+            boyo::Compiler::GenerateProgramCode(statements, options);
         auto full_code = boyo::Compiler::SubstituteGeneratedCode(
             boyo::Compiler::GetMainFunctionSnippet(), program_code);
 
@@ -124,15 +571,72 @@ int main(int argc, char *argv[]) {
         boyo::CodePrinter printer;
         printer.Print(full_code);
         return 0;
+      } else if (result.has_flag("--emit-bytecode")) {
+        boyo::Parser parser;
+        std::string bytecode =
+            boyo::EncodeBytecode(boyo::CompileBytecode(parser.Parse(lines)));
+        std::ofstream out(output_args[0], std::ios::binary);
+        if (!out.write(bytecode.data(), bytecode.size())) {
+          throw std::runtime_error("Failed to write " + output_args[0]);
+        }
+        std::printf("Successfully compiled %s -> %s\n", input_file.c_str(),
+                    output_args[0].c_str());
+        return 0;
+      } else if (result.has_flag("--emit-lib")) {
+        // The header goes next to the library: libk.so -> libk.h
+        std::string header_file =
+            std::filesystem::path(output_args[0]).replace_extension(".h");
+        boyo::Compiler(options).compile_library(boyo::Parser().Parse(lines),
+                                                output_args[0], header_file);
+        std::printf("Successfully compiled %s -> %s, %s\n", input_file.c_str(),
+                    output_args[0].c_str(), header_file.c_str());
+        return 0;
+      } else if (result.has_flag("--watch")) {
+        boyo::WatchSession session(options, output_args[0]);
+        session.Run(input_file);
+      } else if (result.has_flag("--server")) {
+        // Paths are resolved here, as the server has its own working
+        // directory
+        boyo::CompileRequest request;
+        request.lines = std::move(lines);
+        request.output_file = std::filesystem::absolute(output_args[0]);
+        request.options = options;
+        request.options.cache_dir = std::filesystem::absolute(cache_dir);
+        if (!options.object_dir.empty()) {
+          request.options.object_dir =
+              std::filesystem::absolute(options.object_dir);
+        }
+
+        boyo::CompileResponse response;
+        try {
+          response = boyo::CompileClient(socket_path).Compile(request);
+        } catch (const boyo::NoServerError &) {
+          // No server: do the work here
+          response = boyo::CompileServer::Handle(request);
+        }
+        if (!response.success) {
+          std::fprintf(stderr, "Error: %s\n%s", response.error.c_str(),
+                       boyo::CompileError(response.error, response.diagnostics)
+                           .FormatDiagnostics()
+                           .c_str());
+          return 1;
+        }
+        std::printf("Successfully compiled %s -> %s\n", input_file.c_str(),
+                    output_args[0].c_str());
+        return 0;
       } else {
         // Compile the program normally
         const std::string &output_file = output_args[0];
-        boyo::Compiler compiler;
+        boyo::Compiler compiler(options);
         compiler.compile(lines, output_file);
         std::printf("Successfully compiled %s -> %s\n", input_file.c_str(),
                     output_file.c_str());
         return 0;
       }
+    } catch (const boyo::CompileError &e) {
+      std::fprintf(stderr, "Error: %s\n%s", e.what(),
+                   e.FormatDiagnostics().c_str());
+      return 1;
     } catch (const std::exception &e) {
       std::fprintf(stderr, "Error: %s\n", e.what());
       return 1;
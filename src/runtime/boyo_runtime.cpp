@@ -0,0 +1,768 @@
+#include "runtime/boyo_runtime.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The instantiations boyo_kernels.hpp declares extern
+template class std::allocator<uint8_t>;
+template class std::vector<uint8_t>;
+
+namespace {
+
+// "%x " text of every byte value packed into 4 bytes, with its length
+// (2 or 3) in the top byte, so encoding is one table load and store
+struct boyo_hex_table {
+    uint32_t entries[256];
+    boyo_hex_table() {
+        const char* digits = "0123456789abcdef";
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            char text[4] = {0, 0, 0, 0};
+            uint32_t length = 0;
+            if (byte >= 16) {
+                text[length++] = digits[byte >> 4];
+            }
+            text[length++] = digits[byte & 15];
+            text[length++] = ' ';
+            uint32_t packed = 0;
+            std::memcpy(&packed, text, 3);
+            entries[byte] = packed | (length << 24);
+        }
+    }
+};
+
+} // namespace
+
+size_t boyo_encode_hex(const uint8_t* data, size_t size, char* out) {
+    static const boyo_hex_table table;
+    char* cursor = out;
+    for (size_t i = 0; i < size; ++i) {
+        uint32_t entry = table.entries[data[i]];
+        std::memcpy(cursor, &entry, 4);
+        cursor += entry >> 24;
+    }
+    return cursor - out;
+}
+
+void boyo_write(std::ostream& os, const char* text, size_t size) {
+    if (&os == &std::cout) {
+        std::fwrite(text, 1, size, stdout);
+    } else {
+        os.write(text, size);
+    }
+}
+
+void print_bytes(std::ostream& os, const uint8_t* data, size_t size) {
+    constexpr size_t kBytesPerBlock = size_t{1} << 18;
+    static thread_local std::vector<char> buffer(3 * kBytesPerBlock + 1);
+    for (size_t offset = 0; offset < size; offset += kBytesPerBlock) {
+        size_t count = std::min(kBytesPerBlock, size - offset);
+        boyo_write(os, buffer.data(), boyo_encode_hex(data + offset, count, buffer.data()));
+    }
+}
+
+void boyo_end_line(std::ostream& os) {
+    boyo_write(os, "\n", 1);
+    if (&os == &std::cout) {
+        std::fflush(stdout);
+    }
+    os.flush();
+}
+
+void print_vector(std::ostream& os, const std::vector<uint8_t>& vec) {
+    print_bytes(os, vec.data(), vec.size());
+    boyo_end_line(os);
+}
+
+// Vectors at least this many bytes long are split into chunks that are
+// processed by all cores; shorter ones stay on the calling thread. The
+// BOYO_PARALLEL_THRESHOLD environment variable overrides the default.
+#ifndef BOYO_PARALLEL_THRESHOLD
+#define BOYO_PARALLEL_THRESHOLD (size_t{1} << 22)
+#endif
+
+// Bytes per chunk, sized so a chunk of each operand fits in L2
+#ifndef BOYO_CHUNK_SIZE
+#define BOYO_CHUNK_SIZE (size_t{1} << 16)
+#endif
+
+size_t boyo_parallel_threshold() {
+    static const size_t threshold = []() {
+        // Values that are not a plain decimal number keep the default
+        const char* env = std::getenv("BOYO_PARALLEL_THRESHOLD");
+        if (env == nullptr || !std::isdigit(static_cast<unsigned char>(env[0]))) {
+            return BOYO_PARALLEL_THRESHOLD;
+        }
+        char* end = nullptr;
+        errno = 0;
+        unsigned long long value = std::strtoull(env, &end, 10);
+        if (*end != '\0' || errno == ERANGE) {
+            return BOYO_PARALLEL_THRESHOLD;
+        }
+        return static_cast<size_t>(value);
+    }();
+    return threshold;
+}
+
+namespace {
+
+// Apply op to bytes [begin, end); operands shorter than end read as zero
+template <typename Op>
+void boyo_elementwise(const uint8_t* a, size_t a_size, const uint8_t* b, size_t b_size,
+                      uint8_t* out, size_t begin, size_t end, Op op) {
+    size_t common = std::min(std::min(a_size, b_size), end);
+    size_t i = begin;
+    for (; i < common; ++i) {
+        out[i] = op(a[i], b[i]);
+    }
+    for (; i < end; ++i) {
+        out[i] = op(i < a_size ? a[i] : 0, i < b_size ? b[i] : 0);
+    }
+}
+
+// Write op(a, b) into out, which must hold max(a_size, b_size) bytes and
+// may alias either operand
+template <typename Op>
+void boyo_apply_into(const uint8_t* a, size_t a_size, const uint8_t* b, size_t b_size,
+                     uint8_t* out, Op op) {
+    size_t size = std::max(a_size, b_size);
+    if (size < boyo_parallel_threshold()) {
+        boyo_elementwise(a, a_size, b, b_size, out, 0, size, op);
+        return;
+    }
+    size_t chunks = (size + BOYO_CHUNK_SIZE - 1) / BOYO_CHUNK_SIZE;
+    boyo_parallel_for(chunks, 0, [&](size_t chunk) {
+        size_t begin = chunk * BOYO_CHUNK_SIZE;
+        size_t end = std::min(size, begin + BOYO_CHUNK_SIZE);
+        boyo_elementwise(a, a_size, b, b_size, out, begin, end, op);
+    });
+}
+
+template <typename Op>
+std::vector<uint8_t> boyo_apply(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, Op op) {
+    std::vector<uint8_t> result(std::max(a.size(), b.size()));
+    boyo_apply_into(a.data(), a.size(), b.data(), b.size(), result.data(), op);
+    return result;
+}
+
+// Reuse the buffer of a temporary operand as the output when it is large
+// enough, so nested expressions do not allocate per operator
+template <typename Op>
+std::vector<uint8_t> boyo_apply(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b, Op op) {
+    if (a.size() < b.size()) {
+        return boyo_apply(static_cast<const std::vector<uint8_t>&>(a), b, op);
+    }
+    boyo_apply_into(a.data(), a.size(), b.data(), b.size(), a.data(), op);
+    return std::move(a);
+}
+
+template <typename Op>
+std::vector<uint8_t> boyo_apply(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b, Op op) {
+    if (b.size() < a.size()) {
+        return boyo_apply(a, static_cast<const std::vector<uint8_t>&>(b), op);
+    }
+    boyo_apply_into(a.data(), a.size(), b.data(), b.size(), b.data(), op);
+    return std::move(b);
+}
+
+struct boyo_add {
+    uint8_t operator()(uint8_t x, uint8_t y) const { return x + y; }
+};
+struct boyo_subtract {
+    uint8_t operator()(uint8_t x, uint8_t y) const { return x - y; }
+};
+struct boyo_multiply {
+    uint8_t operator()(uint8_t x, uint8_t y) const { return x * y; }
+};
+
+} // namespace
+
+std::vector<uint8_t> add_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    return boyo_apply(a, b, boyo_add{});
+}
+std::vector<uint8_t> add_vectors(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b) {
+    return boyo_apply(std::move(a), b, boyo_add{});
+}
+std::vector<uint8_t> add_vectors(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b) {
+    return boyo_apply(a, std::move(b), boyo_add{});
+}
+std::vector<uint8_t> add_vectors(std::vector<uint8_t>&& a, std::vector<uint8_t>&& b) {
+    return boyo_apply(std::move(a), b, boyo_add{});
+}
+
+std::vector<uint8_t> subtract_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    return boyo_apply(a, b, boyo_subtract{});
+}
+std::vector<uint8_t> subtract_vectors(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b) {
+    return boyo_apply(std::move(a), b, boyo_subtract{});
+}
+std::vector<uint8_t> subtract_vectors(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b) {
+    return boyo_apply(a, std::move(b), boyo_subtract{});
+}
+std::vector<uint8_t> subtract_vectors(std::vector<uint8_t>&& a, std::vector<uint8_t>&& b) {
+    return boyo_apply(std::move(a), b, boyo_subtract{});
+}
+
+std::vector<uint8_t> multiply_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    return boyo_apply(a, b, boyo_multiply{});
+}
+std::vector<uint8_t> multiply_vectors(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b) {
+    return boyo_apply(std::move(a), b, boyo_multiply{});
+}
+std::vector<uint8_t> multiply_vectors(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b) {
+    return boyo_apply(a, std::move(b), boyo_multiply{});
+}
+std::vector<uint8_t> multiply_vectors(std::vector<uint8_t>&& a, std::vector<uint8_t>&& b) {
+    return boyo_apply(std::move(a), b, boyo_multiply{});
+}
+
+const char* boyo_find_binding(int argc, char** argv, const char* name) {
+    size_t length = std::strlen(name);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=') {
+            return argv[i] + length + 1;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<uint8_t> boyo_window(const std::vector<uint8_t>& value, size_t offset, size_t size) {
+    if (offset >= value.size()) {
+        return {};
+    }
+    size_t end = std::min(value.size(), offset + size);
+    return std::vector<uint8_t>(value.begin() + offset, value.begin() + end);
+}
+
+int boyo_hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// With SSE2, 16 digits are validated and decoded into 8 bytes per step
+void boyo_decode_hex(const char* text, size_t length, std::vector<uint8_t>& out) {
+    if (length >= 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text += 2;
+        length -= 2;
+    }
+    out.resize((length + 1) / 2);
+    uint8_t* cursor = out.data();
+    auto digit = [](char c) {
+        int value = boyo_hex_digit(c);
+        if (value < 0) {
+            throw std::runtime_error(std::string("invalid hex digit: ") + c);
+        }
+        return static_cast<uint8_t>(value);
+    };
+    if (length % 2 == 1) {
+        *cursor++ = digit(*text++);
+        --length;
+    }
+#ifdef __SSE2__
+    const __m128i zero_char = _mm_set1_epi8('0');
+    const __m128i letter_base = _mm_set1_epi8('a' - 10);
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    while (length >= 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+        __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+        __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                         _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+        __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                          _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xFFFF) {
+            break;  // Let the scalar loop report the bad digit
+        }
+        __m128i values = _mm_or_si128(_mm_and_si128(is_digit, _mm_sub_epi8(chars, zero_char)),
+                                      _mm_and_si128(is_letter, _mm_sub_epi8(lower, letter_base)));
+        // Each 16-bit lane holds a high nibble in its low byte and the
+        // matching low nibble in its high byte
+        __m128i high = _mm_slli_epi16(_mm_and_si128(values, low_byte), 4);
+        __m128i low = _mm_srli_epi16(values, 8);
+        __m128i bytes = _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(cursor), bytes);
+        text += 16;
+        length -= 16;
+        cursor += 8;
+    }
+#endif
+    for (; length >= 2; text += 2, length -= 2) {
+        *cursor++ = static_cast<uint8_t>(digit(text[0]) << 4 | digit(text[1]));
+    }
+}
+
+std::vector<uint8_t> boyo_decode_hex(const char* text) {
+    std::vector<uint8_t> out;
+    boyo_decode_hex(text, std::strlen(text), out);
+    return out;
+}
+
+std::vector<uint8_t> boyo_read_stdin() {
+    std::vector<uint8_t> out;
+    size_t size = 0;
+    for (;;) {
+        out.resize(std::max<size_t>(size * 2, size_t{1} << 16));
+        ssize_t count = ::read(STDIN_FILENO, out.data() + size, out.size() - size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            throw std::runtime_error(std::string("cannot read stdin: ") + std::strerror(errno));
+        }
+        if (count == 0) {
+            break;
+        }
+        size += count;
+    }
+    out.resize(size);
+    return out;
+}
+
+std::vector<uint8_t> boyo_read_file(const char* path) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error(std::string("cannot open input: ") + path);
+    }
+
+    // A regular file is read straight into a buffer of its size, with one
+    // byte spare so the read that finds the end needs no resize. Files of
+    // unknown size (pipes, devices) grow the buffer as they are read.
+    std::vector<uint8_t> out(S_ISREG(info.st_mode) ? static_cast<size_t>(info.st_size) + 1
+                                                   : size_t{1} << 16);
+    size_t size = 0;
+    for (;;) {
+        if (size == out.size()) {
+            out.resize(size * 2);
+        }
+        ssize_t count = ::read(fd, out.data() + size, out.size() - size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error(std::string("cannot read input: ") + path + ": " +
+                                     std::strerror(error));
+        }
+        if (count == 0) {
+            break;
+        }
+        size += count;
+    }
+    ::close(fd);
+    out.resize(size);
+    return out;
+}
+
+void boyo_bind(int argc, char** argv, const char* name, std::vector<uint8_t>& value,
+               bool streaming) {
+    const char* binding = boyo_find_binding(argc, argv, name);
+    if (binding == nullptr) {
+        return;
+    }
+    if (std::strcmp(binding, "-") == 0) {
+        if (!streaming) {
+            value = boyo_read_stdin();
+        }
+    } else if (binding[0] == '@') {
+        if (!streaming) {
+            value = boyo_read_file(binding + 1);
+        }
+    } else {
+        value = boyo_decode_hex(binding);
+    }
+}
+
+void boyo_check_arguments(int argc, char** argv, std::initializer_list<const char*> names) {
+    for (int i = 1; i < argc; ++i) {
+        const char* equals = std::strchr(argv[i], '=');
+        bool known = false;
+        for (const char* name : names) {
+            size_t length = std::strlen(name);
+            known = known || (equals == argv[i] + length && std::strncmp(argv[i], name, length) == 0);
+        }
+        if (!known) {
+            throw std::runtime_error(std::string("unknown argument: ") + argv[i]);
+        }
+    }
+}
+
+boyo_source::boyo_source(const std::vector<uint8_t>& value, const char* binding) : value_(&value) {
+    if (binding == nullptr) {
+        return;
+    }
+    if (std::strcmp(binding, "-") == 0) {
+        file_ = stdin;
+    } else if (binding[0] == '@') {
+        file_ = std::fopen(binding + 1, "rb");
+        if (file_ == nullptr) {
+            throw std::runtime_error(std::string("cannot open input: ") + (binding + 1));
+        }
+    }
+    // Hex bindings were already applied to the value by boyo_bind
+}
+
+boyo_source::boyo_source(boyo_source&& other) noexcept : value_(other.value_), file_(other.file_) {
+    other.file_ = nullptr;
+}
+
+boyo_source::~boyo_source() {
+    if (file_ != nullptr && file_ != stdin) {
+        std::fclose(file_);
+    }
+}
+
+void boyo_source::read(size_t offset, size_t size, std::vector<uint8_t>& out) {
+    if (file_ == nullptr) {
+        out = boyo_window(*value_, offset, size);
+        return;
+    }
+    out.resize(size);
+    out.resize(std::fread(out.data(), 1, size, file_));
+}
+
+boyo_raw_output::boyo_raw_output(const char* path, bool length_prefixed)
+    : fd_(STDOUT_FILENO), length_prefixed_(length_prefixed) {
+    if (path != nullptr) {
+        fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error(std::string("cannot open output: ") + path);
+        }
+    }
+    struct stat info;
+    pipe_ = ::fstat(fd_, &info) == 0 && S_ISFIFO(info.st_mode);
+#ifdef __linux__
+    if (pipe_) {
+        int capacity = ::fcntl(fd_, F_GETPIPE_SZ);
+        pipe_ = capacity > 0;
+        pipe_capacity_ = pipe_ ? static_cast<size_t>(capacity) : 0;
+    }
+#endif
+    buffer_.reserve(kBufferSize);
+}
+
+boyo_raw_output::~boyo_raw_output() {
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+    }
+    if (fd_ != STDOUT_FILENO) {
+        ::close(fd_);
+    }
+}
+
+void boyo_raw_output::write(std::vector<uint8_t>&& result) {
+    write_length(result.size());
+    if (result.size() < kBufferSize) {
+        append(result.data(), result.size());
+        return;
+    }
+    flush();
+
+    // A pipe holds at most pipe_capacity_ bytes in pages of its own, so
+    // once that much (plus a partly filled page) has been written after a
+    // result, the reader has consumed all of it
+    pinned_.erase(std::remove_if(pinned_.begin(), pinned_.end(),
+                                 [&](const pinned_result& pinned) {
+                                     return pinned.released_at <= written_;
+                                 }),
+                  pinned_.end());
+    if (pipe_ && pinned_.size() < kMaxPinned && splice(result.data(), result.size())) {
+        uint64_t released_at =
+            written_ + pipe_capacity_ + static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        pinned_.push_back({std::move(result), released_at});
+        return;
+    }
+    write_all(result.data(), result.size());
+}
+
+void boyo_raw_output::write(const std::vector<uint8_t>& result) {
+    write_length(result.size());
+    write(result.data(), result.size());
+}
+
+void boyo_raw_output::write(const uint8_t* data, size_t size) {
+    if (size < kBufferSize) {
+        append(data, size);
+        return;
+    }
+    flush();
+    write_all(data, size);
+}
+
+void boyo_raw_output::write_length(uint64_t length) {
+    if (!length_prefixed_) {
+        return;
+    }
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<uint8_t>(length >> (8 * i));
+    }
+    append(bytes, sizeof(bytes));
+}
+
+void boyo_raw_output::append(const uint8_t* data, size_t size) {
+    if (buffer_.size() + size > kBufferSize) {
+        flush();
+    }
+    buffer_.insert(buffer_.end(), data, data + size);
+}
+
+void boyo_raw_output::flush() {
+    write_all(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+void boyo_raw_output::write_all(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd_, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+        }
+        data += written;
+        size -= written;
+        written_ += written;
+    }
+}
+
+bool boyo_raw_output::splice(const uint8_t* data, size_t size) {
+#ifdef __linux__
+    bool started = false;
+    while (size > 0) {
+        struct iovec iov = {const_cast<uint8_t*>(data), size};
+        ssize_t spliced = ::vmsplice(fd_, &iov, 1, 0);
+        if (spliced < 0 && errno == EINTR) {
+            continue;
+        }
+        if (spliced <= 0) {
+            if (!started) {
+                return false;
+            }
+            write_all(data, size);
+            return true;
+        }
+        started = true;
+        data += spliced;
+        size -= spliced;
+        written_ += spliced;
+    }
+    return true;
+#else
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+void boyo_append_result(std::vector<char>& out, const std::vector<uint8_t>& result, int format) {
+    size_t size = out.size();
+    if (format == boyo_format_hex) {
+        out.resize(size + 3 * result.size() + 1);
+        size += boyo_encode_hex(result.data(), result.size(), out.data() + size);
+        out[size++] = '\n';
+        out.resize(size);
+        return;
+    }
+    if (format == boyo_format_raw_prefixed) {
+        for (int i = 0; i < 8; ++i) {
+            out.push_back(static_cast<char>(static_cast<uint64_t>(result.size()) >> (8 * i)));
+        }
+    }
+    out.insert(out.end(), result.begin(), result.end());
+}
+
+namespace {
+
+// Reads blocks of records for batch mode, in either record format
+class boyo_record_reader {
+public:
+    boyo_record_reader(int argc, char** argv, size_t arity) : arity_(arity) {
+        if (arity == 0) {
+            throw std::runtime_error("batch mode needs a main statement with arguments");
+        }
+        const char* records = boyo_find_binding(argc, argv, "--records");
+        if (records != nullptr && std::strcmp(records, "-") != 0) {
+            if (records[0] != '@') {
+                throw std::runtime_error(std::string("--records expects @path or -: ") + records);
+            }
+            file_ = std::fopen(records + 1, "rb");
+            if (file_ == nullptr) {
+                throw std::runtime_error(std::string("cannot open records: ") + (records + 1));
+            }
+        }
+        const char* format = boyo_find_binding(argc, argv, "--record-format");
+        if (format != nullptr && std::strcmp(format, "binary") == 0) {
+            binary_ = true;
+        } else if (format != nullptr && std::strcmp(format, "hex") != 0) {
+            throw std::runtime_error(std::string("unknown record format: ") + format);
+        }
+    }
+    boyo_record_reader(const boyo_record_reader&) = delete;
+    boyo_record_reader& operator=(const boyo_record_reader&) = delete;
+    ~boyo_record_reader() {
+        std::free(line_);
+        if (file_ != stdin) {
+            std::fclose(file_);
+        }
+    }
+
+    bool binary() const { return binary_; }
+
+    // Read up to max_records records into lines (hex) or fields (binary,
+    // arity per record). Returns the number read; 0 at the end of input.
+    size_t read(size_t max_records, std::vector<std::string>& lines,
+                std::vector<std::vector<uint8_t>>& fields) {
+        size_t count = 0;
+        if (!binary_) {
+            for (; count < max_records; ++count) {
+                ssize_t length = ::getline(&line_, &capacity_, file_);
+                if (length < 0) {
+                    break;
+                }
+                while (length > 0 && (line_[length - 1] == '\n' || line_[length - 1] == '\r')) {
+                    --length;
+                }
+                lines[count].assign(line_, length);
+            }
+            return count;
+        }
+        for (; count < max_records; ++count) {
+            for (size_t i = 0; i < arity_; ++i) {
+                uint8_t header[8];
+                size_t got = std::fread(header, 1, sizeof(header), file_);
+                if (got == 0 && i == 0) {
+                    return count;
+                }
+                uint64_t length = 0;
+                for (int b = 7; b >= 0; --b) {
+                    length = length << 8 | header[b];
+                }
+                if (got != sizeof(header)) {
+                    throw std::runtime_error("truncated binary record");
+                }
+                read_field(length, fields[count * arity_ + i]);
+            }
+        }
+        return count;
+    }
+
+private:
+    // Read a field of length bytes. The length comes from the input, so the
+    // field grows a piece at a time as bytes arrive: a corrupt length ends
+    // in a truncated record rather than a huge allocation.
+    void read_field(uint64_t length, std::vector<uint8_t>& field) {
+        constexpr size_t kPieceSize = size_t{1} << 20;
+        field.clear();
+        while (field.size() < length) {
+            size_t size = field.size();
+            size_t piece = static_cast<size_t>(std::min<uint64_t>(kPieceSize, length - size));
+            field.resize(size + piece);
+            if (std::fread(field.data() + size, 1, piece, file_) != piece) {
+                throw std::runtime_error("truncated binary record");
+            }
+        }
+    }
+
+    size_t arity_;
+    FILE* file_ = stdin;
+    bool binary_ = false;
+    char* line_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+} // namespace
+
+// Records are processed in blocks; each block is split into slices that
+// workers decode into per-thread scratch buffers and encode into per-slice
+// output, which is then written out in order.
+void boyo_run_batch(int argc, char** argv, size_t threads, int format,
+                    std::initializer_list<const std::vector<uint8_t>*> defaults, boyo_batch_call call) {
+    constexpr size_t kBlockRecords = size_t{1} << 14;
+    const size_t arity = defaults.size();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const size_t slices = threads * 4;
+
+    boyo_record_reader reader(argc, argv, arity);
+    boyo_raw_output output(boyo_find_binding(argc, argv, "--output"), false);
+    std::vector<std::string> lines(reader.binary() ? 0 : kBlockRecords);
+    std::vector<std::vector<uint8_t>> fields(reader.binary() ? kBlockRecords * arity : 0);
+    std::vector<std::vector<char>> slice_output(slices);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (;;) {
+        size_t count = reader.read(kBlockRecords, lines, fields);
+        if (count == 0) {
+            break;
+        }
+        boyo_parallel_for(slices, threads, [&](size_t slice) {
+            static thread_local std::vector<std::vector<uint8_t>> scratch;
+            scratch.resize(arity);
+            std::vector<const std::vector<uint8_t>*> args(defaults);
+            auto& text = slice_output[slice];
+            text.clear();
+            size_t end = count * (slice + 1) / slices;
+            for (size_t record = count * slice / slices; record < end; ++record) {
+                if (reader.binary()) {
+                    for (size_t i = 0; i < arity; ++i) {
+                        args[i] = &fields[record * arity + i];
+                    }
+                } else {
+                    const std::string& line = lines[record];
+                    size_t field = 0;
+                    for (size_t pos = line.find_first_not_of(" \t"); pos != std::string::npos;
+                         pos = line.find_first_not_of(" \t", pos)) {
+                        size_t stop = std::min(line.find_first_of(" \t", pos), line.size());
+                        if (field == arity) {
+                            throw std::runtime_error("record " + std::to_string(total + record + 1) +
+                                                     " has more than " + std::to_string(arity) +
+                                                     " fields");
+                        }
+                        boyo_decode_hex(line.data() + pos, stop - pos, scratch[field]);
+                        args[field] = &scratch[field];
+                        ++field;
+                        pos = stop;
+                    }
+                    std::copy(defaults.begin() + field, defaults.end(), args.begin() + field);
+                }
+                boyo_append_result(text, call(args.data()), format);
+            }
+        });
+        for (const auto& text : slice_output) {
+            output.write(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        }
+        total += count;
+    }
+    output.end();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::fprintf(stderr, "boyo: %zu records in %.3f s (%.0f records/s)\n", total,
+                 elapsed.count(), elapsed.count() > 0 ? total / elapsed.count() : 0.0);
+}
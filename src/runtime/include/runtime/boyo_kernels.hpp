@@ -0,0 +1,35 @@
+#pragma once
+
+// Vector operations called by the definitions of generated programs. Kept
+// apart from boyo_runtime.hpp so translation units that only hold lets and
+// defs include just this and <vector>, which compiles several times faster.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Instantiated once in the runtime, so the objects of lets and defs do not
+// each carry their own copies for the linker to merge
+extern template class std::allocator<uint8_t>;
+extern template class std::vector<uint8_t>;
+
+// Helper functions for vector operations. Results are as long as the longer
+// operand, whose missing bytes read as zero; the buffer of a temporary
+// operand is reused for the result when it is large enough.
+std::vector<uint8_t> add_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b);
+std::vector<uint8_t> add_vectors(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b);
+std::vector<uint8_t> add_vectors(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b);
+std::vector<uint8_t> add_vectors(std::vector<uint8_t>&& a, std::vector<uint8_t>&& b);
+
+std::vector<uint8_t> subtract_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b);
+std::vector<uint8_t> subtract_vectors(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b);
+std::vector<uint8_t> subtract_vectors(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b);
+std::vector<uint8_t> subtract_vectors(std::vector<uint8_t>&& a, std::vector<uint8_t>&& b);
+
+std::vector<uint8_t> multiply_vectors(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b);
+std::vector<uint8_t> multiply_vectors(std::vector<uint8_t>&& a, const std::vector<uint8_t>& b);
+std::vector<uint8_t> multiply_vectors(const std::vector<uint8_t>& a, std::vector<uint8_t>&& b);
+std::vector<uint8_t> multiply_vectors(std::vector<uint8_t>&& a, std::vector<uint8_t>&& b);
+
+// Bytes [offset, offset + size) of value, clipped to its length
+std::vector<uint8_t> boyo_window(const std::vector<uint8_t>& value, size_t offset, size_t size);
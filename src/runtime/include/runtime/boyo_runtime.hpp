@@ -0,0 +1,307 @@
+#pragma once
+
+// Runtime support for programs generated by the boyo compiler. The compiler
+// links generated programs against the prebuilt boyo_runtime library and
+// includes this header (precompiled when possible); when the library is not
+// available, this header and boyo_runtime.cpp are embedded into the program
+// source instead.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "runtime/boyo_kernels.hpp"
+
+// Encode size bytes as "%x " text into out, which needs 3 * size + 1 bytes
+// of room. Returns the number of characters written.
+size_t boyo_encode_hex(const uint8_t* data, size_t size, char* out);
+
+// Write text to os; std::cout goes straight to stdio in one call
+void boyo_write(std::ostream& os, const char* text, size_t size);
+
+// Helper function to print bytes without the trailing newline. Bytes are
+// encoded into a large buffer and written out in blocks.
+void print_bytes(std::ostream& os, const uint8_t* data, size_t size);
+
+// End the printed line and flush, like std::endl
+void boyo_end_line(std::ostream& os);
+
+// Helper function to print vectors
+void print_vector(std::ostream& os, const std::vector<uint8_t>& vec);
+
+// Whether this thread is running a task of a parallel boyo_parallel_for
+inline thread_local bool boyo_in_parallel_task = false;
+
+// Run task(0) .. task(count - 1) on a pool of worker threads. Tasks are
+// claimed in index order; the first exception thrown is rethrown here.
+// Inside a task of another parallel loop the tasks run inline, since its
+// pool already occupies the threads asked for.
+template <typename Task>
+void boyo_parallel_for(size_t count, size_t threads, const Task& task) {
+    if (boyo_in_parallel_task) {
+        threads = 1;
+    } else if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        boyo_in_parallel_task = true;
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    boyo_in_parallel_task = false;
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Vectors at least this many bytes long are processed by all cores
+size_t boyo_parallel_threshold();
+
+// Find the NAME=SOURCE program argument binding name, if any
+const char* boyo_find_binding(int argc, char** argv, const char* name);
+
+// Value of one hex digit, or -1 if c is not one
+int boyo_hex_digit(char c);
+
+// Decode a hex string (optional 0x prefix) into bytes, most significant
+// first; an odd digit count reads as a leading zero nibble
+void boyo_decode_hex(const char* text, size_t length, std::vector<uint8_t>& out);
+std::vector<uint8_t> boyo_decode_hex(const char* text);
+
+// Read all of stdin
+std::vector<uint8_t> boyo_read_stdin();
+
+// Read a whole file
+std::vector<uint8_t> boyo_read_file(const char* path);
+
+// Replace value with its NAME=SOURCE program argument, if given: a hex
+// string (0x1234), @path for a file, or - for stdin. When streaming,
+// files and stdin are left for boyo_source to read chunk by chunk.
+void boyo_bind(int argc, char** argv, const char* name, std::vector<uint8_t>& value,
+               bool streaming);
+
+// Reject program arguments that are not NAME=SOURCE for a known name, so
+// a misspelt binding is not silently ignored
+void boyo_check_arguments(int argc, char** argv, std::initializer_list<const char*> names);
+
+// Input to a streamed main argument: either a compiled-in value or a
+// stream bound at runtime with NAME=- (stdin) or NAME=@path (file, pipe)
+class boyo_source {
+public:
+    boyo_source(const std::vector<uint8_t>& value, const char* binding);
+    boyo_source(boyo_source&& other) noexcept;
+    boyo_source(const boyo_source&) = delete;
+    boyo_source& operator=(const boyo_source&) = delete;
+    ~boyo_source();
+
+    // Read the chunk at offset; chunks must be read in order. The chunk is
+    // shorter than size only once the input is exhausted.
+    void read(size_t offset, size_t size, std::vector<uint8_t>& out);
+
+private:
+    const std::vector<uint8_t>* value_;
+    FILE* file_ = nullptr;
+};
+
+// Sink for streamed result chunks that prints them as hex text
+struct boyo_hex_sink {
+    std::ostream& os;
+    void write(const uint8_t* data, size_t size) { print_bytes(os, data, size); }
+    void end() { boyo_end_line(os); }
+};
+
+// Raw binary output of results to stdout or a file named at runtime with
+// --output=PATH, each optionally preceded by its length as a little-endian
+// uint64. Small results are gathered into a large buffer; large ones are
+// written straight from their own memory and, when the output is a pipe,
+// handed to the kernel with vmsplice instead of being copied.
+class boyo_raw_output {
+public:
+    boyo_raw_output(const char* path, bool length_prefixed);
+    boyo_raw_output(const boyo_raw_output&) = delete;
+    boyo_raw_output& operator=(const boyo_raw_output&) = delete;
+    ~boyo_raw_output();
+
+    // Write a whole result. Spliced pages must not change until the reader
+    // has consumed them, so the result is kept until a pipe's worth of
+    // later output has been written.
+    void write(std::vector<uint8_t>&& result);
+
+    void write(const std::vector<uint8_t>& result);
+
+    // Write a streamed chunk; its memory is reused so it is never spliced
+    void write(const uint8_t* data, size_t size);
+
+    void end() { flush(); }
+
+private:
+    static constexpr size_t kBufferSize = size_t{1} << 20;
+
+    // Spliced results not yet known to be consumed; once this many are
+    // held, results are written instead
+    static constexpr size_t kMaxPinned = 4;
+
+    struct pinned_result {
+        std::vector<uint8_t> data;
+        // Output position past which the pipe no longer holds its pages
+        uint64_t released_at;
+    };
+
+    void write_length(uint64_t length);
+    void append(const uint8_t* data, size_t size);
+    void flush();
+    void write_all(const uint8_t* data, size_t size);
+
+    // Returns false if nothing was spliced and the caller should write()
+    bool splice(const uint8_t* data, size_t size);
+
+    int fd_;
+    bool pipe_ = false;
+    bool length_prefixed_;
+    std::vector<uint8_t> buffer_;
+    uint64_t written_ = 0;
+    size_t pipe_capacity_ = 0;
+    std::vector<pinned_result> pinned_;
+};
+
+// Evaluate body chunk by chunk, writing each result chunk to sink as soon
+// as it is ready. A reader thread fills the next chunk while the current
+// one is computed, handing chunks over through two slots, so memory stays
+// bounded by a few chunks whatever the input size.
+template <typename Sink, typename Body>
+void boyo_stream(Sink&& sink, std::vector<boyo_source>& sources, size_t chunk_size,
+                 const Body& body) {
+    std::vector<std::vector<uint8_t>> slots[2] = {
+        std::vector<std::vector<uint8_t>>(sources.size()),
+        std::vector<std::vector<uint8_t>>(sources.size())};
+    bool full[2] = {false, false};
+    bool stop = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    // Chunk n goes to slot n % 2 once the body is done with chunk n - 2
+    std::thread reader([&]() {
+        for (size_t index = 0;; ++index) {
+            size_t slot = index % 2;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return stop || !full[slot]; });
+                if (stop) {
+                    return;
+                }
+            }
+            std::exception_ptr read_error;
+            try {
+                for (size_t i = 0; i < sources.size(); ++i) {
+                    sources[i].read(index * chunk_size, chunk_size, slots[slot][i]);
+                }
+            } catch (...) {
+                read_error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                full[slot] = true;
+                error = read_error;
+            }
+            changed.notify_all();
+            if (read_error) {
+                return;
+            }
+        }
+    });
+    auto finish = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        reader.join();
+    };
+
+    try {
+        for (size_t index = 0;; ++index) {
+            size_t slot = index % 2;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return full[slot]; });
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+            auto result = body(index * chunk_size, chunk_size, slots[slot]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                full[slot] = false;
+            }
+            changed.notify_all();
+            if (result.empty()) {
+                break;
+            }
+            sink.write(result.data(), result.size());
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+    sink.end();
+}
+
+// Result encodings used by batch mode
+enum boyo_format { boyo_format_hex, boyo_format_raw, boyo_format_raw_prefixed };
+
+// Append result to out in the given encoding; hex results end the line
+void boyo_append_result(std::vector<char>& out, const std::vector<uint8_t>& result, int format);
+
+// The main function applied to one record in batch mode
+using boyo_batch_call = std::vector<uint8_t> (*)(const std::vector<uint8_t>* const* args);
+
+// Batch mode: apply call to every record read from --records=@path (stdin
+// by default) on a pool of worker threads and write the results in input
+// order. With --record-format=hex (default) each line is a record of
+// whitespace separated hex fields; fields left out keep the main argument's
+// value. With --record-format=binary a record is one field per main
+// argument, each a little-endian uint64 length followed by that many bytes.
+// Throughput is reported on stderr.
+void boyo_run_batch(int argc, char** argv, size_t threads, int format,
+                    std::initializer_list<const std::vector<uint8_t>*> defaults, boyo_batch_call call);
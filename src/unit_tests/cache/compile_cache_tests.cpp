@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "cache/compile_cache.hpp"
+
+namespace boyo {
+namespace {
+
+namespace fs = std::filesystem;
+
+class CompileCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    directory = fs::temp_directory_path() /
+                ("boyo_cache_test_" + std::to_string(::getpid()));
+    fs::remove_all(directory);
+  }
+
+  void TearDown() override { fs::remove_all(directory); }
+
+  // Write a fake binary of the given size
+  std::string MakeBinary(const std::string &name, size_t size) {
+    fs::create_directories(directory);
+    auto path = (directory / name).string();
+    std::ofstream(path, std::ios::binary) << std::string(size, 'x');
+    return path;
+  }
+
+  fs::path directory;
+};
+
+TEST_F(CompileCacheTest, Key_DependsOnEveryInput) {
+  auto key = CompileCache::Key("int main() {}", "/usr/bin/g++", "g++ 12",
+                               {"-std=c++17"});
+  EXPECT_EQ(key.size(), 64);
+  EXPECT_EQ(key, CompileCache::Key("int main() {}", "/usr/bin/g++", "g++ 12",
+                                   {"-std=c++17"}));
+  EXPECT_NE(key, CompileCache::Key("int main() { }", "/usr/bin/g++", "g++ 12",
+                                   {"-std=c++17"}));
+  EXPECT_NE(key, CompileCache::Key("int main() {}", "/usr/bin/g++", "g++ 13",
+                                   {"-std=c++17"}));
+  EXPECT_NE(key, CompileCache::Key("int main() {}", "/usr/bin/g++", "g++ 12",
+                                   {"-std=c++17", "-O2"}));
+}
+
+TEST_F(CompileCacheTest, FetchAfterStore_Hits) {
+  CompileCache cache(directory / "cache");
+  auto binary = MakeBinary("built", 100);
+  auto output = (directory / "output").string();
+
+  EXPECT_FALSE(cache.Fetch("ab12", output));
+  cache.Store("ab12", binary);
+  EXPECT_TRUE(cache.Fetch("ab12", output));
+  EXPECT_EQ(fs::file_size(output), 100);
+
+  auto stats = cache.Stats();
+  EXPECT_EQ(stats.entries, 1);
+  EXPECT_EQ(stats.bytes, 100);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+TEST_F(CompileCacheTest, Store_EvictsLeastRecentlyUsed) {
+  CompileCache cache(directory / "cache", 250);
+  auto binary = MakeBinary("built", 100);
+  auto output = (directory / "output").string();
+
+  cache.Store("aa01", binary);
+  cache.Store("bb02", binary);
+  // Make aa01 the most recently used entry
+  fs::last_write_time(cache.EntryPath("bb02"),
+                      fs::last_write_time(cache.EntryPath("aa01")) -
+                          std::chrono::hours(1));
+  cache.Store("cc03", binary);
+
+  EXPECT_TRUE(fs::exists(cache.EntryPath("aa01")));
+  EXPECT_FALSE(fs::exists(cache.EntryPath("bb02")));
+  EXPECT_TRUE(fs::exists(cache.EntryPath("cc03")));
+  EXPECT_EQ(cache.Stats().bytes, 200);
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "compiler/compile_files.hpp"
+#include "test_utils.hpp"
+
+namespace boyo {
+namespace {
+
+class CompileFilesTest : public ::testing::Test {
+protected:
+  void SetUp() override { std::filesystem::create_directories(directory); }
+  void TearDown() override { std::filesystem::remove_all(directory); }
+
+  std::string Write(const std::string &name, const std::string &source) {
+    std::string path = directory + "/" + name;
+    std::ofstream(path) << source;
+    return path;
+  }
+
+  const std::string directory = "test_compile_files";
+};
+
+TEST_F(CompileFilesTest, CompileFiles_ReportsEveryFile) {
+  std::vector<std::string> inputs = {
+      Write("double.boyo", "let X 0x07\ndef f _a => + _a _a\nmain f X\n"),
+      Write("broken.boyo", "let X 0x07\ndef f _a => + _a Y\nmain f X\n"),
+      directory + "/missing.boyo",
+      Write("square.boyo", "let X 0x07\ndef f _a => * _a _a\nmain f X\n")};
+
+  std::vector<std::string> reported;
+  auto results = CompileFiles(inputs, directory + "/out", {}, 2,
+                              [&](const FileCompileResult &result) {
+                                reported.push_back(result.input_file);
+                              });
+
+  ASSERT_EQ(results.size(), 4);
+  EXPECT_EQ(reported.size(), 4);
+  EXPECT_TRUE(results[0].success);
+  EXPECT_FALSE(results[1].success);
+  EXPECT_NE(results[1].diagnostics.find("'Y' was not declared"),
+            std::string::npos);
+  EXPECT_FALSE(results[2].success);
+  EXPECT_TRUE(results[3].success);
+
+  // One failure does not stop the others
+  EXPECT_EQ(results[3].output_file, directory + "/out/square");
+  EXPECT_EQ(RunProgram("./" + results[0].output_file), "e \n");
+  EXPECT_EQ(RunProgram("./" + results[3].output_file), "31 \n");
+}
+
+TEST_F(CompileFilesTest, CompileFiles_RejectsCollidingOutputs) {
+  std::filesystem::create_directories(directory + "/other");
+  std::vector<std::string> inputs = {Write("a.boyo", "let X 0x01\n"),
+                                     Write("other/a.boyo", "let X 0x02\n")};
+  EXPECT_THROW(CompileFiles(inputs, directory + "/out", {}, 1),
+               std::runtime_error);
+}
+
+} // namespace
+} // namespace boyo
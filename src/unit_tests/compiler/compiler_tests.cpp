@@ -1,10 +1,21 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cache/compile_cache.hpp"
 #include "compiler/compiler.hpp"
 #include "parser/parser.hpp"
+#include "test_utils.hpp"
 
 namespace boyo {
 namespace {
@@ -16,6 +27,11 @@ protected:
   std::unique_ptr<Compiler> compiler;
 };
 
+const std::vector<std::string> kMultiMainProgram = {
+    "let X 0x07", "let Y 0x03", "def sum _a _b => + _a _b",
+    "def scale _a => * 0x02 _a", "main sum X Y", "main scale X",
+    "main sum Y Y"};
+
 TEST_F(CompilerTest, TestGenerateProgramCode_SimpleLetStatement) {
   std::vector<std::string> lines = {"let A 0x10"};
   auto statements = Parser().Parse(lines);
@@ -64,6 +80,665 @@ TEST_F(CompilerTest, TestSubstituteGeneratedCode_SubstitutesGeneratedCode) {
   EXPECT_TRUE(substituted_code.find("{boyo_program_end}") == std::string::npos);
 }
 
+TEST_F(CompilerTest, TestGenerateProgramCode_MultipleMainsAreScoped) {
+  auto statements = Parser().Parse(kMultiMainProgram);
+  auto program_code = Compiler::GenerateProgramCode(statements);
+
+  EXPECT_TRUE(program_code.find("{\nauto result = sum(X, Y);\n") !=
+              std::string::npos);
+  EXPECT_TRUE(program_code.find("{\nauto result = scale(X);\n") !=
+              std::string::npos);
+}
+
+TEST_F(CompilerTest, TestGenerateProgramCode_ParallelMains) {
+  auto statements = Parser().Parse(kMultiMainProgram);
+  CompileOptions options;
+  options.threads = 4;
+  auto program_code = Compiler::GenerateProgramCode(statements, options);
+
+  EXPECT_TRUE(program_code.find("boyo_parallel_for(3, 4,") !=
+              std::string::npos);
+  EXPECT_TRUE(program_code.find("boyo_result_1 = scale(X);") !=
+              std::string::npos);
+  EXPECT_TRUE(program_code.find("auto result") == std::string::npos);
+  // Results are printed in source order
+  EXPECT_LT(program_code.find("print_vector(std::cout, boyo_result_0)"),
+            program_code.find("print_vector(std::cout, boyo_result_2)"));
+}
+
+TEST_F(CompilerTest, Compile_ParallelOutputMatchesSequential) {
+  compiler->compile(kMultiMainProgram, "test_program_sequential");
+
+  CompileOptions options;
+  options.threads = 3;
+  Compiler(options).compile(kMultiMainProgram, "test_program_parallel");
+
+  auto sequential = RunProgram("./test_program_sequential");
+  EXPECT_EQ(sequential, "a \ne \n6 \n");
+  EXPECT_EQ(RunProgram("./test_program_parallel"), sequential);
+}
+
+TEST_F(CompilerTest, Compile_EmbeddedRuntimeMatchesLinked) {
+  ASSERT_TRUE(Compiler::RuntimeLibraryAvailable());
+  compiler->compile(kMultiMainProgram, "test_program_linked");
+
+  CompileOptions options;
+  options.link_runtime = false;
+  Compiler(options).compile(kMultiMainProgram, "test_program_embedded");
+
+  EXPECT_EQ(RunProgram("./test_program_linked"), "a \ne \n6 \n");
+  EXPECT_EQ(RunProgram("./test_program_embedded"),
+            RunProgram("./test_program_linked"));
+}
+
+TEST_F(CompilerTest, GetCompilerFlags_BuildsOptimizationFlags) {
+  CompileOptions options;
+  EXPECT_EQ(Compiler::GetCompilerFlags(options),
+            (std::vector<std::string>{"-std=c++17", "-pthread"}));
+
+  options.opt_level = "3";
+  options.march = "native";
+  options.lto = true;
+  EXPECT_EQ(Compiler::GetCompilerFlags(options),
+            (std::vector<std::string>{"-std=c++17", "-pthread", "-O3",
+                                      "-march=native", "-flto"}));
+
+  CompileOptions size;
+  size.size_profile = true;
+  EXPECT_EQ(Compiler::GetCompilerFlags(size),
+            (std::vector<std::string>{"-std=c++17", "-pthread", "-Os",
+                                      "-ffunction-sections", "-fdata-sections",
+                                      "-Wl,--gc-sections", "-s"}));
+
+  // PGO needs optimization to use the profile
+  CompileOptions pgo;
+  pgo.pgo_runs = {"A=0x01"};
+  EXPECT_EQ(Compiler::GetCompilerFlags(pgo).back(), "-O2");
+}
+
+TEST_F(CompilerTest, GetCompilerFlags_RejectsInvalidValues) {
+  CompileOptions options;
+  options.opt_level = "9";
+  EXPECT_THROW(Compiler::GetCompilerFlags(options), std::runtime_error);
+
+  options.opt_level = "2";
+  options.march = "native; rm -rf /";
+  EXPECT_THROW(Compiler::GetCompilerFlags(options), std::runtime_error);
+}
+
+// Run Compiler::exec in a child process and capture its stdout
+std::string ExecProgram(const CompileOptions &options,
+                        const std::vector<std::string> &args) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return "";
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    try {
+      Compiler(options).exec(Parser().Parse(kMultiMainProgram), args);
+    } catch (const std::exception &) {
+    }
+    _exit(1);
+  }
+  close(fds[1]);
+  std::string output;
+  char buffer[128];
+  for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;) {
+    output.append(buffer, n);
+  }
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? output : "failed";
+}
+
+TEST_F(CompilerTest, Exec_RunsProgramFromMemoryAndCache) {
+  std::string cache_dir = "test_program_exec_cache";
+  std::filesystem::remove_all(cache_dir);
+  CompileOptions options;
+  options.use_cache = true;
+  options.cache_dir = cache_dir;
+
+  EXPECT_EQ(ExecProgram(options, {"Y=0x01"}), "8 \ne \n2 \n");
+  EXPECT_EQ(CompileCache(cache_dir).Stats().entries, 1u);
+  EXPECT_EQ(ExecProgram(options, {}), "a \ne \n6 \n");
+  EXPECT_EQ(CompileCache(cache_dir).Stats().hits, 1u);
+}
+
+TEST_F(CompilerTest, Compile_OptimizedProfilesMatchDefault) {
+  compiler->compile(kMultiMainProgram, "test_program_default");
+
+  CompileOptions options;
+  options.opt_level = "3";
+  options.lto = true;
+  options.size_profile = true;
+  Compiler(options).compile(kMultiMainProgram, "test_program_optimized");
+
+  EXPECT_EQ(RunProgram("./test_program_optimized"),
+            RunProgram("./test_program_default"));
+}
+
+TEST_F(CompilerTest, Compile_ProfileGuidedBuildKeepsProfiles) {
+  std::filesystem::remove_all("test_program_pgo.pgo");
+
+  CompileOptions options;
+  options.pgo_runs = {"X=0x05", "X=0x0102 Y=0x03"};
+  Compiler(options).compile(kMultiMainProgram, "test_program_pgo");
+
+  EXPECT_EQ(RunProgram("./test_program_pgo"), "a \ne \n6 \n");
+  bool has_profile = false;
+  for (const auto &entry :
+       std::filesystem::directory_iterator("test_program_pgo.pgo")) {
+    has_profile = has_profile || entry.path().extension() == ".gcda";
+  }
+  EXPECT_TRUE(has_profile);
+
+  options.pgo_runs = {"NOT_AN_ARGUMENT=0x01"};
+  EXPECT_THROW(Compiler(options).compile(kMultiMainProgram, "test_program_pgo"),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, GenerateTranslationUnits_PartitionsByName) {
+  Parser parser;
+  auto statements = parser.Parse(kMultiMainProgram);
+  CompileOptions options;
+  options.translation_units = 8;
+  auto units = Compiler::GenerateTranslationUnits(statements, options);
+
+  EXPECT_EQ(units.header, "extern std::vector<uint8_t> X;\n"
+                          "extern std::vector<uint8_t> Y;\n"
+                          "std::vector<uint8_t> sum(const std::vector<uint8_t>& "
+                          "_a, const std::vector<uint8_t>& _b);\n"
+                          "std::vector<uint8_t> scale(const "
+                          "std::vector<uint8_t>& _a);\n");
+  std::string definitions;
+  for (const auto &unit : units.units) {
+    EXPECT_FALSE(unit.empty());
+    definitions += unit;
+  }
+  EXPECT_NE(definitions.find("std::vector<uint8_t> X = {0x07};"),
+            std::string::npos);
+  EXPECT_NE(definitions.find("std::vector<uint8_t> scale("),
+            std::string::npos);
+  EXPECT_NE(units.main_unit.find("int main(int argc, char** argv)"),
+            std::string::npos);
+
+  // A definition's unit depends only on its own name
+  auto smaller = parser.Parse({"let X 0x07", "def sum _a _b => + _a _b",
+                               "main sum X X"});
+  auto smaller_units = Compiler::GenerateTranslationUnits(smaller, options);
+  for (const auto &unit : smaller_units.units) {
+    EXPECT_NE(std::find(units.units.begin(), units.units.end(), unit),
+              units.units.end());
+  }
+}
+
+TEST_F(CompilerTest, GenerateTranslationUnitSources_MissesOnNewRuntime) {
+  std::string cache_dir = "test_program_unit_fingerprint_cache";
+  std::filesystem::remove_all(cache_dir);
+  std::ofstream("test_program_unit_fingerprint.o") << "object";
+  auto statements = Parser().Parse(kMultiMainProgram);
+
+  for (bool incremental : {false, true}) {
+    CompileOptions options;
+    options.translation_units = 3;
+    options.incremental = incremental;
+    auto old_units =
+        Compiler::GenerateTranslationUnitSources(statements, options, "old");
+    auto new_units =
+        Compiler::GenerateTranslationUnitSources(statements, options, "new");
+    ASSERT_EQ(old_units.identities.size(), old_units.sources.size());
+    ASSERT_EQ(new_units.sources, old_units.sources);
+    EXPECT_EQ(old_units.identities.back().find("int main("),
+              std::string::npos);
+
+    // Units only include the runtime's headers, so only the fingerprint
+    // tells their objects apart
+    CompileCache cache(cache_dir);
+    for (size_t i = 0; i < old_units.identities.size(); ++i) {
+      cache.Store(CompileCache::Key(old_units.identities[i], "g++", "", {}),
+                  "test_program_unit_fingerprint.o");
+      EXPECT_FALSE(
+          cache.Fetch(CompileCache::Key(new_units.identities[i], "g++", "", {}),
+                      "test_program_unit_fingerprint_fetched.o"));
+    }
+  }
+  EXPECT_EQ(CompileCache(cache_dir).Stats().hits, 0);
+}
+
+TEST_F(CompilerTest, GenerateSharedObjectCode_ExportsNamedDefsAndTheirLets) {
+  auto statements = Parser().Parse(
+      {"let X 0x07", "let Y X", "let Z 0x01", "def scale _a => * Y _a",
+       "def sum _a _b => + _a _b", "main sum X Y"});
+  std::string code = Compiler::GenerateSharedObjectCode(statements, {"scale"});
+
+  EXPECT_NE(code.find("std::vector<uint8_t> X = {0x07};"), std::string::npos);
+  EXPECT_NE(code.find("extern \"C\" std::vector<uint8_t>* boyo_global_Y() "
+                      "{ return &Y; }"),
+            std::string::npos);
+  EXPECT_NE(code.find("extern \"C\" void boyo_entry_scale_1(const "
+                      "std::vector<uint8_t>* const* args, "
+                      "std::vector<uint8_t>* result) {\n  *result = "
+                      "scale(*args[0]);\n}"),
+            std::string::npos);
+  EXPECT_EQ(code.find("Z"), std::string::npos);
+  EXPECT_EQ(code.find("sum"), std::string::npos);
+  EXPECT_EQ(code.find("int main"), std::string::npos);
+
+  code = Compiler::GenerateSharedObjectCode(statements);
+  EXPECT_NE(code.find("boyo_entry_sum_2"), std::string::npos);
+  EXPECT_NE(code.find("boyo_global_Z"), std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileLibrary_LinksIntoCProgram) {
+  auto statements = Parser().Parse(
+      {"let X 0x07", "def mix _a _b => - * _a _b + _b X",
+       "def mix _a => + _a X", "def twice _a => * 0x02 _a", "main twice X"});
+  compiler->compile_library(statements, "test_lib.a", "test_lib.h");
+
+  std::string header = Compiler::GenerateLibraryHeader(statements, "G");
+  EXPECT_NE(header.find("size_t mix_2(const uint8_t* _a, size_t _a_len, "
+                        "const uint8_t* _b, size_t _b_len, "
+                        "uint8_t* boyo_out, size_t boyo_out_cap);"),
+            std::string::npos);
+  EXPECT_NE(header.find("size_t twice("), std::string::npos);
+
+  std::ofstream("test_lib_user.c")
+      << "#include <stdio.h>\n#include \"test_lib.h\"\n"
+         "int main(void) {\n"
+         "  uint8_t a[] = {1, 2, 0x90}, b[] = {5, 3}, out[3];\n"
+         "  size_t n = mix_2(a, 3, b, 2, out, sizeof out);\n"
+         "  for (size_t i = 0; i < n; ++i) printf(\"%x \", out[i]);\n"
+         "  printf(\"%zu %zu\\n\", mix_1(b, 2, NULL, 0), "
+         "twice(a, 3, out, 2));\n"
+         "  return 0;\n}\n";
+  ASSERT_EQ(std::system("gcc -std=c99 -o test_lib_user test_lib_user.c "
+                        "test_lib.a"),
+            0);
+  EXPECT_EQ(RunProgram("./test_lib_user"), "f9 3 0 2 3\n");
+}
+
+TEST_F(CompilerTest, GenerateLibraryCode_RejectsClashingExports) {
+  // Overloads of f are exported as f_1 and f_2
+  auto statements = Parser().Parse(
+      {"def f _a => _a", "def f _a _b => _a", "def f_1 _a => _a"});
+  EXPECT_THROW(Compiler::GenerateLibraryCode(statements), std::runtime_error);
+}
+
+TEST_F(CompilerTest, GenerateLibraryCode_RejectsCLibraryNames) {
+  // C callers include <stdlib.h> and link libc next to the library
+  for (const char *def : {"def free _a => _a", "def abs _a => _a",
+                          "def exit _a => _a", "def restrict _a => _a",
+                          "def boyo_call_f_1 _a => _a"}) {
+    auto statements = Parser().Parse({def});
+    EXPECT_THROW(Compiler::GenerateLibraryCode(statements), std::runtime_error)
+        << def;
+    EXPECT_THROW(Compiler::GenerateLibraryHeader(statements, "GUARD"),
+                 std::runtime_error)
+        << def;
+  }
+
+  // Overloads are exported with a suffix, which frees the name
+  auto statements =
+      Parser().Parse({"def abs _a => _a", "def abs _a _b => + _a _b"});
+  EXPECT_NE(Compiler::GenerateLibraryCode(statements).find("abs_1("),
+            std::string::npos);
+}
+
+TEST_F(CompilerTest, Compile_TranslationUnitsMatchSingleUnit) {
+  compiler->compile(kMultiMainProgram, "test_program_single_unit");
+
+  CompileOptions options;
+  options.translation_units = 3;
+  options.jobs = 2;
+  Compiler(options).compile(kMultiMainProgram, "test_program_units");
+
+  options.link_runtime = false;
+  Compiler(options).compile(kMultiMainProgram, "test_program_units_embedded");
+
+  auto expected = RunProgram("./test_program_single_unit");
+  EXPECT_EQ(RunProgram("./test_program_units"), expected);
+  EXPECT_EQ(RunProgram("./test_program_units_embedded"), expected);
+}
+
+TEST_F(CompilerTest, ComputeContentHashes_FollowDependencies) {
+  Parser parser;
+  auto hashes =
+      Compiler::ComputeContentHashes(parser.Parse(kMultiMainProgram), {});
+  ASSERT_EQ(hashes.size(), 4);
+  EXPECT_EQ(hashes.at("X").size(), 64);
+
+  // Mains do not affect any hash
+  auto again = Compiler::ComputeContentHashes(
+      parser.Parse({"let X 0x07", "let Y 0x03", "def sum _a _b => + _a _b",
+                    "def scale _a => * 0x02 _a"}),
+      {});
+  EXPECT_EQ(again, hashes);
+
+  // Changing a let changes the defs that refer to it, and nothing else
+  auto edited = Compiler::ComputeContentHashes(
+      parser.Parse({"let X 0x08", "let Y 0x03", "let Z 0x01",
+                    "def uses_x _a => + X _a", "def uses_z _a => + Z _a"}),
+      {});
+  auto original = Compiler::ComputeContentHashes(
+      parser.Parse({"let X 0x07", "let Y 0x03", "let Z 0x01",
+                    "def uses_x _a => + X _a", "def uses_z _a => + Z _a"}),
+      {});
+  EXPECT_NE(edited.at("X"), original.at("X"));
+  EXPECT_NE(edited.at("uses_x"), original.at("uses_x"));
+  EXPECT_EQ(edited.at("Y"), original.at("Y"));
+  EXPECT_EQ(edited.at("uses_z"), original.at("uses_z"));
+}
+
+TEST_F(CompilerTest, Compile_IncrementalRecompilesChangedDefinitions) {
+  std::string cache_dir = "test_program_incremental_cache";
+  std::filesystem::remove_all(cache_dir);
+
+  CompileOptions options;
+  options.incremental = true;
+  options.cache_dir = cache_dir;
+  Compiler(options).compile(kMultiMainProgram, "test_program_incremental_1");
+  EXPECT_EQ(RunProgram("./test_program_incremental_1"), "a \ne \n6 \n");
+  auto stats = CompileCache(cache_dir).Stats();
+  EXPECT_EQ(stats.misses, 5); // Four definitions and main
+  EXPECT_EQ(stats.hits, 0);
+
+  // Only the edited def is compiled again; main only sees its prototype
+  auto edited = kMultiMainProgram;
+  edited[3] = "def scale _a => * 0x03 _a";
+  Compiler(options).compile(edited, "test_program_incremental_2");
+  EXPECT_EQ(RunProgram("./test_program_incremental_2"), "a \n15 \n6 \n");
+  stats = CompileCache(cache_dir).Stats();
+  EXPECT_EQ(stats.misses, 6);
+  EXPECT_EQ(stats.hits, 4);
+}
+
+TEST_F(CompilerTest, Compile_ParallelKernelsMatchSerial) {
+  std::vector<std::string> lines = {
+      "let A 0x07", "let B 0x05",
+      "def mix _a _b => - * + _a _b _a * 0x03 _b", "main mix A B"};
+  compiler->compile(lines, "test_program_kernels");
+
+  // A threshold of one byte forces every operator onto the chunked path
+  auto serial = RunProgram("./test_program_kernels");
+  EXPECT_EQ(serial, "45 \n");
+  EXPECT_EQ(RunProgram("BOYO_PARALLEL_THRESHOLD=1 ./test_program_kernels"),
+            serial);
+}
+
+TEST_F(CompilerTest, Compile_ParallelKernelsMatchSerialOnLargeOperands) {
+  // Several chunks with a partial last one, operands of different lengths
+  // and temporaries reused in place by the nested operators
+  std::string a(300007, '\0');
+  std::string b(200003, '\0');
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] = static_cast<char>(i * 31 + i / 977);
+  }
+  for (size_t i = 0; i < b.size(); ++i) {
+    b[i] = static_cast<char>(i * 17 + 5);
+  }
+  std::ofstream("test_program_kernels_a.bin", std::ios::binary) << a;
+  std::ofstream("test_program_kernels_b.bin", std::ios::binary) << b;
+  std::vector<std::string> lines = {
+      "let A 0x07", "let B 0x05",
+      "def mix _a _b => - * + _a _b _a * 0x03 _b", "main mix A B"};
+  compiler->compile(lines, "test_program_kernels_large");
+
+  std::ostringstream expected;
+  expected << std::hex;
+  for (size_t i = 0; i < a.size(); ++i) {
+    uint8_t x = a[i];
+    uint8_t y = i < b.size() ? static_cast<uint8_t>(b[i]) : 0;
+    uint8_t three = i == 0 ? 3 : 0; // The literal is one byte long
+    expected << static_cast<int>(static_cast<uint8_t>((x + y) * x - three * y))
+             << " ";
+  }
+  expected << "\n";
+  std::string command = "./test_program_kernels_large "
+                        "A=@test_program_kernels_a.bin "
+                        "B=@test_program_kernels_b.bin";
+  EXPECT_EQ(RunProgram(command), expected.str());
+  EXPECT_EQ(RunProgram("BOYO_PARALLEL_THRESHOLD=1 " + command),
+            expected.str());
+}
+
+TEST_F(CompilerTest, Compile_StreamingMatchesMaterialized) {
+  std::vector<std::string> lines = {"let X 0x07", "let Y 0x03",
+                                    "def f _a _b => + + _a _a _b",
+                                    "main f X Y"};
+  compiler->compile(lines, "test_program_materialized");
+
+  CompileOptions options;
+  options.stream = true;
+  options.stream_chunk_size = 3;
+  Compiler(options).compile(lines, "test_program_stream");
+
+  // Unbound arguments fall back to their compiled-in values
+  EXPECT_EQ(RunProgram("./test_program_stream"),
+            RunProgram("./test_program_materialized"));
+  // Bound arguments are streamed across several chunks
+  EXPECT_EQ(RunProgram("printf 'abcdefg' | ./test_program_stream X=-"),
+            "c5 c4 c6 c8 ca cc ce \n");
+}
+
+TEST_F(CompilerTest, Compile_PrintsEveryByteValueLikeOstream) {
+  std::vector<std::string> lines = {"let X 0x00", "def identity _a => _a",
+                                    "main identity X"};
+  CompileOptions options;
+  options.stream = true;
+  Compiler(options).compile(lines, "test_program_hex");
+
+  std::string bytes;
+  std::ostringstream expected;
+  for (int byte = 0; byte < 256; ++byte) {
+    bytes += static_cast<char>(byte);
+    expected << std::hex << byte << " ";
+  }
+  expected << "\n";
+  std::ofstream("test_program_hex.bin", std::ios::binary) << bytes;
+
+  EXPECT_EQ(RunProgram("./test_program_hex X=@test_program_hex.bin"),
+            expected.str());
+}
+
+TEST_F(CompilerTest, Compile_RawLengthPrefixedOutputToFile) {
+  CompileOptions options;
+  options.threads = 2;
+  options.output_format = OutputFormat::kRawLengthPrefixed;
+  Compiler(options).compile(kMultiMainProgram, "test_program_raw");
+
+  EXPECT_EQ(RunProgram("./test_program_raw --output=test_program_raw.bin"),
+            "");
+  std::ifstream in("test_program_raw.bin", std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+  EXPECT_EQ(bytes, std::string("\x01\0\0\0\0\0\0\0\x0a"
+                               "\x01\0\0\0\0\0\0\0\x0e"
+                               "\x01\0\0\0\0\0\0\0\x06",
+                               27));
+}
+
+TEST_F(CompilerTest, Compile_RawOutputToPipeMatchesFile) {
+  // Results this large are spliced into a pipe; each must stay intact
+  // while the next ones are computed
+  std::string bytes(3 << 20, '\0');
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<char>(i * 7 + i / 4096);
+  }
+  std::ofstream("test_program_raw_pipe_input.bin", std::ios::binary) << bytes;
+  CompileOptions options;
+  options.output_format = OutputFormat::kRaw;
+  Compiler(options).compile(
+      {"let X 0x00", "def identity _a => _a", "def twice _a => + _a _a",
+       "def triple _a => * 0x03 _a", "main identity X", "main twice X",
+       "main triple X", "main twice X", "main identity X"},
+      "test_program_raw_pipe");
+
+  std::string run = "./test_program_raw_pipe X=@test_program_raw_pipe_input.bin";
+  RunProgram(run + " --output=test_program_raw_pipe_file.bin");
+  RunProgram(run + " | cat > test_program_raw_pipe_piped.bin");
+  auto read = [](const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  };
+  std::string file = read("test_program_raw_pipe_file.bin");
+  EXPECT_EQ(file.size(), 5 * bytes.size());
+  EXPECT_TRUE(read("test_program_raw_pipe_piped.bin") == file);
+}
+
+TEST_F(CompilerTest, Compile_RawPrefixedRejectsStreaming) {
+  CompileOptions options;
+  options.stream = true;
+  options.output_format = OutputFormat::kRawLengthPrefixed;
+  auto statements = Parser().Parse(kMultiMainProgram);
+  EXPECT_THROW(Compiler::GenerateProgramCode(statements, options),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, Compile_BindsMainArgumentsAtRuntime) {
+  compiler->compile(kMultiMainProgram, "test_program_bound");
+
+  // Long, mixed-case hex strings exercise the vectorized decoder and its
+  // scalar tail; an odd digit count reads as a leading zero nibble
+  std::string hex = "0x";
+  std::ostringstream expected;
+  for (int byte = 0; byte < 67; ++byte) {
+    int value = (byte * 37 + 11) & 0xFF;
+    char digits[3];
+    std::snprintf(digits, sizeof(digits), byte % 2 ? "%02X" : "%02x", value);
+    hex += digits;
+    expected << std::hex << ((value + (byte == 0 ? 0x0F : 0)) & 0xFF) << " ";
+  }
+  auto output = RunProgram("./test_program_bound X=" + hex + " Y=0xf");
+  EXPECT_EQ(output.substr(0, output.find('\n')), expected.str());
+
+  std::ofstream("test_program_bound.bin", std::ios::binary) << "\x01\x02";
+  EXPECT_EQ(RunProgram("./test_program_bound X=@test_program_bound.bin "
+                       "Y=- < test_program_bound.bin"),
+            "2 4 \n2 0 \n2 4 \n");
+}
+
+TEST_F(CompilerTest, Compile_RejectsUnknownRuntimeArguments) {
+  compiler->compile(kMultiMainProgram, "test_program_unknown");
+
+  EXPECT_EQ(RunProgram("./test_program_unknown Z=0x01 2>&1"),
+            "Error: unknown argument: Z=0x01\n");
+  EXPECT_EQ(RunProgram("./test_program_unknown X=0x0g 2>&1"),
+            "Error: invalid hex digit: g\n");
+}
+
+TEST_F(CompilerTest, Compile_FusedProgramsRunByNameOrSubcommand) {
+  Parser parser;
+  std::vector<FusedProgram> programs;
+  programs.push_back({"multi", parser.Parse(kMultiMainProgram)});
+  programs.push_back(
+      {"double", parser.Parse({"let X 0x01", "def twice _a => + _a _a",
+                               "main twice X"})});
+  compiler->compile(programs, "test_program_fused");
+
+  EXPECT_EQ(RunProgram("./test_program_fused multi"), "a \ne \n6 \n");
+  EXPECT_EQ(RunProgram("./test_program_fused double X=0x21"), "42 \n");
+
+  std::filesystem::remove("double");
+  std::filesystem::create_symlink("test_program_fused", "double");
+  EXPECT_EQ(RunProgram("./double"), "2 \n");
+  EXPECT_EQ(RunProgram("./test_program_fused 2>&1"),
+            "Usage: test_program_fused <program> [NAME=SOURCE]...\n"
+            "Programs: multi double\n");
+
+  programs.push_back({"multi", parser.Parse({"let X 0x01"})});
+  EXPECT_THROW(Compiler::GenerateFusedProgramCode(programs, CompileOptions()),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, Compile_BatchAppliesMainToEveryRecordInOrder) {
+  std::vector<std::string> lines = {"let X 0x07", "let Y 0x03",
+                                    "def f _a _b => + * 0x02 _a _b",
+                                    "main f X Y"};
+  CompileOptions options;
+  options.batch = true;
+  options.threads = 3;
+  Compiler(options).compile(lines, "test_program_batch");
+
+  // Fields a record leaves out keep the main argument's value
+  std::ostringstream records;
+  std::ostringstream expected;
+  for (int i = 0; i < 100; ++i) {
+    records << "0x" << std::hex << i << (i % 2 ? " 0x01" : "") << "\n";
+    expected << std::hex << ((2 * i + (i % 2 ? 1 : 3)) & 0xFF) << " \n";
+  }
+  std::ofstream("test_program_batch.txt") << records.str();
+
+  EXPECT_EQ(RunProgram("./test_program_batch "
+                       "--records=@test_program_batch.txt 2>/dev/null"),
+            expected.str());
+  EXPECT_NE(RunProgram("./test_program_batch --records=@test_program_batch.txt "
+                       "2>&1 >/dev/null")
+                .find("100 records in"),
+            std::string::npos);
+}
+
+TEST_F(CompilerTest, Compile_BatchRejectsBogusBinaryLengths) {
+  std::vector<std::string> lines = {"let X 0x07", "let Y 0x03",
+                                    "def f _a _b => + _a _b", "main f X Y"};
+  CompileOptions options;
+  options.batch = true;
+  Compiler(options).compile(lines, "test_program_batch_binary");
+
+  // One good record, then a field claiming 2^56 bytes with three present
+  std::string records("\x01\0\0\0\0\0\0\0\x05"
+                      "\x01\0\0\0\0\0\0\0\x06",
+                      18);
+  records += std::string("\0\0\0\0\0\0\0\x01", 8) + "abc";
+  std::ofstream("test_program_batch_binary.bin", std::ios::binary) << records;
+
+  std::string command = "./test_program_batch_binary "
+                        "--records=@test_program_batch_binary.bin "
+                        "--record-format=binary";
+  EXPECT_NE(RunProgram(command + " 2>&1 >/dev/null")
+                .find("Error: truncated binary record"),
+            std::string::npos);
+  records.resize(18);
+  std::ofstream("test_program_batch_binary.bin", std::ios::binary) << records;
+  EXPECT_EQ(RunProgram(command + " 2>/dev/null"), "b \n");
+}
+
+TEST_F(CompilerTest, Compile_BatchRejectsSeveralMains) {
+  CompileOptions options;
+  options.batch = true;
+  auto statements = Parser().Parse(kMultiMainProgram);
+  EXPECT_THROW(Compiler::GenerateProgramCode(statements, options),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, Compile_ReusesCachedBinary) {
+  std::string cache_dir = "test_program_cache";
+  std::filesystem::remove_all(cache_dir);
+
+  CompileOptions options;
+  options.use_cache = true;
+  options.cache_dir = cache_dir;
+  Compiler(options).compile(kMultiMainProgram, "test_program_cached_1");
+  Compiler(options).compile(kMultiMainProgram, "test_program_cached_2");
+
+  auto stats = CompileCache(cache_dir).Stats();
+  EXPECT_EQ(stats.entries, 1);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(RunProgram("./test_program_cached_2"),
+            RunProgram("./test_program_cached_1"));
+
+  // Different generated code is a different entry
+  options.threads = 2;
+  Compiler(options).compile(kMultiMainProgram, "test_program_cached_3");
+  EXPECT_EQ(CompileCache(cache_dir).Stats().entries, 2);
+}
+
 TEST_F(CompilerTest, Compile_CompilesProgram) {
   std::vector<std::string> lines = {"let A 0x10", "def identity _x => _x",
                                     "main identity A"};
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "embed/jit.hpp"
+
+namespace boyo {
+namespace {
+
+const char *kSource = "let X 0x07\n"
+                      "def twice _a => * 0x02 _a\n"
+                      "def mix _a _b => - * _a _b + _b 0x01\n"
+                      "def mix _a => + _a X\n"
+                      "main twice X\n";
+
+TEST(JitTest, Get_CallsDefsOnCallerBuffers) {
+  Module module = Jit::Compile(kSource);
+  Function twice = module.Get("twice");
+  std::vector<uint8_t> a = {1, 2, 0x90};
+  std::vector<uint8_t> b = {5, 3};
+
+  // Too small a buffer is left alone and the needed length returned
+  uint8_t out[4] = {0xaa, 0xaa, 0xaa, 0xaa};
+  EXPECT_EQ(twice({a}, std::span(out, 2)), 3u);
+  EXPECT_EQ(out[0], 0xaa);
+  EXPECT_EQ(twice({a}, out), 3u);
+  EXPECT_EQ(std::vector<uint8_t>(out, out + 3),
+            (std::vector<uint8_t>{2, 0, 0}));
+
+  // Missing bytes read as zero and arithmetic wraps, as in programs
+  EXPECT_EQ(module.Get("mix", 2)({a, b}),
+            (std::vector<uint8_t>{0xff, 3, 0}));
+  EXPECT_EQ(module.Get("mix", 1)({b}), (std::vector<uint8_t>{12, 3}));
+  EXPECT_EQ(twice({std::span<const uint8_t>()}), (std::vector<uint8_t>{0}));
+}
+
+TEST(JitTest, Get_RejectsUnknownAndAmbiguousDefs) {
+  Module module = Jit::Compile(kSource);
+  EXPECT_THROW(module.Get("triple"), std::runtime_error);
+  EXPECT_THROW(Jit::Compile("def double _a => _a"), std::runtime_error);
+  EXPECT_THROW(module.Get("mix"), std::runtime_error);
+  EXPECT_THROW(module.Get("twice", 2), std::runtime_error);
+  std::vector<uint8_t> a = {1};
+  EXPECT_THROW(module.Get("twice")({a, a}), std::runtime_error);
+}
+
+TEST(JitTest, Compile_SharesModulesOfTheSameSource) {
+  std::optional<Function> twice;
+  {
+    Module module = Jit::Compile(kSource);
+    twice = Jit::Compile(kSource).Get("twice");
+  }
+  // The function keeps its code loaded after its modules are gone
+  std::vector<uint8_t> a = {0x81};
+  EXPECT_EQ((*twice)({a}), (std::vector<uint8_t>{2}));
+}
+
+TEST(JitTest, Compile_BuildsConcurrentlyRequestedModules) {
+  // Callers of the same source share one build; other sources build
+  // alongside it
+  std::vector<std::string> sources = {"def add _a _b => + _a _b\n",
+                                      "def sub _a _b => - _a _b\n"};
+  std::vector<std::vector<uint8_t>> results(6);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back([&, i]() {
+      Module module = Jit::Compile(sources[i % 2]);
+      std::vector<uint8_t> a = {5};
+      std::vector<uint8_t> b = {3};
+      results[i] = module.Get(i % 2 ? "sub" : "add")({a, b});
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    uint8_t expected = i % 2 ? 2 : 8;
+    EXPECT_EQ(results[i], std::vector<uint8_t>{expected});
+  }
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiler/compiler.hpp"
+#include "interpreter/interpreter.hpp"
+#include "parser/parser.hpp"
+#include "test_utils.hpp"
+
+namespace boyo {
+namespace {
+
+std::string Interpret(const std::vector<std::string> &lines,
+                      const std::vector<std::string> &args = {}) {
+  std::ostringstream out;
+  Interpreter(Parser().Parse(lines)).Run(out, args);
+  return out.str();
+}
+
+TEST(InterpreterTest, Run_MatchesKernelSemantics) {
+  EXPECT_EQ(Interpret({"let X 0x07", "let Y 0x03", "def sum _a _b => + _a _b",
+                       "def scale _a => * 0x02 _a", "main sum X Y",
+                       "main scale X", "def diff _a _b => - _a _b",
+                       "main diff Y X"}),
+            "a \ne \nfc \n");
+
+  // Bound arguments are as long as the longer operand, zero-padded
+  EXPECT_EQ(Interpret({"let X 0x01", "let Y 0x02", "def f _a _b => - _a _b",
+                       "main f X Y"},
+                      {"X=0x0102ff", "Y=0x03"}),
+            "fe 2 ff \n");
+}
+
+TEST(InterpreterTest, Run_RejectsUnknownArguments) {
+  std::vector<std::string> lines = {"let X 0x01", "def id _a => _a",
+                                    "main id X"};
+  EXPECT_EQ(Interpret(lines, {"X=0xabcd"}), "ab cd \n");
+  EXPECT_THROW(Interpret(lines, {"Z=0x01"}), std::runtime_error);
+  EXPECT_THROW(Interpret(lines, {"X"}), std::runtime_error);
+}
+
+TEST(InterpreterTest, Interpreter_RejectsWhatGppRejects) {
+  Parser parser;
+  for (const auto &lines : std::vector<std::vector<std::string>>{
+           {"let X 0x100"},
+           {"def f _a => + _a X", "let X 0x01"},
+           {"def f _a => + _a _b"},
+           {"let X 0x01", "let X 0x02"},
+           {"def double _a => _a"},
+           {"let X 0x01", "def X _a => _a"},
+           {"let X 0x01", "def f _a => _a", "main f X X"},
+           {"let X 0x01", "def f _a => _a", "main f Y"},
+       }) {
+    EXPECT_THROW(Interpreter(parser.Parse(lines)), std::runtime_error)
+        << lines.back();
+  }
+}
+
+TEST(InterpreterTest, Call_OverloadsByParameterCount) {
+  Interpreter interpreter(Parser().Parse(
+      {"let K 0x10", "def f _a => + _a K", "def f _a _b => * _a _b"}));
+  EXPECT_EQ(interpreter.Call("f", {{0x01, 0x02}}),
+            (std::vector<uint8_t>{0x11, 0x02}));
+  EXPECT_EQ(interpreter.Call("f", {{0x03}, {0x05, 0x07}}),
+            (std::vector<uint8_t>{0x0f, 0x00}));
+  EXPECT_THROW(interpreter.Call("f", {}), std::runtime_error);
+}
+
+// Every example program the compiler accepts prints the same when
+// interpreted, and every one it rejects is rejected by the interpreter
+TEST(InterpreterTest, Run_ConformsToCompiledExamples) {
+  size_t checked = 0;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(BOYO_EXAMPLES_DIR)) {
+    if (entry.path().extension() != ".boyo") {
+      continue;
+    }
+    std::ifstream in(entry.path());
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) {
+      lines.push_back(line);
+    }
+    StatementList statements;
+    try {
+      statements = Parser().Parse(lines);
+    } catch (const std::runtime_error &) {
+      continue; // Neither can run what does not parse
+    }
+
+    std::string binary =
+        "test_program_conformance_" + entry.path().stem().string();
+    bool compiled = true;
+    try {
+      Compiler().compile(statements, binary);
+    } catch (const std::runtime_error &) {
+      compiled = false;
+    }
+    if (!compiled) {
+      EXPECT_THROW(Interpreter{statements}, std::runtime_error)
+          << entry.path();
+      continue;
+    }
+    std::ostringstream out;
+    Interpreter(statements).Run(out);
+    EXPECT_EQ(out.str(), RunProgram("./" + binary)) << entry.path();
+    ++checked;
+  }
+  EXPECT_GT(checked, 0u);
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "jit/jit_program.hpp"
+#include "parser/parser.hpp"
+#include "vm/vm.hpp"
+
+namespace boyo {
+namespace {
+
+const std::vector<std::string> kProgram = {
+    "let X 0x07",
+    "let Y 0x03",
+    "let Z Y",
+    "def sum _a _b => + _a _b",
+    "def mix _a _b _c => - * + _a _b _c * _a _a",
+    "def globals => + * X 0x04 Z",
+    "def id _a => _a",
+    "main sum X Y",
+    "main mix X Y Z",
+    "main globals",
+    "main id X"};
+
+std::vector<JitOptions> Isas() {
+  std::vector<JitOptions> isas(1);
+  isas[0].isa = JitOptions::Isa::kSse2;
+  if (JitProgram::CpuHasAvx2()) {
+    isas.emplace_back().isa = JitOptions::Isa::kAvx2;
+  }
+  return isas;
+}
+
+std::vector<uint8_t> Pattern(size_t size, uint8_t seed) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>(seed + i * 37 + (i >> 3));
+  }
+  return bytes;
+}
+
+TEST(JitProgramTest, Call_MatchesVmForAnyLengths) {
+  auto bytecode = CompileBytecode(Parser().Parse(kProgram));
+  Vm vm(bytecode);
+  for (const auto &options : Isas()) {
+    JitProgram jit(bytecode, options);
+    size_t mix = jit.FindFunction("mix", 3);
+    ASSERT_TRUE(jit.IsCompiled(mix));
+    // Lengths around and across vector blocks, mixed with short operands
+    for (size_t a : {0, 1, 15, 16, 17, 31, 32, 33, 100}) {
+      for (size_t c : {0, 1, 16, 40, 64, 97}) {
+        auto x = Pattern(a, 1), y = Pattern(3, 2), z = Pattern(c, 3);
+        const std::vector<uint8_t> *args[] = {&x, &y, &z};
+        EXPECT_EQ(jit.Call(mix, args), vm.Call(mix, args))
+            << "lengths " << a << ", " << c;
+      }
+    }
+    EXPECT_EQ(jit.Call("id", {{9, 8}}), (std::vector<uint8_t>{9, 8}));
+  }
+}
+
+TEST(JitProgramTest, Run_MatchesVm) {
+  auto bytecode = CompileBytecode(Parser().Parse(kProgram));
+  for (const auto &options : Isas()) {
+    for (const auto &args : std::vector<std::vector<std::string>>{
+             {}, {"X=0x0102ff", "Z=0xfe"}}) {
+      std::ostringstream expected;
+      Vm(bytecode).Run(expected, args);
+      std::ostringstream actual;
+      JitProgram(bytecode, options).Run(actual, args);
+      EXPECT_EQ(actual.str(), expected.str());
+    }
+  }
+}
+
+TEST(JitProgramTest, Jit_FallsBackToVmForOversizedBodies) {
+  // A balanced tree of 2^13 leaves needs 14 vector registers and is too
+  // large to expand
+  std::string body = "_a";
+  for (int depth = 0; depth < 13; ++depth) {
+    body = "+ " + body + " " + body;
+  }
+  auto bytecode = CompileBytecode(
+      Parser().Parse({"let X 0x01", "def wide _a => " + body, "main wide X"}));
+  JitProgram jit(bytecode);
+  EXPECT_FALSE(jit.IsCompiled(0));
+  EXPECT_EQ(jit.Call("wide", {{1, 2}}), (std::vector<uint8_t>{0, 0}));
+  std::ostringstream out;
+  jit.Run(out);
+  EXPECT_EQ(out.str(), "0 \n");
+}
+
+TEST(JitProgramTest, Jit_WritesPerfMap) {
+  std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+  std::remove(path.c_str());
+  JitOptions options;
+  options.perf_map = true;
+  JitProgram jit(CompileBytecode(Parser().Parse(kProgram)), options);
+
+  std::ifstream map(path);
+  std::vector<std::string> names;
+  for (std::string start, size, name; map >> start >> size >> name;) {
+    names.push_back(name);
+  }
+  std::remove(path.c_str());
+  EXPECT_EQ(names, (std::vector<std::string>{"boyo::sum/2", "boyo::mix/3",
+                                             "boyo::globals/0", "boyo::id/1"}));
+}
+
+} // namespace
+} // namespace boyo
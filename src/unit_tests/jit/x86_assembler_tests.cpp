@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "jit/x86_assembler.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(X86AssemblerTest, Encode_GeneralPurposeInstructions) {
+  X86Assembler as(false);
+  as.MovLoad(Gpr::kR9, Gpr::kRdi, 8); // mov r9, [rdi + 8]
+  as.AndLoad(Gpr::kR10, Gpr::kRsp, 0); // and r10, [rsp + 0]
+  as.Cmp(Gpr::kRax, Gpr::kRcx);        // cmp rax, rcx
+  as.AddImm8(Gpr::kRax, 32);           // add rax, 32
+  as.MovImm32(Gpr::kR8, 0x00FF00FF);   // mov r8d, 0xff00ff
+  EXPECT_EQ(as.Code(), (std::vector<uint8_t>{
+                           0x4C, 0x8B, 0x8F, 0x08, 0x00, 0x00, 0x00,       //
+                           0x4C, 0x23, 0x94, 0x24, 0x00, 0x00, 0x00, 0x00, //
+                           0x48, 0x3B, 0xC1,                               //
+                           0x48, 0x83, 0xC0, 0x20,                         //
+                           0x41, 0xB8, 0xFF, 0x00, 0xFF, 0x00}));
+}
+
+TEST(X86AssemblerTest, Encode_JumpsArePatchedRelative) {
+  X86Assembler as(false);
+  size_t skip = as.JumpIfZero();
+  size_t loop = as.Here();
+  as.JumpIfBelow(loop);
+  as.Patch(skip, as.Here());
+  as.Ret();
+  EXPECT_EQ(as.Code(), (std::vector<uint8_t>{
+                           0x0F, 0x84, 0x06, 0x00, 0x00, 0x00, // jz +6
+                           0x0F, 0x82, 0xFA, 0xFF, 0xFF, 0xFF, // jb -6
+                           0xC3}));
+}
+
+TEST(X86AssemblerTest, Encode_VectorInstructions) {
+  X86Assembler sse(false);
+  EXPECT_EQ(sse.VectorBytes(), 16u);
+  sse.VectorLoad(0, Gpr::kR9, Gpr::kR10); // movdqu xmm0, [r9 + r10]
+  sse.SubtractBytes(1, 2, 1);             // psubb xmm2, xmm1; movdqa xmm1, xmm2
+  sse.ShiftRightWords(14, 3, 8);          // movdqa xmm14, xmm3; psrlw xmm14, 8
+  EXPECT_EQ(sse.Code(), (std::vector<uint8_t>{
+                            0xF3, 0x43, 0x0F, 0x6F, 0x04, 0x11, //
+                            0x66, 0x0F, 0xF8, 0xD1,             //
+                            0x66, 0x0F, 0x6F, 0xCA,             //
+                            0x66, 0x44, 0x0F, 0x6F, 0xF3,       //
+                            0x66, 0x41, 0x0F, 0x71, 0xD6, 0x08}));
+
+  X86Assembler avx2(true);
+  EXPECT_EQ(avx2.VectorBytes(), 32u);
+  avx2.VectorStore(Gpr::kRdx, Gpr::kRax, 0); // vmovdqu [rdx + rax], ymm0
+  avx2.AddBytes(2, 0, 1);                    // vpaddb ymm2, ymm0, ymm1
+  avx2.ShiftLeftWords(14, 13, 8);            // vpsllw ymm14, ymm13, 8
+  avx2.BroadcastDword(15, Gpr::kR8);         // vmovd xmm15, r8d; vpbroadcastd
+  EXPECT_EQ(avx2.Code(), (std::vector<uint8_t>{
+                             0xC4, 0xE1, 0x7E, 0x7F, 0x04, 0x02, //
+                             0xC4, 0xE1, 0x7D, 0xFC, 0xD1,       //
+                             0xC4, 0xC1, 0x0D, 0x71, 0xF5, 0x08, //
+                             0xC4, 0x41, 0x79, 0x6E, 0xF8,       //
+                             0xC4, 0x42, 0x7D, 0x58, 0xFF}));
+}
+
+} // namespace
+} // namespace boyo
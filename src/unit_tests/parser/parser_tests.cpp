@@ -24,6 +24,15 @@ TEST(ParserTest, ParseEmptyLines) {
   EXPECT_EQ(statements.size(), 1);
 }
 
+TEST(ParserTest, ParseLine_SingleStatement) {
+  Parser parser;
+  EXPECT_EQ(parser.ParseLine(""), nullptr);
+  auto statement = parser.ParseLine("let A 0x10");
+  ASSERT_NE(statement, nullptr);
+  EXPECT_EQ(statement->GenerateCode(), "std::vector<uint8_t> A = {0x10};\n");
+  EXPECT_THROW(parser.ParseLine("let A"), std::runtime_error);
+}
+
 /**
  * Let Statement Parsing Tests
  */
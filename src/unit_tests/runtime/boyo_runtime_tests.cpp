@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "runtime/boyo_runtime.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(BoyoParallelForTest, RunsNestedLoopsInline) {
+  std::mutex mutex;
+  std::vector<std::thread::id> outer(4);
+  std::vector<std::vector<std::thread::id>> inner(4);
+  boyo_parallel_for(outer.size(), 4, [&](size_t i) {
+    outer[i] = std::this_thread::get_id();
+    boyo_parallel_for(8, 0, [&](size_t) {
+      std::lock_guard<std::mutex> lock(mutex);
+      inner[i].push_back(std::this_thread::get_id());
+    });
+  });
+
+  // Kernels called by a main already spread across threads stay on its
+  // thread rather than start a pool of their own
+  for (size_t i = 0; i < outer.size(); ++i) {
+    EXPECT_EQ(inner[i], std::vector<std::thread::id>(8, outer[i]));
+  }
+  EXPECT_FALSE(boyo_in_parallel_task);
+
+  std::atomic<int> runs{0};
+  boyo_parallel_for(8, 0, [&](size_t) { runs++; });
+  EXPECT_EQ(runs, 8);
+}
+
+TEST(BoyoParallelThresholdTest, KeepsDefaultForMalformedValues) {
+  // The threshold is read once per process, so each value is checked in a
+  // freshly started one
+  GTEST_FLAG_SET(death_test_style, "threadsafe");
+  auto exits_with = [](const char *value, size_t expected) {
+    setenv("BOYO_PARALLEL_THRESHOLD", value, 1);
+    std::exit(boyo_parallel_threshold() == expected ? 0 : 1);
+  };
+  EXPECT_EXIT(exits_with("4096", 4096), ::testing::ExitedWithCode(0), "");
+  for (const char *value : {"", "lots", "4x", "-1", " 8"}) {
+    EXPECT_EXIT(exits_with(value, size_t{1} << 22),
+                ::testing::ExitedWithCode(0), "")
+        << value;
+  }
+}
+
+TEST(BoyoReadFileTest, ReadsWholeFiles) {
+  std::string bytes(100000, '\0');
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<char>(i * 13);
+  }
+  std::ofstream("test_read_file.bin", std::ios::binary) << bytes;
+  std::ofstream("test_read_file_empty.bin");
+
+  EXPECT_EQ(boyo_read_file("test_read_file.bin"),
+            std::vector<uint8_t>(bytes.begin(), bytes.end()));
+  EXPECT_TRUE(boyo_read_file("test_read_file_empty.bin").empty());
+  EXPECT_THROW(boyo_read_file("test_read_file_missing.bin"),
+               std::runtime_error);
+  std::filesystem::remove("test_read_file.bin");
+  std::filesystem::remove("test_read_file_empty.bin");
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server/compile_server.hpp"
+#include "test_utils.hpp"
+
+namespace boyo {
+namespace {
+
+class CompileServerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    server = std::make_unique<CompileServer>(socket_path, 2);
+    thread = std::thread([this]() { server->Run(); });
+  }
+
+  void TearDown() override {
+    server->Stop();
+    thread.join();
+    server.reset();
+  }
+
+  CompileRequest Request(std::vector<std::string> lines,
+                         const std::string &output) {
+    CompileRequest request;
+    request.lines = std::move(lines);
+    request.output_file = std::filesystem::absolute(output);
+    return request;
+  }
+
+  const std::string socket_path =
+      std::filesystem::absolute("test_compile_server.sock");
+  std::unique_ptr<CompileServer> server;
+  std::thread thread;
+};
+
+TEST_F(CompileServerTest, Compile_ServesConcurrentRequests) {
+  CompileClient client(socket_path);
+  auto first = std::async(std::launch::async, [&]() {
+    return client.Compile(Request(
+        {"let X 0x07", "def f _a => + _a _a", "main f X"}, "test_served_1"));
+  });
+  auto second = client.Compile(Request(
+      {"let X 0x07", "def f _a => * _a _a", "main f X"}, "test_served_2"));
+
+  auto response = first.get();
+  ASSERT_TRUE(response.success) << response.error;
+  ASSERT_TRUE(second.success) << second.error;
+  EXPECT_EQ(response.output_file, std::filesystem::absolute("test_served_1"));
+  EXPECT_EQ(RunProgram("./test_served_1"), "e \n");
+  EXPECT_EQ(RunProgram("./test_served_2"), "31 \n");
+}
+
+TEST_F(CompileServerTest, Compile_ReturnsErrorsAndDiagnostics) {
+  CompileClient client(socket_path);
+  auto response = client.Compile(Request({"let X"}, "test_served_invalid"));
+  EXPECT_FALSE(response.success);
+  EXPECT_FALSE(response.error.empty());
+
+  // A def calling an undefined function is rejected by g++
+  response = client.Compile(
+      Request({"def f _a => + _a Missing", "main f"}, "test_served_invalid"));
+  EXPECT_FALSE(response.success);
+  EXPECT_NE(response.diagnostics.find("Missing"), std::string::npos);
+}
+
+TEST_F(CompileServerTest, Constructor_RefusesSocketInUse) {
+  EXPECT_THROW(CompileServer(socket_path, 1), std::runtime_error);
+}
+
+TEST(CompileClientTest, Compile_ThrowsWithoutServer) {
+  CompileClient client(std::filesystem::absolute("test_no_server.sock"));
+  EXPECT_THROW(client.Compile(CompileRequest{}), NoServerError);
+}
+
+TEST(CompileClientTest, Compile_DoesNotReportHangupsAsNoServer) {
+  // A server that hangs up is a failed build, not a missing server that
+  // the caller may replace with a local build
+  std::string path = std::filesystem::absolute("test_hangup.sock");
+  std::filesystem::remove(path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  ASSERT_EQ(bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+                 sizeof(address)),
+            0);
+  ASSERT_EQ(listen(listen_fd, 1), 0);
+  std::thread server(
+      [listen_fd]() { close(accept(listen_fd, nullptr, nullptr)); });
+
+  bool no_server = false;
+  bool failed = false;
+  try {
+    CompileClient(path).Compile(CompileRequest{});
+  } catch (const NoServerError &) {
+    no_server = true;
+  } catch (const std::runtime_error &) {
+    failed = true;
+  }
+  server.join();
+  close(listen_fd);
+  std::filesystem::remove(path);
+  EXPECT_FALSE(no_server);
+  EXPECT_TRUE(failed);
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "server/protocol.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(ProtocolTest, Request_RoundTrips) {
+  CompileRequest request;
+  request.lines = {"let X 0x07", "", "main f X"};
+  request.output_file = "/tmp/out";
+  request.options.threads = 4;
+  request.options.output_format = OutputFormat::kRawLengthPrefixed;
+  request.options.opt_level = "2";
+  request.options.pgo_runs = {"X=0x01", "X=@train.bin"};
+  request.options.incremental = true;
+  request.options.cache_dir = "/tmp/cache";
+  request.options.cache_max_bytes = uint64_t{1} << 40;
+
+  auto decoded = DecodeRequest(EncodeRequest(request));
+  EXPECT_EQ(decoded.lines, request.lines);
+  EXPECT_EQ(decoded.output_file, request.output_file);
+  EXPECT_EQ(decoded.options.threads, 4);
+  EXPECT_EQ(decoded.options.output_format, OutputFormat::kRawLengthPrefixed);
+  EXPECT_EQ(decoded.options.opt_level, "2");
+  EXPECT_EQ(decoded.options.pgo_runs, request.options.pgo_runs);
+  EXPECT_TRUE(decoded.options.incremental);
+  EXPECT_TRUE(decoded.options.link_runtime);
+  EXPECT_EQ(decoded.options.cache_dir, "/tmp/cache");
+  EXPECT_EQ(decoded.options.cache_max_bytes, uint64_t{1} << 40);
+}
+
+TEST(ProtocolTest, Response_RoundTrips) {
+  CompileResponse response;
+  response.error = "Failed to compile program: out";
+  response.diagnostics = "<stdin>:1:1: error: expected\n";
+
+  auto decoded = DecodeResponse(EncodeResponse(response));
+  EXPECT_FALSE(decoded.success);
+  EXPECT_EQ(decoded.error, response.error);
+  EXPECT_EQ(decoded.diagnostics, response.diagnostics);
+}
+
+TEST(ProtocolTest, Decode_RejectsMalformedMessages) {
+  std::string message = EncodeResponse(CompileResponse{});
+  EXPECT_THROW(DecodeResponse(message.substr(0, message.size() - 1)),
+               std::runtime_error);
+  EXPECT_THROW(DecodeResponse(message + "0:"), std::runtime_error);
+  EXPECT_THROW(DecodeResponse("6:boyo-9"), std::runtime_error);
+  EXPECT_THROW(DecodeRequest(message), std::runtime_error);
+}
+
+TEST(ProtocolTest, Messages_AreFramed) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  WriteMessage(fds[0], "first");
+  WriteMessage(fds[0], "");
+  close(fds[0]);
+
+  std::string message;
+  ASSERT_TRUE(ReadMessage(fds[1], message));
+  EXPECT_EQ(message, "first");
+  ASSERT_TRUE(ReadMessage(fds[1], message));
+  EXPECT_EQ(message, "");
+  EXPECT_FALSE(ReadMessage(fds[1], message));
+  close(fds[1]);
+}
+
+} // namespace
+} // namespace boyo
@@ -160,10 +160,97 @@ TEST(MainStatementTest, GenerateCode_NoArgs) {
                   "print_vector(std::cout, result);\n");
 }
 
+TEST(MainStatementTest, GenerateStreamCode_SharesRepeatedArgs) {
+  std::vector<std::string> args = {"A", "B", "A"};
+  MainStatement main_stmt("compute", args);
+
+  std::string code = main_stmt.GenerateStreamCode(4096);
+  EXPECT_NE(code.find("boyo_sources.emplace_back(A, "
+                      "boyo_find_binding(argc, argv, \"A\"));\n"
+                      "boyo_sources.emplace_back(B, "
+                      "boyo_find_binding(argc, argv, \"B\"));\n"
+                      "boyo_stream(boyo_hex_sink{std::cout}, boyo_sources, 4096,"),
+            std::string::npos);
+  EXPECT_NE(code.find("return boyo_chunk_compute(boyo_offset, boyo_size, "
+                      "boyo_args[0], boyo_args[1], boyo_args[0]);"),
+            std::string::npos);
+}
+
+TEST(MainStatementTest, GenerateBatchCode_PassesRecordArgs) {
+  std::vector<std::string> args = {"A", "B"};
+  MainStatement main_stmt("compute", args);
+
+  std::string code = main_stmt.GenerateBatchCode(8, "boyo_format_hex");
+  EXPECT_EQ(code, "boyo_run_batch(argc, argv, 8, boyo_format_hex, {&A, &B}, "
+                  "[](const std::vector<uint8_t>* const* boyo_args) {\n"
+                  "return compute(*boyo_args[0], *boyo_args[1]);\n"
+                  "});\n");
+}
+
+TEST(DefStatementTest, GenerateChunkCode_WindowsLiteralsAndGlobals) {
+  auto left = std::make_unique<HexLiteralExpression>("0x10");
+  auto right = std::make_unique<OperatorExpression>(
+      "+", std::make_unique<ParameterExpression>("_a"),
+      std::make_unique<IdentifierExpression>("B"));
+  auto body_expr = std::make_unique<OperatorExpression>("*", std::move(left),
+                                                        std::move(right));
+  std::vector<std::string> params = {"_a"};
+  DefStatement def_stmt("scale", params, std::move(body_expr));
+
+  std::string code = def_stmt.GenerateChunkCode();
+  EXPECT_EQ(code,
+            "std::vector<uint8_t> boyo_chunk_scale(size_t boyo_offset, "
+            "size_t boyo_size, const std::vector<uint8_t>& _a) {\n"
+            "  return multiply_vectors(boyo_window({0x10}, boyo_offset, "
+            "boyo_size), add_vectors(_a, boyo_window(B, boyo_offset, "
+            "boyo_size)));\n"
+            "}\n");
+}
+
 /**
  * Integration Tests - Multiple Statements Together
  */
 
+TEST(LetStatementTest, GenerateDeclarationCode_Extern) {
+  LetStatement let_stmt("A", std::make_unique<HexLiteralExpression>("0x10"));
+  EXPECT_EQ(let_stmt.GenerateDeclarationCode(),
+            "extern std::vector<uint8_t> A;\n");
+}
+
+TEST(DefStatementTest, GenerateDeclarationCode_Prototypes) {
+  std::vector<std::string> params = {"_a", "_b"};
+  DefStatement def_stmt("sum", params,
+                        std::make_unique<OperatorExpression>(
+                            "+", std::make_unique<ParameterExpression>("_a"),
+                            std::make_unique<ParameterExpression>("_b")));
+
+  EXPECT_EQ(def_stmt.GenerateDeclarationCode(),
+            "std::vector<uint8_t> sum(const std::vector<uint8_t>& _a, "
+            "const std::vector<uint8_t>& _b);\n");
+  EXPECT_EQ(def_stmt.GenerateChunkDeclarationCode(),
+            "std::vector<uint8_t> boyo_chunk_sum(size_t boyo_offset, "
+            "size_t boyo_size, const std::vector<uint8_t>& _a, "
+            "const std::vector<uint8_t>& _b);\n");
+}
+
+TEST(DefStatementTest, GetDependencies_SortedUnique) {
+  std::vector<std::string> params = {"_a"};
+  DefStatement def_stmt(
+      "mix", params,
+      std::make_unique<OperatorExpression>(
+          "+",
+          std::make_unique<OperatorExpression>(
+              "*", std::make_unique<IdentifierExpression>("Y"),
+              std::make_unique<ParameterExpression>("_a")),
+          std::make_unique<OperatorExpression>(
+              "-", std::make_unique<IdentifierExpression>("X"),
+              std::make_unique<IdentifierExpression>("Y"))));
+
+  EXPECT_EQ(def_stmt.GetDependencies(), (std::vector<std::string>{"X", "Y"}));
+  LetStatement let_stmt("A", std::make_unique<HexLiteralExpression>("0x10"));
+  EXPECT_TRUE(let_stmt.GetDependencies().empty());
+}
+
 TEST(StatementIntegrationTest, LetAndMain) {
   // let A 0x10
   auto let_value = std::make_unique<HexLiteralExpression>("0x10");
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace boyo {
+
+// Run a compiled program and capture its stdout
+inline std::string RunProgram(const std::string &command) {
+  std::string output;
+  FILE *pipe = popen(command.c_str(), "r");
+  if (!pipe) {
+    return output;
+  }
+  char buffer[128];
+  while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+    output += buffer;
+  }
+  pclose(pipe);
+  return output;
+}
+
+} // namespace boyo
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "parser/parser.hpp"
+#include "tiered/tiered_program.hpp"
+#include "vm/vm.hpp"
+
+namespace boyo {
+namespace {
+
+const std::vector<std::string> kProgram = {
+    "let X 0x07",
+    "let Y 0x03",
+    "def sum _a _b => + _a _b",
+    "def scale _a => * X _a",
+    "main sum X Y",
+    "main scale Y",
+    "main sum Y Y"};
+
+TEST(TieredProgramTest, Call_MovesHotDefToNativeCode) {
+  TieredOptions options;
+  options.threshold = 3;
+  TieredProgram program(Parser().Parse(kProgram), {"X=0x0102"}, options);
+  size_t scale = program.FindFunction("scale", 1);
+
+  // scale reads X, which is rebound, on both tiers
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(program.IsNative(scale));
+    EXPECT_EQ(program.Call("scale", {{5, 6}}), (std::vector<uint8_t>{5, 12}));
+  }
+  program.WaitForCompiles();
+  ASSERT_TRUE(program.IsNative(scale));
+  EXPECT_EQ(program.Call("scale", {{5, 6}}), (std::vector<uint8_t>{5, 12}));
+  EXPECT_FALSE(program.IsNative(program.FindFunction("sum", 2)));
+}
+
+TEST(TieredProgramTest, Call_RejectsUnknownFunctionIndex) {
+  TieredProgram program(Parser().Parse(kProgram), {}, TieredOptions{});
+  std::vector<uint8_t> a = {1};
+  const std::vector<uint8_t> *args[] = {&a, &a};
+  EXPECT_THROW(program.IsNative(2), std::out_of_range);
+  EXPECT_THROW(program.Call(2, args), std::out_of_range);
+}
+
+TEST(TieredProgramTest, Run_MatchesVmOnEveryTier) {
+  auto statements = Parser().Parse(kProgram);
+  std::ostringstream expected;
+  Vm(CompileBytecode(statements)).Run(expected, {"Y=0xff01"});
+
+  TieredOptions options;
+  options.threshold = 2; // sum is promoted by its second call
+  TieredProgram program(Parser().Parse(kProgram), {"Y=0xff01"}, options);
+  std::ostringstream first;
+  program.Run(first);
+  program.WaitForCompiles();
+  EXPECT_TRUE(program.IsNative(program.FindFunction("sum", 2)));
+  std::ostringstream second;
+  program.Run(second);
+  EXPECT_EQ(first.str(), expected.str());
+  EXPECT_EQ(second.str(), expected.str());
+}
+
+TEST(TieredProgramTest, Tiered_RejectsUnknownArguments) {
+  EXPECT_THROW(TieredProgram(Parser().Parse(kProgram), {"W=0x01"}),
+               std::runtime_error);
+}
+
+} // namespace
+} // namespace boyo
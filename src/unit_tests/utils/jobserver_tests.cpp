@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "utils/jobserver.hpp"
+
+namespace boyo {
+namespace {
+
+class JobServerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(pipe(fds), 0);
+    // make preloads one token per job slot beyond the first
+    ASSERT_EQ(write(fds[1], "ab", 2), 2);
+  }
+
+  void TearDown() override {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  int fds[2];
+};
+
+TEST_F(JobServerTest, FromMakeflags_ParsesDescriptorPair) {
+  auto jobserver = JobServer::FromMakeflags(
+      " -j3 --jobserver-auth=" + std::to_string(fds[0]) + "," +
+      std::to_string(fds[1]));
+  ASSERT_NE(jobserver, nullptr);
+
+  // The implicit slot comes first, then one slot per token
+  auto first = jobserver->Acquire();
+  auto second = jobserver->Acquire();
+  auto third = jobserver->Acquire();
+  EXPECT_EQ(first, JobServer::kImplicitToken);
+  EXPECT_EQ(second, 'a');
+  EXPECT_EQ(third, 'b');
+
+  jobserver->Release(third);
+  jobserver->Release(first);
+  EXPECT_EQ(jobserver->Acquire(), JobServer::kImplicitToken);
+  EXPECT_EQ(jobserver->Acquire(), 'b');
+}
+
+TEST_F(JobServerTest, FromMakeflags_RejectsMissingOrClosedDescriptors) {
+  EXPECT_EQ(JobServer::FromMakeflags(" -j3"), nullptr);
+  EXPECT_EQ(JobServer::FromMakeflags("--jobserver-auth=garbage"), nullptr);
+  EXPECT_EQ(JobServer::FromMakeflags("--jobserver-auth=900,901"), nullptr);
+}
+
+TEST(JobServerFifoTest, FromMakeflags_OpensFifo) {
+  std::string path = "boyo_test_jobserver_fifo";
+  unlink(path.c_str());
+  ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+
+  auto jobserver = JobServer::FromMakeflags("--jobserver-auth=fifo:" + path);
+  ASSERT_NE(jobserver, nullptr);
+  EXPECT_EQ(jobserver->Acquire(), JobServer::kImplicitToken);
+  jobserver->Release('x');
+  EXPECT_EQ(jobserver->Acquire(), 'x');
+  unlink(path.c_str());
+}
+
+} // namespace
+} // namespace boyo
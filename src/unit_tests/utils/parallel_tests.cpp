@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/parallel.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(ParallelForTest, RunsEveryTaskOnce) {
+  std::vector<std::atomic<int>> runs(100);
+  ParallelFor(runs.size(), 4, [&](size_t i) { runs[i]++; });
+  for (const auto &count : runs) {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+TEST(ParallelForTest, RethrowsAfterAllThreadsFinish) {
+  std::atomic<int> finished{0};
+  EXPECT_THROW(ParallelFor(10, 3,
+                           [&](size_t i) {
+                             if (i == 2) {
+                               throw std::runtime_error("task failed");
+                             }
+                             finished++;
+                           }),
+               std::runtime_error);
+  EXPECT_EQ(finished, 9);
+}
+
+} // namespace
+} // namespace boyo
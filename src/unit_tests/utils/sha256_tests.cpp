@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "utils/sha256.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(Sha256Test, Hash_EmptyString) {
+  EXPECT_EQ(Sha256::Hash(""),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(Sha256Test, Hash_Abc) {
+  EXPECT_EQ(Sha256::Hash("abc"),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(Sha256Test, Hash_TwoBlockMessage) {
+  EXPECT_EQ(
+      Sha256::Hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST(Sha256Test, Update_IncrementalMatchesOneShot) {
+  std::string data(1000, 'a');
+  Sha256 hasher;
+  for (size_t i = 0; i < data.size(); i += 7) {
+    hasher.Update(std::string_view(data).substr(i, 7));
+  }
+  EXPECT_EQ(hasher.HexDigest(), Sha256::Hash(data));
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+
+#include "utils/subprocess.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(SubprocessTest, Write_RoundTripsLargeInput) {
+  // Larger than both pipe buffers, so output must be drained while writing
+  std::string input;
+  for (int i = 0; input.size() < (size_t{1} << 20); ++i) {
+    input += std::to_string(i) + "\n";
+  }
+
+  Subprocess cat({"cat"});
+  EXPECT_TRUE(cat.Write(input));
+  EXPECT_EQ(cat.Wait(), 0);
+  EXPECT_EQ(cat.GetOutput(), input);
+}
+
+TEST(SubprocessTest, Wait_ReportsExitCodeAndStderr) {
+  Subprocess shell({"/bin/sh", "-c", "echo out; echo err >&2; exit 3"});
+  EXPECT_EQ(shell.Wait(), 3);
+  EXPECT_EQ(shell.GetOutput(), "out\nerr\n");
+}
+
+TEST(SubprocessTest, Write_ReturnsFalseWhenInputIsClosed) {
+  Subprocess process({"/bin/sh", "-c", "exec 0<&-; sleep 0.1"});
+  EXPECT_FALSE(process.Write(std::string(size_t{1} << 20, 'x')));
+  EXPECT_EQ(process.Wait(), 0);
+}
+
+TEST(SubprocessTest, Constructor_ThrowsForMissingProgram) {
+  EXPECT_THROW(Subprocess({"/nonexistent/program"}), std::runtime_error);
+}
+
+TEST(SubprocessTest, Constructor_ClosesInputPipeWhenOutputPipeFails) {
+  // Leave room for the input pipe only, so creating the output pipe fails
+  std::vector<int> free_fds;
+  for (int fd = 0; free_fds.size() < 3; ++fd) {
+    if (fcntl(fd, F_GETFD) == -1) {
+      free_fds.push_back(fd);
+    }
+  }
+  rlimit limit;
+  ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &limit), 0);
+  rlimit lowered = limit;
+  lowered.rlim_cur = free_fds[2];
+  ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &lowered), 0);
+  EXPECT_THROW(Subprocess({"cat"}), std::runtime_error);
+  setrlimit(RLIMIT_NOFILE, &limit);
+
+  EXPECT_EQ(fcntl(free_fds[0], F_GETFD), -1);
+  EXPECT_EQ(fcntl(free_fds[1], F_GETFD), -1);
+}
+
+} // namespace
+} // namespace boyo
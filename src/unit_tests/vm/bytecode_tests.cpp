@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "parser/parser.hpp"
+#include "vm/bytecode.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(BytecodeTest, CompileBytecode_AllocatesRegisterPerNode) {
+  auto bytecode = CompileBytecode(Parser().Parse(
+      {"let X 0x07", "def f _a => + * _a 0x02 X", "main f X"}));
+  ASSERT_EQ(bytecode.functions.size(), 1);
+  const auto &f = bytecode.functions[0];
+  EXPECT_EQ(f.params, 1);
+  EXPECT_EQ(f.registers, 5);
+
+  std::vector<Opcode> ops;
+  for (uint32_t i = f.entry; i < f.entry + f.size; ++i) {
+    ops.push_back(bytecode.code[i].op);
+  }
+  EXPECT_EQ(ops, (std::vector<Opcode>{Opcode::kLoadParam, Opcode::kLoadConst,
+                                      Opcode::kMultiply, Opcode::kLoadGlobal,
+                                      Opcode::kAdd, Opcode::kReturn}));
+  EXPECT_EQ(bytecode.constants, (std::vector<std::vector<uint8_t>>{{0x02}}));
+  EXPECT_EQ(bytecode.code[bytecode.main.entry + bytecode.main.size - 1].op,
+            Opcode::kHalt);
+}
+
+TEST(BytecodeTest, Encode_RoundTrips) {
+  auto bytecode = CompileBytecode(Parser().Parse(
+      {"let X 0x07", "let Y X", "def f _a _b => - _a _b", "main f X Y"}));
+  std::string encoded = EncodeBytecode(bytecode);
+  EXPECT_TRUE(IsBytecode(encoded));
+
+  auto decoded = DecodeBytecode(encoded);
+  EXPECT_EQ(decoded.global_names, bytecode.global_names);
+  EXPECT_EQ(decoded.globals, bytecode.globals);
+  EXPECT_EQ(decoded.constants, bytecode.constants);
+  ASSERT_EQ(decoded.functions.size(), 1);
+  EXPECT_EQ(decoded.functions[0].name, "f");
+  EXPECT_EQ(decoded.functions[0].params, 2);
+  EXPECT_EQ(decoded.main.registers, bytecode.main.registers);
+  EXPECT_EQ(EncodeBytecode(decoded), encoded);
+}
+
+TEST(BytecodeTest, Decode_RejectsMalformedData) {
+  std::string encoded = EncodeBytecode(
+      CompileBytecode(Parser().Parse({"def f => 0x01", "main f"})));
+  EXPECT_FALSE(IsBytecode("let X 0x01"));
+  EXPECT_THROW(DecodeBytecode("let X 0x01"), std::runtime_error);
+  EXPECT_THROW(DecodeBytecode(encoded.substr(0, encoded.size() - 1)),
+               std::runtime_error);
+  EXPECT_THROW(DecodeBytecode(encoded + "x"), std::runtime_error);
+}
+
+} // namespace
+} // namespace boyo
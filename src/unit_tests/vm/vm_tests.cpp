@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "interpreter/interpreter.hpp"
+#include "parser/parser.hpp"
+#include "vm/vm.hpp"
+
+namespace boyo {
+namespace {
+
+const std::vector<std::string> kProgram = {
+    "let X 0x07",
+    "let Y 0x03",
+    "let Z Y",
+    "def sum _a _b => + _a _b",
+    "def mix _a _b _c => - * + _a _b _c * _a _a",
+    "def globals => + * X 0x04 Z",
+    "def id _a => _a",
+    "main sum X Y",
+    "main mix X Y Z",
+    "main globals",
+    "main id X"};
+
+TEST(VmTest, Run_MatchesInterpreter) {
+  auto statements = Parser().Parse(kProgram);
+  for (const auto &args : std::vector<std::vector<std::string>>{
+           {}, {"X=0x0102ff", "Z=0xfe"}}) {
+    std::ostringstream interpreted;
+    Interpreter(statements).Run(interpreted, args);
+    std::ostringstream executed;
+    Vm(CompileBytecode(statements)).Run(executed, args);
+    EXPECT_EQ(executed.str(), interpreted.str());
+  }
+  std::ostringstream out;
+  EXPECT_THROW(Vm(CompileBytecode(statements)).Run(out, {"W=0x01"}),
+               std::runtime_error);
+}
+
+TEST(VmTest, Call_ReusesRegistersAcrossCalls) {
+  Vm vm(CompileBytecode(Parser().Parse(kProgram)));
+  size_t mix = vm.FindFunction("mix", 3);
+  std::vector<uint8_t> a = {1, 2}, b = {3}, c = {4, 5, 6};
+  const std::vector<uint8_t> *args[] = {&a, &b, &c};
+  for (int i = 0; i < 3; ++i) {
+    // ((a + b) * c) - a * a
+    EXPECT_EQ(vm.Call(mix, args), (std::vector<uint8_t>{15, 6, 0}));
+  }
+  EXPECT_EQ(vm.Call("id", {{9, 8}}), (std::vector<uint8_t>{9, 8}));
+  EXPECT_THROW(vm.FindFunction("mix", 2), std::runtime_error);
+}
+
+TEST(VmTest, Vm_RejectsMalformedBytecode) {
+  auto valid = CompileBytecode(Parser().Parse(kProgram));
+
+  auto bytecode = valid;
+  bytecode.code[bytecode.functions[0].entry].b = 7; // Parameter 7 of 2
+  EXPECT_THROW(Vm{bytecode}, std::runtime_error);
+
+  bytecode = valid;
+  bytecode.functions[0].registers = 1; // Result register out of range
+  EXPECT_THROW(Vm{bytecode}, std::runtime_error);
+
+  bytecode = valid;
+  bytecode.functions[0].size -= 1; // Falls through to the next function
+  EXPECT_THROW(Vm{bytecode}, std::runtime_error);
+
+  bytecode = valid;
+  bytecode.code[bytecode.main.entry].op = Opcode::kPrint; // Unwritten
+  EXPECT_THROW(Vm{bytecode}, std::runtime_error);
+}
+
+} // namespace
+} // namespace boyo
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "watch/file_watcher.hpp"
+
+namespace boyo {
+namespace {
+
+class FileWatcherTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::filesystem::create_directories(directory);
+    std::ofstream(path) << "let A 0x01\n";
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory); }
+
+  const std::string directory = "test_file_watcher";
+  const std::string path = directory + "/program.boyo";
+};
+
+TEST_F(FileWatcherTest, Wait_TimesOutWithoutChanges) {
+  FileWatcher watcher(path);
+  EXPECT_FALSE(watcher.Wait(10));
+}
+
+TEST_F(FileWatcherTest, Wait_SeesWritesInPlace) {
+  FileWatcher watcher(path);
+  std::ofstream(path) << "let A 0x02\n";
+  EXPECT_TRUE(watcher.Wait(1000));
+  // The save was one change
+  EXPECT_FALSE(watcher.Wait(10));
+}
+
+TEST_F(FileWatcherTest, Wait_SeesRenamesAndIgnoresOtherFiles) {
+  FileWatcher watcher(path);
+  std::ofstream(directory + "/other.boyo") << "let B 0x01\n";
+  EXPECT_FALSE(watcher.Wait(10));
+
+  // Editors often save to a temporary file and rename it over the original
+  std::ofstream(directory + "/program.boyo.tmp") << "let A 0x03\n";
+  std::filesystem::rename(directory + "/program.boyo.tmp", path);
+  EXPECT_TRUE(watcher.Wait(1000));
+}
+
+} // namespace
+} // namespace boyo
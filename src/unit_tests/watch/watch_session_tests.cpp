@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "test_utils.hpp"
+#include "watch/watch_session.hpp"
+
+namespace boyo {
+namespace {
+
+TEST(WatchSessionTest, Update_ParsesOnlyChangedLines) {
+  WatchSession session({}, "test_program_watch");
+  std::vector<std::string> lines = {"let X 0x07", "", "let Y 0x03",
+                                    "def sum _a _b => + _a _b", "main sum X Y"};
+  EXPECT_EQ(session.Update(lines), 4);
+  ASSERT_EQ(session.GetStatements().size(), 4);
+  const Statement *sum = session.GetStatements()[2].get();
+
+  // An edited line is parsed again; the others keep their statements
+  lines[0] = "let X 0x08";
+  EXPECT_EQ(session.Update(lines), 1);
+  EXPECT_EQ(session.GetStatements()[2].get(), sum);
+
+  // Moved lines are matched by their text
+  lines.insert(lines.begin(), "let Z 0x01");
+  EXPECT_EQ(session.Update(lines), 1);
+  ASSERT_EQ(session.GetStatements().size(), 5);
+  EXPECT_EQ(session.GetStatements()[3].get(), sum);
+}
+
+TEST(WatchSessionTest, Update_KeepsStateOnParseError) {
+  WatchSession session({}, "test_program_watch");
+  session.Update({"let X 0x07", "def f _a => _a", "main f X"});
+
+  EXPECT_THROW(session.Update({"let X 0x07", "def f _a =>", "main f X"}),
+               std::runtime_error);
+  ASSERT_EQ(session.GetStatements().size(), 3);
+  EXPECT_EQ(session.Update({"let X 0x07", "def f _a => _a", "main f X"}), 0);
+}
+
+TEST(WatchSessionTest, Build_RebuildsAfterEdits) {
+  CompileOptions options;
+  options.cache_dir = "test_program_watch_cache";
+  WatchSession session(options, "test_program_watch");
+  std::vector<std::string> lines = {"let X 0x07", "let Y 0x03",
+                                    "def sum _a _b => + _a _b", "main sum X Y"};
+  session.Update(lines);
+  session.Build();
+  EXPECT_EQ(RunProgram("./test_program_watch"), "a \n");
+
+  lines[2] = "def sum _a _b => * _a _b";
+  session.Update(lines);
+  session.Build();
+  EXPECT_EQ(RunProgram("./test_program_watch"), "15 \n");
+}
+
+} // namespace
+} // namespace boyo